@@ -0,0 +1,298 @@
+/**
+@file ActionMap.h
+
+Action / axis mapping. Key, mouse button and joystick bindings are
+compiled into dense tables (code -> action bitset) and the state per
+frame lives in bit arrays (held, pressed, released), so queries are
+a bit test. Listeners only receive the actions they subscribed to.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef ACTIONMAP_H
+#define ACTIONMAP_H
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace dune {
+
+enum action_edge
+{
+	action_pressed,
+	action_released
+};
+
+class action_map
+{
+public:
+	static const int MAX_ACTIONS = 64;
+	static const int MAX_KEYS = 256;
+	static const int MAX_MOUSE_BUTTONS = 8;
+	static const int MAX_JOY_BUTTONS = 32;
+	static const int MAX_AXES = 16;
+
+	typedef std::function<void(int action, action_edge edge)> listener;
+
+	action_map()
+		: _held(0)
+		, _pressed(0)
+		, _released(0)
+	{
+		clear_bindings();
+		for (int i = 0; i < MAX_ACTIONS; ++i)
+		{
+			_down_count[i] = 0;
+			_axis_value[i] = 0.0f;
+		}
+	}
+
+	int add_action(const std::string& name)
+	{
+		if ((int)_names.size() >= MAX_ACTIONS)
+		{
+			LOGE("Action %s: more than %d actions", name.c_str(), MAX_ACTIONS);
+			return -1;
+		}
+		_names.push_back(name);
+		_listeners.emplace_back();
+		return (int)_names.size() - 1;
+	}
+
+	int find_action(const std::string& name) const
+	{
+		for (int i = 0; i < (int)_names.size(); ++i)
+			if (_names[i] == name)
+				return i;
+		return -1;
+	}
+
+	// "" para una accion invalida
+	const std::string& name(int action) const
+	{
+		static const std::string none;
+		return (action >= 0 && action < (int)_names.size()) ? _names[action] : none;
+	}
+
+	void bind_key(int key, int action)
+	{
+		if (key >= 0 && key < MAX_KEYS && action >= 0)
+			_key_table[key] |= bit(action);
+	}
+
+	void bind_mouse_button(int button, int action)
+	{
+		if (button >= 0 && button < MAX_MOUSE_BUTTONS && action >= 0)
+			_mouse_table[button] |= bit(action);
+	}
+
+	void bind_joy_button(int button, int action)
+	{
+		if (button >= 0 && button < MAX_JOY_BUTTONS && action >= 0)
+			_joy_table[button] |= bit(action);
+	}
+
+	// valor = clamp(raw * scale) con zona muerta; raw de OIS en [-32768, 32767]
+	void bind_axis(int axis, int action, float scale = 1.0f / 32767.0f, float deadzone = 0.15f)
+	{
+		if (axis >= 0 && axis < MAX_AXES && action >= 0)
+		{
+			_axis_table[axis].action = action;
+			_axis_table[axis].scale = scale;
+			_axis_table[axis].deadzone = deadzone;
+		}
+	}
+
+	void clear_bindings()
+	{
+		for (int i = 0; i < MAX_KEYS; ++i) _key_table[i] = 0;
+		for (int i = 0; i < MAX_MOUSE_BUTTONS; ++i) _mouse_table[i] = 0;
+		for (int i = 0; i < MAX_JOY_BUTTONS; ++i) _joy_table[i] = 0;
+		for (int i = 0; i < MAX_AXES; ++i) _axis_table[i] = axis_binding();
+	}
+
+	// listener solo para esta accion
+	void subscribe(int action, const listener& callback)
+	{
+		if (action >= 0 && action < (int)_listeners.size())
+		{
+			_listeners[action].push_back(callback);
+			_subscribed |= bit(action);
+		}
+	}
+
+	// al principio del frame: limpia los flancos
+	void begin_frame()
+	{
+		_pressed = 0;
+		_released = 0;
+	}
+
+	void key(int code, bool down)
+	{
+		if (code >= 0 && code < MAX_KEYS && toggle(_key_down[code], down))
+			apply(_key_table[code], down);
+	}
+
+	void mouse_button(int button, bool down)
+	{
+		if (button >= 0 && button < MAX_MOUSE_BUTTONS && toggle(_mouse_down[button], down))
+			apply(_mouse_table[button], down);
+	}
+
+	void joy_button(int button, bool down)
+	{
+		if (button >= 0 && button < MAX_JOY_BUTTONS && toggle(_joy_down[button], down))
+			apply(_joy_table[button], down);
+	}
+
+	void axis_moved(int axis, int raw)
+	{
+		if (axis < 0 || axis >= MAX_AXES || _axis_table[axis].action < 0)
+			return;
+		const axis_binding& b = _axis_table[axis];
+		float value = raw * b.scale;
+		value = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+		if (std::fabs(value) < b.deadzone)
+			value = 0.0f;
+		_axis_value[b.action] = value;
+	}
+
+	bool held(int action) const { return (_held & bit(action)) != 0; }
+	bool pressed(int action) const { return (_pressed & bit(action)) != 0; }
+	bool released(int action) const { return (_released & bit(action)) != 0; }
+	float axis(int action) const { return (action >= 0 && action < MAX_ACTIONS) ? _axis_value[action] : 0.0f; }
+
+	uint64_t held_mask() const { return _held; }
+	uint64_t pressed_mask() const { return _pressed; }
+	uint64_t released_mask() const { return _released; }
+
+	/*
+	Connects to the input_system signals (any object with the same
+	fes::sync members).
+	*/
+	template <typename Input>
+	void attach(Input& input)
+	{
+		input.key_pressed.connect([this](auto& event) { key(event.key, true); });
+		input.key_release.connect([this](auto& event) { key(event.key, false); });
+		input.mouse_pressed.connect([this](auto&, auto id) { mouse_button(id, true); });
+		input.mouse_released.connect([this](auto&, auto id) { mouse_button(id, false); });
+		input.button_pressed.connect([this](auto&, int button) { joy_button(button, true); });
+		input._buttonReleased.connect([this](auto&, int button) { joy_button(button, false); });
+		// sin joystick (replay, headless) mAxes esta vacio
+		input.axis_moved.connect([this](auto& event, int axis) {
+			if (axis >= 0 && axis < (int)event.state.mAxes.size())
+				axis_moved(axis, event.state.mAxes[axis].abs);
+		});
+	}
+
+protected:
+	struct axis_binding
+	{
+		int action = -1;
+		float scale = 1.0f;
+		float deadzone = 0.0f;
+	};
+
+	// accion invalida (-1 de add_action/find_action): ningun bit
+	static uint64_t bit(int action)
+	{
+		if (action < 0 || action >= MAX_ACTIONS)
+			return 0;
+		return uint64_t(1) << action;
+	}
+
+	// ignora autorepeat (down repetidos) y releases sin press
+	static bool toggle(bool& state, bool down)
+	{
+		if (state == down)
+			return false;
+		state = down;
+		return true;
+	}
+
+	void apply(uint64_t mask, bool down)
+	{
+		uint64_t changed = 0;
+		for (uint64_t m = mask; m; m &= m - 1)
+		{
+			int action = lowest_bit(m);
+			// varios bindings por accion: held mientras alguno siga pulsado
+			if (down)
+			{
+				if (_down_count[action]++ == 0)
+					changed |= bit(action);
+			}
+			else if (_down_count[action] > 0)
+			{
+				if (--_down_count[action] == 0)
+					changed |= bit(action);
+			}
+		}
+		if (!changed)
+			return;
+
+		if (down)
+		{
+			_held |= changed;
+			_pressed |= changed;
+		}
+		else
+		{
+			_held &= ~changed;
+			_released |= changed;
+		}
+
+		for (uint64_t m = changed & _subscribed; m; m &= m - 1)
+		{
+			int action = lowest_bit(m);
+			for (const listener& callback : _listeners[action])
+				callback(action, down ? action_pressed : action_released);
+		}
+	}
+
+	static int lowest_bit(uint64_t m)
+	{
+#if defined(__GNUC__)
+		return __builtin_ctzll(m);
+#else
+		int index = 0;
+		while (!(m & 1))
+		{
+			m >>= 1;
+			++index;
+		}
+		return index;
+#endif
+	}
+
+protected:
+	// tablas densas codigo -> acciones
+	uint64_t _key_table[MAX_KEYS];
+	uint64_t _mouse_table[MAX_MOUSE_BUTTONS];
+	uint64_t _joy_table[MAX_JOY_BUTTONS];
+	axis_binding _axis_table[MAX_AXES];
+
+	// estado del frame
+	uint64_t _held;
+	uint64_t _pressed;
+	uint64_t _released;
+	unsigned char _down_count[MAX_ACTIONS];
+	bool _key_down[MAX_KEYS] = {};
+	bool _mouse_down[MAX_MOUSE_BUTTONS] = {};
+	bool _joy_down[MAX_JOY_BUTTONS] = {};
+	float _axis_value[MAX_ACTIONS];
+
+	uint64_t _subscribed = 0;
+	std::vector<std::string> _names;
+	std::vector<std::vector<listener> > _listeners;
+};
+
+} // end namespace dune
+
+#endif // ACTIONMAP_H
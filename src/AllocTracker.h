@@ -0,0 +1,380 @@
+/**
+@file AllocTracker.h
+
+Allocation instrumentation through the replaceable global operator
+new/delete. Define DUNE_ALLOC_HOOKS before including this header in
+exactly one .cpp of the executable to install the hooks:
+
+	#define DUNE_ALLOC_HOOKS
+	#include "AllocTracker.h"
+
+	- thread_allocations(): counters of the calling thread
+	- allocations().begin_frame(): called by the frame thread once per
+	  frame, keeps the counts of the frame that just finished
+	- sample_every(n): every n-th allocation records its call site
+	  (return address of operator new) in a fixed table
+	- set_steady_state(warmup): after warmup frames, any allocation of
+	  the frame thread between begin_frame() and end_frame() is a
+	  violation (recorded, or abort() with abort_on_violation)
+
+The hooks never allocate; tables are fixed and lock free.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef ALLOCTRACKER_H
+#define ALLOCTRACKER_H
+
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <algorithm>
+#if defined(__linux__) || defined(__APPLE__)
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+// los hooks no se pueden inlinear: la direccion de retorno tiene que ser la del que reserva
+#if defined(__GNUC__)
+#define DUNE_CALLER() __builtin_return_address(0)
+#define DUNE_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define DUNE_CALLER() nullptr
+#define DUNE_NOINLINE __declspec(noinline)
+#else
+#define DUNE_CALLER() nullptr
+#define DUNE_NOINLINE
+#endif
+
+namespace dune {
+
+struct alloc_counters
+{
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t bytes = 0;
+};
+
+// del hilo que llama (trivial: no necesita inicializacion dinamica)
+inline alloc_counters& thread_allocations()
+{
+	thread_local alloc_counters counters;
+	return counters;
+}
+
+struct alloc_site
+{
+	void* address;
+	uint64_t count;
+	uint64_t bytes;
+};
+
+// direccion -> contador, sin locks ni memoria dinamica
+class alloc_site_table
+{
+public:
+	static const size_t SIZE = 512;
+
+	alloc_site_table()
+		: _dropped(0)
+	{
+		for (entry& e : _entries)
+		{
+			e.address = 0;
+			e.count = 0;
+			e.bytes = 0;
+		}
+	}
+
+	void add(void* address, size_t bytes)
+	{
+		uintptr_t key = (uintptr_t)address | 1;
+		size_t i = (size_t)((key >> 4) * 2654435761u) % SIZE;
+		for (size_t probe = 0; probe < SIZE; ++probe, i = (i + 1) % SIZE)
+		{
+			entry& e = _entries[i];
+			uintptr_t current = e.address.load(std::memory_order_relaxed);
+			if (current == 0)
+			{
+				uintptr_t expected = 0;
+				if (e.address.compare_exchange_strong(expected, key) || expected == key)
+					current = key;
+				else
+					current = expected;
+			}
+			if (current == key)
+			{
+				e.count.fetch_add(1, std::memory_order_relaxed);
+				e.bytes.fetch_add(bytes, std::memory_order_relaxed);
+				return;
+			}
+		}
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// mas frecuentes primero
+	std::vector<alloc_site> sites() const
+	{
+		std::vector<alloc_site> result;
+		for (const entry& e : _entries)
+		{
+			uintptr_t key = e.address.load(std::memory_order_relaxed);
+			if (key)
+				result.push_back(alloc_site{(void*)(key & ~(uintptr_t)1), e.count.load(), e.bytes.load()});
+		}
+		std::sort(result.begin(), result.end(), [](const alloc_site& a, const alloc_site& b) { return a.count > b.count; });
+		return result;
+	}
+
+	uint64_t dropped() const { return _dropped; }
+
+protected:
+	struct entry
+	{
+		// bit 0 a 1: distingue la direccion 0 de un hueco libre
+		std::atomic<uintptr_t> address;
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> bytes;
+	};
+	entry _entries[SIZE];
+	std::atomic<uint64_t> _dropped;
+};
+
+class alloc_tracker
+{
+public:
+	alloc_tracker()
+		: _sample_rate(0)
+		, _warmup_frames(0)
+		, _steady(false)
+		, _abort_on_violation(false)
+		, _violations(0)
+		, _allocations(0)
+		, _frees(0)
+		, _bytes(0)
+		, _frames(0)
+		, _max_frame_allocations(0)
+	{
+
+	}
+
+	alloc_tracker(const alloc_tracker&) = delete;
+	alloc_tracker& operator=(const alloc_tracker&) = delete;
+
+	// desde los hooks
+	void on_allocate(size_t bytes, void* caller)
+	{
+		alloc_counters& counters = thread_allocations();
+		++counters.allocations;
+		counters.bytes += bytes;
+		uint64_t n = _allocations.fetch_add(1, std::memory_order_relaxed);
+		_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+		unsigned int rate = _sample_rate.load(std::memory_order_relaxed);
+		if (rate && n % rate == 0)
+			_samples.add(caller, bytes);
+
+		if (in_frame() && _steady.load(std::memory_order_relaxed))
+		{
+			_violations.fetch_add(1, std::memory_order_relaxed);
+			_violation_sites.add(caller, bytes);
+			if (_abort_on_violation)
+			{
+				// sin printf con formato: no puede reservar
+				std::fputs("dune: allocation in the frame loop in steady state\n", stderr);
+				std::abort();
+			}
+		}
+	}
+
+	void on_free()
+	{
+		++thread_allocations().frees;
+		_frees.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// 0 = sin muestreo
+	void sample_every(unsigned int n) { _sample_rate = n; }
+
+	// a partir de warmup frames, asignar dentro del frame es un error
+	void set_steady_state(unsigned int warmup_frames, bool abort_on_violation = false)
+	{
+		_warmup_frames = warmup_frames;
+		_abort_on_violation = abort_on_violation;
+		_steady = (warmup_frames == 0);
+	}
+
+	/*
+	From the frame thread, once per frame: closes the previous frame (its
+	counters go to last_frame()) and opens the next one.
+	*/
+	void begin_frame()
+	{
+		if (in_frame())
+			end_frame();
+		_frame_start = thread_allocations();
+		in_frame() = true;
+	}
+
+	void end_frame()
+	{
+		if (!in_frame())
+			return;
+		in_frame() = false;
+		const alloc_counters& now = thread_allocations();
+		_last_frame.allocations = now.allocations - _frame_start.allocations;
+		_last_frame.frees = now.frees - _frame_start.frees;
+		_last_frame.bytes = now.bytes - _frame_start.bytes;
+		_max_frame_allocations = std::max(_max_frame_allocations, _last_frame.allocations);
+		if (++_frames == _warmup_frames)
+			_steady = true;
+	}
+
+	// del ultimo frame completo del hilo del frame
+	const alloc_counters& last_frame() const { return _last_frame; }
+	uint64_t max_frame_allocations() const { return _max_frame_allocations; }
+	uint64_t frames() const { return _frames; }
+	bool steady() const { return _steady; }
+
+	uint64_t violations() const { return _violations; }
+	uint64_t allocations() const { return _allocations; }
+	uint64_t frees() const { return _frees; }
+	uint64_t bytes() const { return _bytes; }
+
+	std::vector<alloc_site> sampled_sites() const { return _samples.sites(); }
+	std::vector<alloc_site> violation_sites() const { return _violation_sites.sites(); }
+
+	// nombre de la funcion que contiene address (si hay simbolos)
+	static std::string symbol(void* address)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%p", address);
+#if defined(__linux__) || defined(__APPLE__)
+		Dl_info info;
+		if (dladdr(address, &info) && info.dli_sname)
+		{
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			std::string name = (status == 0 && demangled) ? demangled : info.dli_sname;
+			std::free(demangled);
+			return name + " (" + text + ")";
+		}
+#endif
+		return text;
+	}
+
+protected:
+	static bool& in_frame()
+	{
+		thread_local bool frame = false;
+		return frame;
+	}
+
+protected:
+	std::atomic<unsigned int> _sample_rate;
+	unsigned int _warmup_frames;
+	std::atomic<bool> _steady;
+	bool _abort_on_violation;
+	std::atomic<uint64_t> _violations;
+	std::atomic<uint64_t> _allocations;
+	std::atomic<uint64_t> _frees;
+	std::atomic<uint64_t> _bytes;
+	// solo el hilo del frame
+	alloc_counters _frame_start;
+	alloc_counters _last_frame;
+	uint64_t _frames;
+	uint64_t _max_frame_allocations;
+	alloc_site_table _samples;
+	alloc_site_table _violation_sites;
+};
+
+inline alloc_tracker& allocations()
+{
+	static alloc_tracker tracker;
+	return tracker;
+}
+
+inline void* tracked_allocate(size_t bytes, void* caller)
+{
+	void* p = std::malloc(bytes ? bytes : 1);
+	if (p)
+		allocations().on_allocate(bytes, caller);
+	return p;
+}
+
+inline void tracked_free(void* p)
+{
+	if (!p)
+		return;
+	allocations().on_free();
+	std::free(p);
+}
+
+} // end namespace dune
+
+#ifdef DUNE_ALLOC_HOOKS
+
+DUNE_NOINLINE void* operator new(std::size_t bytes)
+{
+	void* p = dune::tracked_allocate(bytes, DUNE_CALLER());
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+DUNE_NOINLINE void* operator new[](std::size_t bytes)
+{
+	void* p = dune::tracked_allocate(bytes, DUNE_CALLER());
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+DUNE_NOINLINE void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept
+{
+	return dune::tracked_allocate(bytes, DUNE_CALLER());
+}
+
+DUNE_NOINLINE void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept
+{
+	return dune::tracked_allocate(bytes, DUNE_CALLER());
+}
+
+DUNE_NOINLINE void operator delete(void* p) noexcept
+{
+	dune::tracked_free(p);
+}
+
+DUNE_NOINLINE void operator delete[](void* p) noexcept
+{
+	dune::tracked_free(p);
+}
+
+DUNE_NOINLINE void operator delete(void* p, std::size_t) noexcept
+{
+	dune::tracked_free(p);
+}
+
+DUNE_NOINLINE void operator delete[](void* p, std::size_t) noexcept
+{
+	dune::tracked_free(p);
+}
+
+DUNE_NOINLINE void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	dune::tracked_free(p);
+}
+
+DUNE_NOINLINE void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	dune::tracked_free(p);
+}
+
+#endif // DUNE_ALLOC_HOOKS
+
+#endif // ALLOCTRACKER_H
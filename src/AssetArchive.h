@@ -0,0 +1,619 @@
+/**
+@file AssetArchive.h
+
+Packed asset archive and the virtual file system on top of it. An
+archive is one file mapped in memory:
+
+	header
+	entry table sorted by hash of the path (binary search)
+	paths
+	blobs (16 bytes aligned, each one followed by a '\0')
+
+Uncompressed entries are read without copies (the view points into
+the mapping, and the '\0' lets them be used as text). Built with the
+CMake option DUNE_LZ4, entries can be stored compressed with LZ4 and
+are decompressed on read.
+
+The vfs searches the mounted archives (last mounted first) and, when a
+loose root is set, a loose file with the same path wins: during
+development the assets can be edited without packing again.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef ASSETARCHIVE_H
+#define ASSETARCHIVE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+#ifdef DUNE_LZ4
+#include <lz4.h>
+#endif
+#include "MappedFile.h"
+#include "FrameArena.h"
+
+namespace dune {
+
+const uint32_t ARCHIVE_MAGIC = 0x4B415044; // "DPAK"
+const uint32_t ARCHIVE_VERSION = 1;
+
+enum archive_flags
+{
+	archive_lz4 = 1
+};
+
+struct archive_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t reserved;
+	uint64_t entries_offset;
+	uint64_t names_offset;
+	uint64_t file_size;
+};
+
+struct archive_entry
+{
+	uint64_t hash;
+	uint64_t offset;
+	// bytes guardados / bytes originales
+	uint64_t stored_size;
+	uint64_t size;
+	uint32_t name_offset;
+	uint32_t name_size;
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+namespace archive_path {
+
+// separadores '/', sin "./" inicial
+inline std::string normalize(const std::string& path)
+{
+	std::string result = path;
+	std::replace(result.begin(), result.end(), '\\', '/');
+	size_t start = 0;
+	while (result.compare(start, 2, "./") == 0)
+		start += 2;
+	return result.substr(start);
+}
+
+// FNV-1a
+inline uint64_t hash(const std::string& path)
+{
+	uint64_t h = 14695981039346656037ull;
+	for (unsigned char c : path)
+	{
+		h ^= c;
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+} // end namespace archive_path
+
+/*
+Contents of a file: a view into an archive mapping (zero copy) or an
+owned buffer (compressed entries, loose files). Always followed by a
+'\0'.
+*/
+class asset
+{
+public:
+	asset()
+		: _data(nullptr)
+		, _size(0)
+	{
+
+	}
+
+	asset(const asset&) = delete;
+	asset& operator=(const asset&) = delete;
+
+	void assign_view(const char* data, size_t size)
+	{
+		_storage.clear();
+		_data = data;
+		_size = size;
+	}
+
+	// buffer propio de size bytes (+ '\0') para rellenar
+	char* assign_storage(size_t size)
+	{
+		_storage.assign(size + 1, '\0');
+		_data = _storage.data();
+		_size = size;
+		return _storage.data();
+	}
+
+	void clear()
+	{
+		_storage.clear();
+		_data = nullptr;
+		_size = 0;
+	}
+
+	const char* data() const { return _data; }
+	const char* text() const { return _data; }
+	size_t size() const { return _size; }
+	bool empty() const { return _data == nullptr; }
+	// true si apunta al mapping del archivo
+	bool is_view() const { return _data && _storage.empty(); }
+
+	span<const char> view() const
+	{
+		span<const char> result;
+		result.data = _data;
+		result.size = _size;
+		return result;
+	}
+
+protected:
+	const char* _data;
+	size_t _size;
+	std::vector<char> _storage;
+};
+
+class archive
+{
+public:
+	archive()
+		: _header(nullptr)
+		, _entries(nullptr)
+	{
+
+	}
+
+	bool open(const std::string& filename)
+	{
+		close();
+		if (!_file.open(filename))
+		{
+			LOGE("Can't open archive %s", filename.c_str());
+			return false;
+		}
+		const archive_header* header = (const archive_header*)_file.data();
+		if (_file.size() < sizeof(archive_header) || header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION)
+		{
+			LOGE("Archive %s: invalid magic or version", filename.c_str());
+			close();
+			return false;
+		}
+		if (header->file_size != _file.size() ||
+			!in_range(header->entries_offset, sizeof(archive_entry) * (uint64_t)header->entry_count, _file.size()) ||
+			!in_range(header->names_offset, 0, _file.size()))
+		{
+			LOGE("Archive %s truncated", filename.c_str());
+			close();
+			return false;
+		}
+		if (header->entries_offset % alignof(archive_entry))
+		{
+			LOGE("Archive %s: misaligned entry table", filename.c_str());
+			close();
+			return false;
+		}
+		// todo se valida aqui una vez: find() y read() confian en la tabla
+		const archive_entry* entries = (const archive_entry*)(_file.data() + header->entries_offset);
+		uint64_t names_size = _file.size() - header->names_offset;
+		for (uint32_t i = 0; i < header->entry_count; ++i)
+		{
+			const archive_entry& e = entries[i];
+			// blob + '\0'
+			bool ok = in_range(e.offset, e.stored_size, _file.size() - 1) &&
+					  in_range(e.name_offset, e.name_size, names_size) &&
+					  (i == 0 || entries[i - 1].hash <= e.hash) &&
+					  !(e.flags & ~(uint32_t)archive_lz4);
+			if (ok && (e.flags & archive_lz4))
+				ok = e.stored_size <= INT_MAX && e.size <= INT_MAX;
+			else if (ok)
+				ok = e.stored_size == e.size && _file.data()[e.offset + e.stored_size] == '\0';
+			if (!ok)
+			{
+				LOGE("Archive %s: corrupted entry table (entry %u)", filename.c_str(), i);
+				close();
+				return false;
+			}
+		}
+		_header = header;
+		_entries = entries;
+		_filename = filename;
+		return true;
+	}
+
+	void close()
+	{
+		_header = nullptr;
+		_entries = nullptr;
+		_file.close();
+	}
+
+	bool is_open() const { return _header != nullptr; }
+	const std::string& filename() const { return _filename; }
+	size_t size() const { return _header ? _header->entry_count : 0; }
+	const archive_entry& entry(size_t i) const { return _entries[i]; }
+
+	std::string name(const archive_entry& e) const
+	{
+		return std::string((const char*)_file.data() + _header->names_offset + e.name_offset, e.name_size);
+	}
+
+	// nullptr si no esta
+	const archive_entry* find(const std::string& path) const
+	{
+		if (!_header)
+			return nullptr;
+		std::string normalized = archive_path::normalize(path);
+		uint64_t hash = archive_path::hash(normalized);
+		const archive_entry* end = _entries + _header->entry_count;
+		const archive_entry* it = std::lower_bound(_entries, end, hash, [](const archive_entry& e, uint64_t h) {
+			return e.hash < h;
+		});
+		// colisiones de hash: se compara el nombre
+		for (; it != end && it->hash == hash; ++it)
+		{
+			const char* name = (const char*)_file.data() + _header->names_offset + it->name_offset;
+			if (it->name_size == normalized.size() && std::memcmp(name, normalized.data(), it->name_size) == 0)
+				return it;
+		}
+		return nullptr;
+	}
+
+	// sin comprimir: vista del mapping; comprimido: se descomprime en out
+	bool read(const archive_entry& e, asset& out) const
+	{
+		const char* blob = (const char*)_file.data() + e.offset;
+		if (!(e.flags & archive_lz4))
+		{
+			out.assign_view(blob, (size_t)e.size);
+			return true;
+		}
+#ifdef DUNE_LZ4
+		char* buffer = out.assign_storage((size_t)e.size);
+		int result = LZ4_decompress_safe(blob, buffer, (int)e.stored_size, (int)e.size);
+		if (result < 0 || (uint64_t)result != e.size)
+		{
+			LOGE("Archive %s: corrupted entry %s", _filename.c_str(), name(e).c_str());
+			out.clear();
+			return false;
+		}
+		return true;
+#else
+		LOGE("Archive %s: %s is compressed, build with DUNE_LZ4", _filename.c_str(), name(e).c_str());
+		out.clear();
+		return false;
+#endif
+	}
+
+protected:
+	// [offset, offset + size) dentro de [0, limit), sin desbordar
+	static bool in_range(uint64_t offset, uint64_t size, uint64_t limit)
+	{
+		return offset <= limit && size <= limit - offset;
+	}
+
+protected:
+	mapped_file _file;
+	const archive_header* _header;
+	const archive_entry* _entries;
+	std::string _filename;
+};
+
+class archive_writer
+{
+public:
+	// compress: solo con DUNE_LZ4 y si ocupa menos
+	void add(const std::string& path, const void* data, size_t size, bool compress = false)
+	{
+		file f;
+		f.name = archive_path::normalize(path);
+		f.size = size;
+		f.flags = 0;
+		const char* bytes = (const char*)data;
+#ifdef DUNE_LZ4
+		if (compress && size > 0)
+		{
+			std::vector<char> packed((size_t)LZ4_compressBound((int)size));
+			int packed_size = LZ4_compress_default(bytes, packed.data(), (int)size, (int)packed.size());
+			if (packed_size > 0 && (size_t)packed_size < size)
+			{
+				packed.resize((size_t)packed_size);
+				f.data.swap(packed);
+				f.flags = archive_lz4;
+			}
+		}
+#else
+		(void)compress;
+#endif
+		if (!f.flags)
+			f.data.assign(bytes, bytes + size);
+		_files.push_back(std::move(f));
+	}
+
+	bool add_file(const std::string& path, const std::string& filename, bool compress = false)
+	{
+		std::ifstream input(filename, std::ios::binary);
+		if (!input)
+		{
+			LOGE("Can't read %s", filename.c_str());
+			return false;
+		}
+		std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+		add(path, data.data(), data.size(), compress);
+		return true;
+	}
+
+	// todos los ficheros bajo root, con rutas relativas a root
+	bool add_directory(const std::string& root, bool compress = false)
+	{
+		std::vector<std::string> files;
+		if (!list_files(root, "", files))
+		{
+			LOGE("Can't list %s", root.c_str());
+			return false;
+		}
+		bool ok = true;
+		for (const std::string& path : files)
+			ok = add_file(path, root + "/" + path, compress) && ok;
+		return ok;
+	}
+
+	bool write(const std::string& filename)
+	{
+		std::sort(_files.begin(), _files.end(), [](const file& a, const file& b) {
+			return archive_path::hash(a.name) < archive_path::hash(b.name);
+		});
+
+		archive_header header;
+		std::memset(&header, 0, sizeof(header));
+		header.magic = ARCHIVE_MAGIC;
+		header.version = ARCHIVE_VERSION;
+		header.entry_count = (uint32_t)_files.size();
+		header.entries_offset = align(sizeof(archive_header));
+		header.names_offset = header.entries_offset + sizeof(archive_entry) * _files.size();
+
+		std::vector<archive_entry> entries(_files.size());
+		std::string names;
+		for (size_t i = 0; i < _files.size(); ++i)
+		{
+			std::memset(&entries[i], 0, sizeof(archive_entry));
+			entries[i].hash = archive_path::hash(_files[i].name);
+			entries[i].name_offset = (uint32_t)names.size();
+			entries[i].name_size = (uint32_t)_files[i].name.size();
+			entries[i].size = _files[i].size;
+			entries[i].stored_size = _files[i].data.size();
+			entries[i].flags = _files[i].flags;
+			names += _files[i].name;
+		}
+		uint64_t offset = align(header.names_offset + names.size());
+		for (size_t i = 0; i < _files.size(); ++i)
+		{
+			entries[i].offset = offset;
+			// + '\0' para usarlo como texto sin copiar
+			offset = align(offset + entries[i].stored_size + 1);
+		}
+		header.file_size = offset;
+
+		std::ofstream output(filename, std::ios::binary | std::ios::trunc);
+		if (!output)
+		{
+			LOGE("Can't write archive %s", filename.c_str());
+			return false;
+		}
+		const char padding[16] = {0};
+		auto write_at = [&](uint64_t at, const void* data, size_t size) {
+			uint64_t position = (uint64_t)output.tellp();
+			output.write(padding, (std::streamsize)(at - position));
+			if (size > 0)
+				output.write((const char*)data, (std::streamsize)size);
+		};
+		write_at(0, &header, sizeof(header));
+		write_at(header.entries_offset, entries.data(), sizeof(archive_entry) * entries.size());
+		write_at(header.names_offset, names.data(), names.size());
+		for (size_t i = 0; i < _files.size(); ++i)
+			write_at(entries[i].offset, _files[i].data.data(), _files[i].data.size());
+		write_at(header.file_size, nullptr, 0);
+		return (bool)output;
+	}
+
+	size_t size() const { return _files.size(); }
+
+protected:
+	struct file
+	{
+		std::string name;
+		uint64_t size;
+		uint32_t flags;
+		std::vector<char> data;
+	};
+
+	static uint64_t align(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	static bool list_files(const std::string& root, const std::string& relative, std::vector<std::string>& out)
+	{
+		std::string directory = relative.empty() ? root : root + "/" + relative;
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE)
+			return false;
+		do
+		{
+			std::string name = data.cFileName;
+			if (name == "." || name == "..")
+				continue;
+			std::string path = relative.empty() ? name : relative + "/" + name;
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				list_files(root, path, out);
+			else
+				out.push_back(path);
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (!dir)
+			return false;
+		while (dirent* item = readdir(dir))
+		{
+			std::string name = item->d_name;
+			if (name == "." || name == "..")
+				continue;
+			std::string path = relative.empty() ? name : relative + "/" + name;
+			struct stat st;
+			if (stat((root + "/" + path).c_str(), &st) != 0)
+				continue;
+			if (S_ISDIR(st.st_mode))
+				list_files(root, path, out);
+			else if (S_ISREG(st.st_mode))
+				out.push_back(path);
+		}
+		closedir(dir);
+#endif
+		return true;
+	}
+
+protected:
+	std::vector<file> _files;
+};
+
+class vfs
+{
+public:
+	// se busca primero en el ultimo montado
+	bool mount(const std::string& filename)
+	{
+		auto pack = std::make_unique<archive>();
+		if (!pack->open(filename))
+			return false;
+		LOGI("Mounted %s (%u files)", filename.c_str(), (unsigned int)pack->size());
+		_archives.insert(_archives.begin(), std::move(pack));
+		return true;
+	}
+
+	void unmount_all()
+	{
+		_archives.clear();
+	}
+
+	/*
+	Directory whose loose files override the archives (development).
+	Without archives mounted, files are always read loose (relative to
+	the working directory when root is empty).
+	*/
+	void set_loose_root(const std::string& root, bool override_archives = true)
+	{
+		_loose_root = root;
+		_loose_override = override_archives;
+	}
+
+	bool read(const std::string& path, asset& out) const
+	{
+		if (_loose_override || _archives.empty())
+		{
+			if (read_loose(path, out))
+				return true;
+		}
+		for (const auto& pack : _archives)
+		{
+			if (const archive_entry* e = pack->find(path))
+				return pack->read(*e, out);
+		}
+		out.clear();
+		return false;
+	}
+
+	bool exists(const std::string& path) const
+	{
+		for (const auto& pack : _archives)
+		{
+			if (pack->find(path))
+				return true;
+		}
+		struct stat st;
+		return stat(loose_path(path).c_str(), &st) == 0;
+	}
+
+	// en un archivo montado (sin loose que lo tape): se lee sin esperar
+	bool is_packed(const std::string& path) const
+	{
+		if (_loose_override)
+		{
+			struct stat st;
+			if (stat(loose_path(path).c_str(), &st) == 0)
+				return false;
+		}
+		for (const auto& pack : _archives)
+		{
+			if (pack->find(path))
+				return true;
+		}
+		return false;
+	}
+
+	// true si read() leeria el fichero suelto (loose_path) y no el de un archivo montado
+	bool reads_loose(const std::string& path) const
+	{
+		if (!_loose_override && !_archives.empty())
+			return false;
+		struct stat st;
+		return stat(loose_path(path).c_str(), &st) == 0;
+	}
+
+	std::string loose_path(const std::string& path) const
+	{
+		return _loose_root.empty() ? path : _loose_root + "/" + path;
+	}
+
+protected:
+	bool read_loose(const std::string& path, asset& out) const
+	{
+		FILE* file = std::fopen(loose_path(path).c_str(), "rb");
+		if (!file)
+			return false;
+		std::fseek(file, 0, SEEK_END);
+		long size = std::ftell(file);
+		std::fseek(file, 0, SEEK_SET);
+		bool ok = size >= 0;
+		if (ok)
+		{
+			char* buffer = out.assign_storage((size_t)size);
+			ok = std::fread(buffer, 1, (size_t)size, file) == (size_t)size;
+		}
+		std::fclose(file);
+		return ok;
+	}
+
+protected:
+	std::vector<std::unique_ptr<archive> > _archives;
+	std::string _loose_root;
+	bool _loose_override = false;
+};
+
+// sistema de ficheros de los assets del juego
+inline vfs& assets()
+{
+	static vfs instance;
+	return instance;
+}
+
+} // end namespace dune
+
+#endif // ASSETARCHIVE_H
@@ -0,0 +1,330 @@
+/**
+@file AsyncIO.h
+
+Asynchronous file reads that coroutines of cu::parallel_scheduler can
+await without blocking the scheduler:
+
+	auto shader = io.read("shader.vs");
+	io.await(yield, shader);   // yields to the other coroutines until ready
+
+Reads are queued and submitted in batches (submit(), or implicitly by
+await). Backends:
+	- io_uring (liburing) when built with the CMake option DUNE_IO_URING:
+	  one submission for the whole batch, completions reaped by poll()
+	- fallback: the batch is split in one job per worker of a worker_pool
+	  and files are read with stdio
+
+Completions only mark the request; the waiting coroutine resumes in
+the scheduler thread the next time it is scheduled.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include "WorkerPool.h"
+
+#ifdef DUNE_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <liburing.h>
+#endif
+
+namespace dune {
+
+enum io_state
+{
+	io_queued,
+	io_pending,
+	io_done,
+	io_failed
+};
+
+struct io_request
+{
+	std::string filename;
+	// contenido + '\0' (se puede usar como texto)
+	std::vector<char> data;
+	std::atomic<int> state{io_queued};
+#ifdef DUNE_IO_URING
+	int fd = -1;
+	size_t offset = 0;
+#endif
+
+	bool done() const
+	{
+		int s = state.load(std::memory_order_acquire);
+		return s == io_done || s == io_failed;
+	}
+	bool ok() const { return state.load(std::memory_order_acquire) == io_done; }
+	const char* text() const { return data.data(); }
+	size_t size() const { return data.empty() ? 0 : data.size() - 1; }
+};
+
+typedef std::shared_ptr<io_request> io_handle;
+
+class async_io
+{
+public:
+	/*
+	pool: workers for the fallback backend (nullptr = own pool of 2 threads).
+	queue_depth: max reads in flight in io_uring.
+	*/
+	explicit async_io(worker_pool* pool = nullptr, unsigned int queue_depth = 64)
+		: _pool(pool)
+		, _queue_depth(queue_depth)
+	{
+#ifdef DUNE_IO_URING
+		_ring_ok = (io_uring_queue_init(queue_depth, &_ring, 0) == 0);
+		if (!_ring_ok && !_pool)
+#else
+		if (!_pool)
+#endif
+		{
+			_own_pool = std::make_unique<worker_pool>(2);
+			_pool = _own_pool.get();
+		}
+	}
+
+	~async_io()
+	{
+#ifdef DUNE_IO_URING
+		if (_ring_ok)
+		{
+			// no se puede liberar un buffer con la lectura en vuelo
+			while (!_in_flight.empty())
+			{
+				io_uring_submit_and_wait(&_ring, 1);
+				poll();
+			}
+			io_uring_queue_exit(&_ring);
+		}
+#endif
+		// el pool propio termina sus trabajos al destruirse
+	}
+
+	async_io(const async_io&) = delete;
+	async_io& operator=(const async_io&) = delete;
+
+	// encola la lectura; se envia con el siguiente submit()
+	io_handle read(const std::string& filename)
+	{
+		auto request = std::make_shared<io_request>();
+		request->filename = filename;
+		_queued.push_back(request);
+		return request;
+	}
+
+	// envia todas las lecturas encoladas de una vez
+	void submit()
+	{
+		if (_queued.empty())
+			return;
+#ifdef DUNE_IO_URING
+		if (_ring_ok)
+		{
+			submit_uring();
+			return;
+		}
+#endif
+		submit_pool();
+	}
+
+	// recoge completados (solo io_uring, el pool marca directamente)
+	void poll()
+	{
+#ifdef DUNE_IO_URING
+		if (!_ring_ok)
+			return;
+		io_uring_cqe* cqe;
+		while (io_uring_peek_cqe(&_ring, &cqe) == 0)
+		{
+			io_request* request = (io_request*)io_uring_cqe_get_data(cqe);
+			int result = cqe->res;
+			io_uring_cqe_seen(&_ring, cqe);
+			complete_uring(request, result);
+		}
+		// lecturas que esperaban hueco en la cola
+		if (!_queued.empty())
+			submit_uring();
+#endif
+	}
+
+	/*
+	From a coroutine: submits the pending batch and yields until the
+	request is done. Returns false if the read failed.
+	*/
+	template <typename Yield>
+	bool await(Yield& yield, const io_handle& request)
+	{
+		submit();
+		while (!request->done())
+		{
+			yield({});
+			poll();
+		}
+		return request->ok();
+	}
+
+	template <typename Yield>
+	bool await_all(Yield& yield, const std::vector<io_handle>& requests)
+	{
+		bool ok = true;
+		for (const io_handle& request : requests)
+			ok = await(yield, request) && ok;
+		return ok;
+	}
+
+	// fuera de coroutines (arranque, herramientas)
+	bool wait(const io_handle& request)
+	{
+		submit();
+		while (!request->done())
+		{
+			std::this_thread::yield();
+			poll();
+		}
+		return request->ok();
+	}
+
+protected:
+	static void read_blocking(io_request& request)
+	{
+		FILE* file = std::fopen(request.filename.c_str(), "rb");
+		if (!file)
+		{
+			request.state.store(io_failed, std::memory_order_release);
+			return;
+		}
+		std::fseek(file, 0, SEEK_END);
+		long size = std::ftell(file);
+		std::fseek(file, 0, SEEK_SET);
+		bool ok = size >= 0;
+		if (ok)
+		{
+			request.data.resize((size_t)size + 1);
+			ok = std::fread(request.data.data(), 1, (size_t)size, file) == (size_t)size;
+			request.data[(size_t)size] = '\0';
+		}
+		std::fclose(file);
+		request.state.store(ok ? io_done : io_failed, std::memory_order_release);
+	}
+
+	void submit_pool()
+	{
+		// un trabajo por worker, no uno por fichero
+		std::deque<io_handle> batch;
+		batch.swap(_queued);
+		for (const io_handle& request : batch)
+			request->state.store(io_pending, std::memory_order_relaxed);
+
+		size_t jobs = std::min<size_t>(batch.size(), _pool->size());
+		auto shared = std::make_shared<std::deque<io_handle> >(std::move(batch));
+		for (size_t j = 0; j < jobs; ++j)
+		{
+			_pool->submit([shared, j, jobs]() {
+				for (size_t i = j; i < shared->size(); i += jobs)
+					read_blocking(*(*shared)[i]);
+			});
+		}
+	}
+
+#ifdef DUNE_IO_URING
+	void submit_uring()
+	{
+		size_t submitted = 0;
+		while (!_queued.empty() && _in_flight.size() < _queue_depth)
+		{
+			io_handle request = std::move(_queued.front());
+			_queued.pop_front();
+
+			struct stat info;
+			request->fd = ::open(request->filename.c_str(), O_RDONLY);
+			if (request->fd < 0 || ::fstat(request->fd, &info) != 0)
+			{
+				close_request(*request);
+				request->state.store(io_failed, std::memory_order_release);
+				continue;
+			}
+			request->data.resize((size_t)info.st_size + 1);
+			request->data[(size_t)info.st_size] = '\0';
+			request->offset = 0;
+			request->state.store(io_pending, std::memory_order_relaxed);
+			if (info.st_size == 0)
+			{
+				close_request(*request);
+				request->state.store(io_done, std::memory_order_release);
+				continue;
+			}
+			queue_read(request.get());
+			_in_flight.push_back(request);
+			++submitted;
+		}
+		if (submitted)
+			io_uring_submit(&_ring);
+	}
+
+	void queue_read(io_request* request)
+	{
+		io_uring_sqe* sqe = io_uring_get_sqe(&_ring);
+		io_uring_prep_read(sqe, request->fd, request->data.data() + request->offset,
+						   (unsigned)(request->size() - request->offset), request->offset);
+		io_uring_sqe_set_data(sqe, request);
+	}
+
+	void complete_uring(io_request* request, int result)
+	{
+		if (result > 0)
+		{
+			request->offset += (size_t)result;
+			if (request->offset < request->size())
+			{
+				// lectura corta: pide el resto
+				queue_read(request);
+				io_uring_submit(&_ring);
+				return;
+			}
+		}
+		// error, o fin de fichero antes de tiempo (truncado mientras se leia): no se da por bueno
+		bool ok = result >= 0 && request->offset == request->size();
+		close_request(*request);
+		request->state.store(ok ? io_done : io_failed, std::memory_order_release);
+		_in_flight.erase(std::remove_if(_in_flight.begin(), _in_flight.end(),
+						 [request](const io_handle& h) { return h.get() == request; }), _in_flight.end());
+	}
+
+	static void close_request(io_request& request)
+	{
+		if (request.fd >= 0)
+			::close(request.fd);
+		request.fd = -1;
+	}
+#endif
+
+protected:
+	worker_pool* _pool;
+	std::unique_ptr<worker_pool> _own_pool;
+	unsigned int _queue_depth;
+	std::deque<io_handle> _queued;
+#ifdef DUNE_IO_URING
+	io_uring _ring;
+	bool _ring_ok;
+	// mantiene vivos los buffers en vuelo
+	std::vector<io_handle> _in_flight;
+#endif
+};
+
+} // end namespace dune
+
+#endif // ASYNCIO_H
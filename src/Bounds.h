@@ -0,0 +1,94 @@
+/**
+@file Bounds.h
+
+Bounding volumes (AABB and sphere)
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace dune {
+
+struct aabb
+{
+	float min[3];
+	float max[3];
+
+	static aabb empty()
+	{
+		const float inf = std::numeric_limits<float>::max();
+		return aabb{{inf, inf, inf}, {-inf, -inf, -inf}};
+	}
+
+	bool is_empty() const
+	{
+		return min[0] > max[0];
+	}
+
+	void extend(const float* point)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			min[i] = std::min(min[i], point[i]);
+			max[i] = std::max(max[i], point[i]);
+		}
+	}
+
+	void extend(const aabb& other)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			min[i] = std::min(min[i], other.min[i]);
+			max[i] = std::max(max[i], other.max[i]);
+		}
+	}
+
+	void center(float* out) const
+	{
+		for (int i = 0; i < 3; ++i)
+			out[i] = (min[i] + max[i]) * 0.5f;
+	}
+
+	float radius() const
+	{
+		float dx = max[0] - min[0];
+		float dy = max[1] - min[1];
+		float dz = max[2] - min[2];
+		return 0.5f * std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+};
+
+struct sphere
+{
+	float center[3];
+	float radius;
+
+	static sphere from(const aabb& box)
+	{
+		sphere s;
+		box.center(s.center);
+		s.radius = box.radius();
+		return s;
+	}
+};
+
+// vertices con miembro position[3]
+template <typename V>
+aabb compute_aabb(const V* vertices, size_t count)
+{
+	aabb box = aabb::empty();
+	for (size_t i = 0; i < count; ++i)
+		box.extend(vertices[i].position);
+	return box;
+}
+
+} // end namespace dune
+
+#endif // BOUNDS_H
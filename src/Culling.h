@@ -0,0 +1,487 @@
+/**
+@file Culling.h
+
+Culling stage before IRenderable::render:
+	- frustum test over SoA bounds, 4 boxes per instruction (SSE) or 8 (AVX)
+	- optional occlusion with a hierarchical depth buffer rasterized
+	  in software on worker threads
+
+Matrices are column-major float[16] (OpenGL convention, clip = M * v).
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+#include "GeometryArray.h"
+#include "Bounds.h"
+#include "WorkerPool.h"
+
+namespace dune {
+
+struct frustum
+{
+	// planos ax + by + cz + d >= 0 dentro: left, right, bottom, top, near, far
+	float planes[6][4];
+
+	void build(const float* m)
+	{
+		// Gribb & Hartmann, filas de la matriz column-major
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int sign = 0; sign < 2; ++sign)
+			{
+				float* p = planes[i * 2 + sign];
+				float s = sign == 0 ? 1.0f : -1.0f;
+				for (int c = 0; c < 4; ++c)
+					p[c] = m[c * 4 + 3] + s * m[c * 4 + i];
+				float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+				if (len > 0.0f)
+					for (int c = 0; c < 4; ++c)
+						p[c] /= len;
+			}
+		}
+	}
+};
+
+/*
+Bounds in structure of arrays (center + half extents), padded to 8.
+*/
+class bounds_soa
+{
+public:
+	static const unsigned int LANES = 8;
+
+	unsigned int add(const aabb& box)
+	{
+		unsigned int index = _count++;
+		resize();
+		set(index, box);
+		return index;
+	}
+
+	void set(unsigned int index, const aabb& box)
+	{
+		_cx[index] = (box.min[0] + box.max[0]) * 0.5f;
+		_cy[index] = (box.min[1] + box.max[1]) * 0.5f;
+		_cz[index] = (box.min[2] + box.max[2]) * 0.5f;
+		_ex[index] = (box.max[0] - box.min[0]) * 0.5f;
+		_ey[index] = (box.max[1] - box.min[1]) * 0.5f;
+		_ez[index] = (box.max[2] - box.min[2]) * 0.5f;
+	}
+
+	aabb get(unsigned int index) const
+	{
+		return aabb{{_cx[index] - _ex[index], _cy[index] - _ey[index], _cz[index] - _ez[index]},
+					{_cx[index] + _ex[index], _cy[index] + _ey[index], _cz[index] + _ez[index]}};
+	}
+
+	// swap con el ultimo (remove O(1)), devuelve el indice que se ha movido
+	unsigned int remove(unsigned int index)
+	{
+		unsigned int last = --_count;
+		_cx[index] = _cx[last]; _cy[index] = _cy[last]; _cz[index] = _cz[last];
+		_ex[index] = _ex[last]; _ey[index] = _ey[last]; _ez[index] = _ez[last];
+		clear_lane(last);
+		return last;
+	}
+
+	unsigned int size() const { return _count; }
+
+	/*
+	visible[i] = 1 if box i intersects the frustum.
+	*/
+	void test(const frustum& f, unsigned char* visible) const
+	{
+		unsigned int i = 0;
+#if defined(__AVX__)
+		for (; i + 8 <= padded(); i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(&_cx[i]), cy = _mm256_loadu_ps(&_cy[i]), cz = _mm256_loadu_ps(&_cz[i]);
+			__m256 ex = _mm256_loadu_ps(&_ex[i]), ey = _mm256_loadu_ps(&_ey[i]), ez = _mm256_loadu_ps(&_ez[i]);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p)
+			{
+				const float* pl = f.planes[p];
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(pl[0])), _mm256_mul_ps(cy, _mm256_set1_ps(pl[1]))),
+										_mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(pl[2])), _mm256_set1_ps(pl[3])));
+				__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(pl[0]))), _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(pl[1])))),
+										_mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(pl[2]))));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			int mask = _mm256_movemask_ps(inside);
+			for (int k = 0; k < 8; ++k)
+				visible[i + k] = (unsigned char)((mask >> k) & 1);
+		}
+#elif defined(__SSE__) || defined(_M_X64)
+		for (; i + 4 <= padded(); i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&_cx[i]), cy = _mm_loadu_ps(&_cy[i]), cz = _mm_loadu_ps(&_cz[i]);
+			__m128 ex = _mm_loadu_ps(&_ex[i]), ey = _mm_loadu_ps(&_ey[i]), ez = _mm_loadu_ps(&_ez[i]);
+			__m128 inside = _mm_cmpeq_ps(cx, cx);
+			for (int p = 0; p < 6; ++p)
+			{
+				const float* pl = f.planes[p];
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(pl[0])), _mm_mul_ps(cy, _mm_set1_ps(pl[1]))),
+									_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(pl[2])), _mm_set1_ps(pl[3])));
+				__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(pl[0]))), _mm_mul_ps(ey, _mm_set1_ps(std::fabs(pl[1])))),
+									_mm_mul_ps(ez, _mm_set1_ps(std::fabs(pl[2]))));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+			}
+			int mask = _mm_movemask_ps(inside);
+			for (int k = 0; k < 4; ++k)
+				visible[i + k] = (unsigned char)((mask >> k) & 1);
+		}
+#endif
+		for (; i < _count; ++i)
+		{
+			unsigned char inside = 1;
+			for (int p = 0; p < 6 && inside; ++p)
+			{
+				const float* pl = f.planes[p];
+				float d = _cx[i] * pl[0] + _cy[i] * pl[1] + _cz[i] * pl[2] + pl[3];
+				float r = _ex[i] * std::fabs(pl[0]) + _ey[i] * std::fabs(pl[1]) + _ez[i] * std::fabs(pl[2]);
+				inside = (d + r) >= 0.0f;
+			}
+			visible[i] = inside;
+		}
+	}
+
+	// tamaño de los arrays (multiplo de LANES), visible debe tener este tamaño
+	unsigned int padded() const
+	{
+		return (_count + LANES - 1) / LANES * LANES;
+	}
+
+protected:
+	void resize()
+	{
+		unsigned int n = padded();
+		if (_cx.size() < n)
+		{
+			_cx.resize(n, 0.0f); _cy.resize(n, 0.0f); _cz.resize(n, 0.0f);
+			_ex.resize(n, 0.0f); _ey.resize(n, 0.0f); _ez.resize(n, 0.0f);
+		}
+	}
+
+	void clear_lane(unsigned int index)
+	{
+		_cx[index] = _cy[index] = _cz[index] = 0.0f;
+		_ex[index] = _ey[index] = _ez[index] = 0.0f;
+	}
+
+protected:
+	std::vector<float> _cx, _cy, _cz;
+	std::vector<float> _ex, _ey, _ez;
+	unsigned int _count = 0;
+};
+
+/*
+Hierarchical depth buffer (depth in [0, 1], 1 = far). Occluders are
+rasterized in horizontal bands, one band per job. Mip levels keep
+the farthest depth, a box is occluded if its nearest depth is behind.
+*/
+class depth_pyramid
+{
+public:
+	depth_pyramid(unsigned int width = 256, unsigned int height = 128)
+		: _width(width)
+		, _height(height)
+	{
+		unsigned int w = width, h = height;
+		while (true)
+		{
+			_levels.push_back({w, h, std::vector<float>(w * h, 1.0f)});
+			if (w == 1 && h == 1)
+				break;
+			w = std::max(1u, w / 2);
+			h = std::max(1u, h / 2);
+		}
+	}
+
+	void clear()
+	{
+		for (auto& level : _levels)
+			std::fill(level.depth.begin(), level.depth.end(), 1.0f);
+		_triangles.clear();
+	}
+
+	/*
+	Adds occluder triangles (positions xyz, 3 indexes per triangle) transformed by m.
+	Triangles crossing the near plane are discarded (conservative).
+	*/
+	void add_occluder(const float* m, const float* positions, const unsigned int* indexes, size_t index_count)
+	{
+		for (size_t t = 0; t + 2 < index_count; t += 3)
+		{
+			screen_triangle tri;
+			bool valid = true;
+			for (int k = 0; k < 3 && valid; ++k)
+			{
+				const float* p = &positions[indexes[t + k] * 3];
+				float clip[4];
+				transform(m, p, clip);
+				if (clip[3] <= 1e-5f)
+				{
+					valid = false;
+					break;
+				}
+				float inv_w = 1.0f / clip[3];
+				tri.x[k] = (clip[0] * inv_w * 0.5f + 0.5f) * _width;
+				tri.y[k] = (clip[1] * inv_w * 0.5f + 0.5f) * _height;
+				tri.z[k] = clip[2] * inv_w * 0.5f + 0.5f;
+			}
+			if (valid)
+				_triangles.push_back(tri);
+		}
+	}
+
+	void rasterize(worker_pool& pool, unsigned int band_height = 16)
+	{
+		level& base = _levels[0];
+		unsigned int bands = (_height + band_height - 1) / band_height;
+		pool.parallel_for(bands, [&](unsigned int band) {
+			int y0 = (int)(band * band_height);
+			int y1 = std::min((int)_height, y0 + (int)band_height);
+			for (const screen_triangle& tri : _triangles)
+				rasterize_triangle(base, tri, y0, y1);
+		});
+		build_mips();
+	}
+
+	// box en mundo, m = view_projection
+	bool is_occluded(const float* m, const aabb& box) const
+	{
+		float min_x = 1e30f, min_y = 1e30f, max_x = -1e30f, max_y = -1e30f;
+		float min_z = 1.0f;
+		for (int c = 0; c < 8; ++c)
+		{
+			float p[3] = {(c & 1) ? box.max[0] : box.min[0], (c & 2) ? box.max[1] : box.min[1], (c & 4) ? box.max[2] : box.min[2]};
+			float clip[4];
+			transform(m, p, clip);
+			if (clip[3] <= 1e-5f)
+				return false;  // cruza el near plane: visible
+			float inv_w = 1.0f / clip[3];
+			float sx = (clip[0] * inv_w * 0.5f + 0.5f) * _width;
+			float sy = (clip[1] * inv_w * 0.5f + 0.5f) * _height;
+			min_x = std::min(min_x, sx); max_x = std::max(max_x, sx);
+			min_y = std::min(min_y, sy); max_y = std::max(max_y, sy);
+			min_z = std::min(min_z, clip[2] * inv_w * 0.5f + 0.5f);
+		}
+
+		int x0 = std::max(0, (int)std::floor(min_x)), y0 = std::max(0, (int)std::floor(min_y));
+		int x1 = std::min((int)_width - 1, (int)std::floor(max_x)), y1 = std::min((int)_height - 1, (int)std::floor(max_y));
+		if (x0 > x1 || y0 > y1)
+			return false;  // fuera de pantalla, de eso se encarga el frustum
+
+		// nivel donde el rectangulo ocupa como mucho 2x2 texels
+		unsigned int mip = 0;
+		int extent = std::max(x1 - x0, y1 - y0);
+		while (extent > 1 && mip + 1 < _levels.size())
+		{
+			extent >>= 1;
+			++mip;
+		}
+		const level& l = _levels[mip];
+		int lx0 = std::min((int)l.width - 1, x0 >> mip), lx1 = std::min((int)l.width - 1, x1 >> mip);
+		int ly0 = std::min((int)l.height - 1, y0 >> mip), ly1 = std::min((int)l.height - 1, y1 >> mip);
+		for (int y = ly0; y <= ly1; ++y)
+			for (int x = lx0; x <= lx1; ++x)
+				if (min_z <= l.depth[y * l.width + x])
+					return false;
+		return true;
+	}
+
+protected:
+	struct level
+	{
+		unsigned int width;
+		unsigned int height;
+		std::vector<float> depth;
+	};
+
+	struct screen_triangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+	};
+
+	static void transform(const float* m, const float* p, float* out)
+	{
+		for (int r = 0; r < 4; ++r)
+			out[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+	}
+
+	void rasterize_triangle(level& l, const screen_triangle& tri, int y0, int y1) const
+	{
+		float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+		if (std::fabs(area) < 1e-8f)
+			return;
+		float inv_area = 1.0f / area;
+
+		int min_x = std::max(0, (int)std::floor(std::min({tri.x[0], tri.x[1], tri.x[2]})));
+		int max_x = std::min((int)l.width - 1, (int)std::ceil(std::max({tri.x[0], tri.x[1], tri.x[2]})));
+		int min_y = std::max(y0, (int)std::floor(std::min({tri.y[0], tri.y[1], tri.y[2]})));
+		int max_y = std::min(y1 - 1, (int)std::ceil(std::max({tri.y[0], tri.y[1], tri.y[2]})));
+
+		for (int y = min_y; y <= max_y; ++y)
+		{
+			float py = y + 0.5f;
+			for (int x = min_x; x <= max_x; ++x)
+			{
+				float px = x + 0.5f;
+				// coordenadas baricentricas (cualquier winding)
+				float w0 = ((tri.x[1] - px) * (tri.y[2] - py) - (tri.x[2] - px) * (tri.y[1] - py)) * inv_area;
+				float w1 = ((tri.x[2] - px) * (tri.y[0] - py) - (tri.x[0] - px) * (tri.y[2] - py)) * inv_area;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+				float z = w0 * tri.z[0] + w1 * tri.z[1] + w2 * tri.z[2];
+				float& dst = l.depth[y * l.width + x];
+				if (z >= 0.0f && z < dst)
+					dst = z;
+			}
+		}
+	}
+
+	void build_mips()
+	{
+		for (size_t i = 1; i < _levels.size(); ++i)
+		{
+			const level& src = _levels[i - 1];
+			level& dst = _levels[i];
+			for (unsigned int y = 0; y < dst.height; ++y)
+			{
+				for (unsigned int x = 0; x < dst.width; ++x)
+				{
+					// texels impares del borde: se incluyen en el ultimo
+					unsigned int sx0 = x * 2, sy0 = y * 2;
+					unsigned int sx1 = (x + 1 == dst.width) ? src.width - 1 : std::min(src.width - 1, sx0 + 1);
+					unsigned int sy1 = (y + 1 == dst.height) ? src.height - 1 : std::min(src.height - 1, sy0 + 1);
+					float farthest = 0.0f;
+					for (unsigned int sy = sy0; sy <= sy1; ++sy)
+						for (unsigned int sx = sx0; sx <= sx1; ++sx)
+							farthest = std::max(farthest, src.depth[sy * src.width + sx]);
+					dst.depth[y * dst.width + x] = farthest;
+				}
+			}
+		}
+	}
+
+protected:
+	unsigned int _width;
+	unsigned int _height;
+	std::vector<level> _levels;
+	std::vector<screen_triangle> _triangles;
+};
+
+/*
+Registered renderables with their bounds. cull() computes the visible
+list, render() only draws visible ones.
+*/
+class cull_stage
+{
+public:
+	explicit cull_stage(worker_pool* pool = nullptr)
+		: _pool(pool)
+		, _occlusion(false)
+	{
+
+	}
+
+	unsigned int add(IRenderable* renderable, const aabb& box)
+	{
+		unsigned int slot = _bounds.add(box);
+		_items.push_back(renderable);
+		unsigned int handle = (unsigned int)_slot_of.size();
+		_slot_of.push_back(slot);
+		_handle_of.push_back(handle);
+		return handle;
+	}
+
+	void update(unsigned int handle, const aabb& box)
+	{
+		_bounds.set(_slot_of[handle], box);
+	}
+
+	void remove(unsigned int handle)
+	{
+		unsigned int slot = _slot_of[handle];
+		unsigned int moved = _bounds.remove(slot);
+		_items[slot] = _items[moved];
+		_handle_of[slot] = _handle_of[moved];
+		_slot_of[_handle_of[slot]] = slot;
+		_items.pop_back();
+		_handle_of.pop_back();
+		_slot_of[handle] = (unsigned int)-1;
+	}
+
+	// necesita un worker_pool
+	void set_occlusion(bool enable)
+	{
+		_occlusion = enable && _pool;
+	}
+
+	depth_pyramid& occluders()
+	{
+		return _depth;
+	}
+
+	void cull(const float* view_projection)
+	{
+		frustum f;
+		f.build(view_projection);
+		_visible_mask.resize(_bounds.padded());
+		_bounds.test(f, _visible_mask.data());
+
+		if (_occlusion)
+			_depth.rasterize(*_pool);
+
+		_visible.clear();
+		for (unsigned int i = 0; i < _bounds.size(); ++i)
+		{
+			if (!_visible_mask[i])
+				continue;
+			if (_occlusion && _depth.is_occluded(view_projection, _bounds.get(i)))
+				continue;
+			_visible.push_back(_items[i]);
+		}
+	}
+
+	void render(GLenum mode = GL_TRIANGLES)
+	{
+		for (IRenderable* renderable : _visible)
+			renderable->render(mode);
+	}
+
+	const std::vector<IRenderable*>& visible() const { return _visible; }
+
+protected:
+	worker_pool* _pool;
+	bool _occlusion;
+	bounds_soa _bounds;
+	// slot -> renderable
+	std::vector<IRenderable*> _items;
+	std::vector<unsigned int> _handle_of;
+	// handle -> slot
+	std::vector<unsigned int> _slot_of;
+	std::vector<unsigned char> _visible_mask;
+	std::vector<IRenderable*> _visible;
+	depth_pyramid _depth;
+};
+
+} // end namespace dune
+
+#endif // CULLING_H
@@ -0,0 +1,177 @@
+/**
+@file FrameArena.h
+
+Per frame linear allocator. allocate() is a lock-free bump of a cursor,
+so several threads can take disjoint ranges at the same time; reset()
+frees everything at once at the start of the frame. If a frame runs
+out of space the allocation fails and the next reset() grows the block
+to the high water mark.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+namespace dune {
+
+// rango escribible; first = posicion del primer elemento en el lote
+template <typename T>
+struct span
+{
+	T* data = nullptr;
+	size_t size = 0;
+	unsigned int first = 0;
+
+	T* begin() const { return data; }
+	T* end() const { return data + size; }
+	T& operator[](size_t i) const { return data[i]; }
+	bool empty() const { return size == 0; }
+};
+
+class frame_arena
+{
+public:
+	explicit frame_arena(size_t capacity = 0)
+		: _capacity(0)
+		, _cursor(0)
+		, _high_water(0)
+	{
+		reserve(capacity);
+	}
+
+	frame_arena(const frame_arena&) = delete;
+	frame_arena& operator=(const frame_arena&) = delete;
+
+	// thread safe; nullptr si no cabe
+	void* allocate(size_t bytes, size_t align = 16)
+	{
+		size_t cursor = _cursor.load(std::memory_order_relaxed);
+		while (true)
+		{
+			uintptr_t address = (uintptr_t)_block.get() + cursor;
+			size_t start = cursor + (size_t)((align - (address & (align - 1))) & (align - 1));
+			size_t end = start + bytes;
+			if (end > _capacity)
+			{
+				note_overflow(end);
+				return nullptr;
+			}
+			if (_cursor.compare_exchange_weak(cursor, end, std::memory_order_relaxed))
+				return _block.get() + start;
+		}
+	}
+
+	template <typename T>
+	span<T> allocate_span(size_t count)
+	{
+		span<T> result;
+		result.data = (T*)allocate(sizeof(T) * count, alignof(T) < 16 ? 16 : alignof(T));
+		result.size = result.data ? count : 0;
+		return result;
+	}
+
+	// sin allocates en curso: al principio del frame
+	void reset()
+	{
+		size_t high_water = _high_water.exchange(0, std::memory_order_relaxed);
+		if (high_water > _capacity)
+			reserve(high_water + high_water / 2);
+		_cursor.store(0, std::memory_order_relaxed);
+	}
+
+	// sin allocates en curso; descarta lo reservado
+	void reserve(size_t bytes)
+	{
+		if (bytes <= _capacity)
+			return;
+		_block.reset(new unsigned char[bytes]);
+		_capacity = bytes;
+		_cursor.store(0, std::memory_order_relaxed);
+	}
+
+	size_t used() const { return _cursor.load(std::memory_order_relaxed); }
+	size_t capacity() const { return _capacity; }
+
+protected:
+	void note_overflow(size_t needed)
+	{
+		size_t current = _high_water.load(std::memory_order_relaxed);
+		while (needed > current && !_high_water.compare_exchange_weak(current, needed, std::memory_order_relaxed))
+			;
+	}
+
+protected:
+	std::unique_ptr<unsigned char[]> _block;
+	size_t _capacity;
+	std::atomic<size_t> _cursor;
+	std::atomic<size_t> _high_water;
+};
+
+/*
+Batch of up to max elements taken from an arena in one piece;
+reserve(n) hands out disjoint spans from several threads.
+*/
+template <typename T>
+class bulk_range
+{
+public:
+	bulk_range()
+		: _data(nullptr)
+		, _max(0)
+		, _cursor(0)
+	{
+
+	}
+
+	bool begin(frame_arena& arena, size_t max)
+	{
+		span<T> block = arena.template allocate_span<T>(max);
+		_data = block.data;
+		_max = block.size;
+		_cursor.store(0, std::memory_order_relaxed);
+		return _data != nullptr || max == 0;
+	}
+
+	// thread safe; span vacio si no cabe (el cursor no avanza)
+	span<T> reserve(size_t count)
+	{
+		span<T> result;
+		size_t cursor = _cursor.load(std::memory_order_relaxed);
+		do
+		{
+			if (cursor + count > _max)
+				return result;
+		} while (!_cursor.compare_exchange_weak(cursor, cursor + count, std::memory_order_relaxed));
+		result.data = _data + cursor;
+		result.size = count;
+		result.first = (unsigned int)cursor;
+		return result;
+	}
+
+	// despues de que todos los hilos hayan escrito
+	size_t count() const { return _cursor.load(std::memory_order_acquire); }
+	const T* data() const { return _data; }
+
+	void clear()
+	{
+		_data = nullptr;
+		_max = 0;
+		_cursor.store(0, std::memory_order_relaxed);
+	}
+
+protected:
+	T* _data;
+	size_t _max;
+	std::atomic<size_t> _cursor;
+};
+
+} // end namespace dune
+
+#endif // FRAMEARENA_H
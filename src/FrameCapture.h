@@ -0,0 +1,424 @@
+/**
+@file FrameCapture.h
+
+Frame capture without stalls: glReadPixels writes into a ring of pixel
+pack buffers (PBO) protected by fences, the frame is mapped some frames
+later and a worker thread encodes it (PNG with FreeImage or a Y4M
+sequence). Pixel buffers are recycled, no allocation once warm.
+
+At most max_pending frames wait for the encoder. When it falls behind,
+new frames are dropped (counted in dropped()) or, with capture_block,
+the render thread waits for it.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <FreeImage.h>
+
+namespace dune {
+
+enum capture_format
+{
+	capture_png,
+	capture_y4m
+};
+
+// con la cola llena
+enum capture_overflow
+{
+	capture_drop,
+	capture_block
+};
+
+class frame_capture
+{
+public:
+	/*
+	output: PNG pattern with one %d or %0Nd for the frame number
+	("frame_%05d.png") or a .y4m file.
+	latency: frames between glReadPixels and the map (PBO ring size).
+	*/
+	frame_capture(const std::string& output, GLsizei width, GLsizei height, unsigned int latency = 3, int fps = 60,
+				  unsigned int max_pending = 8, capture_overflow overflow = capture_drop)
+		: _output(output)
+		, _width(width)
+		, _height(height)
+		, _fps(fps)
+		, _frame(0)
+		, _digits(0)
+		, _max_pending(max_pending < 1 ? 1 : max_pending)
+		, _overflow(overflow)
+		, _dropped(0)
+		, _stop(false)
+		, _y4m(nullptr)
+	{
+		_format = (output.size() > 4 && output.compare(output.size() - 4, 4, ".y4m") == 0) ? capture_y4m : capture_png;
+		if (_format == capture_png)
+			parse_pattern(output);
+		if (_format == capture_y4m)
+		{
+			_y4m = std::fopen(output.c_str(), "wb");
+			if (_y4m)
+				std::fprintf(_y4m, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", (int)width, (int)height, fps);
+		}
+
+		_slots.resize(latency < 1 ? 1 : latency);
+		for (slot& s : _slots)
+		{
+			glGenBuffers(1, &s.pbo);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+			glBufferData(GL_PIXEL_PACK_BUFFER, frame_bytes(), NULL, GL_STREAM_READ);
+			s.fence = 0;
+			s.frame = 0;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		_next_slot = 0;
+
+		_worker = std::thread([this]() { encode_loop(); });
+	}
+
+	~frame_capture()
+	{
+		finish();
+		for (slot& s : _slots)
+			glDeleteBuffers(1, &s.pbo);
+	}
+
+	frame_capture(const frame_capture&) = delete;
+	frame_capture& operator=(const frame_capture&) = delete;
+
+	/*
+	Queues the readback of the current frame of fbo (0 = window) and
+	collects the oldest one if its fence has signaled.
+	*/
+	void capture(GLuint fbo)
+	{
+		slot& s = _slots[_next_slot];
+		if (s.fence)
+		{
+			// el ring ha dado la vuelta: este slot tiene que salir ya
+			collect(s, true);
+		}
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		glReadBuffer(fbo ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		s.frame = _frame++;
+		_next_slot = (_next_slot + 1) % _slots.size();
+
+		// el mas antiguo, solo si la GPU ya ha terminado
+		slot& oldest = _slots[_next_slot];
+		if (oldest.fence)
+			collect(oldest, false);
+	}
+
+	// recoge lo pendiente y espera al encoder
+	void finish()
+	{
+		if (!_worker.joinable())
+			return;
+		for (size_t i = 0; i < _slots.size(); ++i)
+		{
+			slot& s = _slots[(_next_slot + i) % _slots.size()];
+			if (s.fence)
+				collect(s, true);
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_cond.notify_all();
+		_worker.join();
+		if (_y4m)
+		{
+			std::fclose(_y4m);
+			_y4m = nullptr;
+		}
+	}
+
+	unsigned int captured() const { return _frame; }
+
+	// frames perdidos porque el encoder no daba abasto
+	unsigned int dropped() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _dropped;
+	}
+
+protected:
+	struct slot
+	{
+		GLuint pbo;
+		GLsync fence;
+		unsigned int frame;
+	};
+
+	struct pending_frame
+	{
+		unsigned int frame;
+		std::vector<unsigned char> pixels;
+	};
+
+	size_t frame_bytes() const
+	{
+		return (size_t)_width * _height * 4;
+	}
+
+	void collect(slot& s, bool wait)
+	{
+		GLenum result = glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GLuint64(1000000000) : 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+		{
+			if (!wait)
+				return;
+		}
+		glDeleteSync(s.fence);
+		s.fence = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if (_overflow == capture_block)
+			{
+				_space.wait(lock, [this]() { return _queue.size() < _max_pending; });
+			}
+			else if (_queue.size() >= _max_pending)
+			{
+				++_dropped;
+				return;
+			}
+		}
+
+		pending_frame job;
+		job.frame = s.frame;
+		job.pixels = acquire_buffer();
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+		const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_bytes(), GL_MAP_READ_BIT);
+		if (data)
+		{
+			std::memcpy(job.pixels.data(), data, frame_bytes());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (data)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queue.emplace_back(std::move(job));
+		}
+		else
+		{
+			release_buffer(std::move(job.pixels));
+		}
+		_cond.notify_one();
+	}
+
+	std::vector<unsigned char> acquire_buffer()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_free.empty())
+			return std::vector<unsigned char>(frame_bytes());
+		std::vector<unsigned char> buffer = std::move(_free.back());
+		_free.pop_back();
+		return buffer;
+	}
+
+	void release_buffer(std::vector<unsigned char>&& buffer)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_free.emplace_back(std::move(buffer));
+	}
+
+	void encode_loop()
+	{
+		while (true)
+		{
+			pending_frame job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cond.wait(lock, [this]() { return _stop || !_queue.empty(); });
+				if (_queue.empty())
+					return;
+				job = std::move(_queue.front());
+				_queue.pop_front();
+			}
+			_space.notify_one();
+			if (_format == capture_png)
+				write_png(job);
+			else
+				write_y4m(job);
+			release_buffer(std::move(job.pixels));
+		}
+	}
+
+	/*
+	Splits the PNG pattern around its only %d / %0Nd ("%%" is a literal
+	'%'). The pattern is never handed to printf; without a valid
+	conversion the number goes before the extension.
+	*/
+	void parse_pattern(const std::string& pattern)
+	{
+		_prefix.clear();
+		_suffix.clear();
+		_digits = 0;
+		bool found = false;
+		bool valid = true;
+		for (size_t i = 0; i < pattern.size() && valid; ++i)
+		{
+			std::string& part = found ? _suffix : _prefix;
+			if (pattern[i] != '%')
+			{
+				part += pattern[i];
+				continue;
+			}
+			if (i + 1 < pattern.size() && pattern[i + 1] == '%')
+			{
+				part += '%';
+				++i;
+				continue;
+			}
+			size_t j = i + 1;
+			int digits = 0;
+			if (j < pattern.size() && pattern[j] == '0')
+			{
+				++j;
+				if (j < pattern.size() && pattern[j] >= '1' && pattern[j] <= '9')
+					digits = pattern[j++] - '0';
+				else
+					valid = false;
+			}
+			if (found || j >= pattern.size() || pattern[j] != 'd')
+				valid = false;
+			found = true;
+			_digits = digits;
+			i = j;
+		}
+		if (!valid || !found)
+		{
+			LOGE("Capture pattern %s: needs one %%d or %%0Nd", pattern.c_str());
+			size_t dot = pattern.rfind('.');
+			_prefix = pattern.substr(0, dot) + "_";
+			_suffix = (dot == std::string::npos) ? ".png" : pattern.substr(dot);
+			_digits = 5;
+		}
+	}
+
+	void write_png(pending_frame& job)
+	{
+		char number[16];
+		std::snprintf(number, sizeof(number), "%0*u", _digits, job.frame);
+		std::string filename = _prefix + number + _suffix;
+		// GL entrega RGBA de abajo a arriba; FreeImage espera BGRA
+		unsigned char* p = job.pixels.data();
+		for (size_t i = 0; i < job.pixels.size(); i += 4)
+			std::swap(p[i], p[i + 2]);
+		FIBITMAP* bitmap = FreeImage_ConvertFromRawBits(p, _width, _height, _width * 4, 32,
+														FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, FALSE);
+		if (bitmap)
+		{
+			FreeImage_Save(FIF_PNG, bitmap, filename.c_str(), PNG_Z_BEST_SPEED);
+			FreeImage_Unload(bitmap);
+		}
+	}
+
+	void write_y4m(pending_frame& job)
+	{
+		if (!_y4m)
+			return;
+		const int w = _width, h = _height;
+		const int cw = (w + 1) / 2, ch = (h + 1) / 2;
+		_yuv.resize((size_t)w * h + 2 * (size_t)cw * ch);
+		unsigned char* y_plane = _yuv.data();
+		unsigned char* u_plane = y_plane + (size_t)w * h;
+		unsigned char* v_plane = u_plane + (size_t)cw * ch;
+		const unsigned char* rgba = job.pixels.data();
+
+		// BT.601 full range (C420jpeg); filas invertidas (GL de abajo a arriba)
+		for (int y = 0; y < h; ++y)
+		{
+			const unsigned char* row = rgba + (size_t)(h - 1 - y) * w * 4;
+			for (int x = 0; x < w; ++x)
+			{
+				int r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+				y_plane[(size_t)y * w + x] = (unsigned char)((77 * r + 150 * g + 29 * b) >> 8);
+			}
+		}
+		for (int y = 0; y < ch; ++y)
+		{
+			for (int x = 0; x < cw; ++x)
+			{
+				int r = 0, g = 0, b = 0, n = 0;
+				for (int dy = 0; dy < 2; ++dy)
+				{
+					int sy = std::min(2 * y + dy, h - 1);
+					const unsigned char* row = rgba + (size_t)(h - 1 - sy) * w * 4;
+					for (int dx = 0; dx < 2; ++dx)
+					{
+						int sx = std::min(2 * x + dx, w - 1);
+						r += row[sx * 4]; g += row[sx * 4 + 1]; b += row[sx * 4 + 2];
+						++n;
+					}
+				}
+				r /= n; g /= n; b /= n;
+				u_plane[(size_t)y * cw + x] = (unsigned char)std::max(0, std::min(255, ((-43 * r - 85 * g + 128 * b) >> 8) + 128));
+				v_plane[(size_t)y * cw + x] = (unsigned char)std::max(0, std::min(255, ((128 * r - 107 * g - 21 * b) >> 8) + 128));
+			}
+		}
+		std::fputs("FRAME\n", _y4m);
+		std::fwrite(_yuv.data(), 1, _yuv.size(), _y4m);
+	}
+
+protected:
+	std::string _output;
+	capture_format _format;
+	GLsizei _width;
+	GLsizei _height;
+	int _fps;
+	unsigned int _frame;
+	// nombre de los PNG: prefijo + numero con _digits cifras + sufijo
+	std::string _prefix;
+	std::string _suffix;
+	int _digits;
+
+	std::vector<slot> _slots;
+	size_t _next_slot;
+
+	std::thread _worker;
+	mutable std::mutex _mutex;
+	std::condition_variable _cond;
+	// el encoder ha sacado un frame de la cola
+	std::condition_variable _space;
+	std::deque<pending_frame> _queue;
+	unsigned int _max_pending;
+	capture_overflow _overflow;
+	unsigned int _dropped;
+	std::vector<std::vector<unsigned char> > _free;
+	bool _stop;
+
+	FILE* _y4m;
+	// solo lo usa el worker
+	std::vector<unsigned char> _yuv;
+};
+
+} // end namespace dune
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,302 @@
+/**
+@file FrameLog.h
+
+Logging for the frame path. Messages are formatted with snprintf into
+fixed records of a preallocated ring and a background thread forwards
+them to the spdlog logger, so the frame never blocks on the sink nor
+allocates. On top of that:
+	- levels under DUNE_FRAME_LOG_LEVEL are removed at compile time
+	- the same message from the same call site is rate limited; the
+	  repeats are reported by tick() once the interval has passed (or at
+	  shutdown), different messages of a site are not affected
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef FRAMELOG_H
+#define FRAMELOG_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include "InputQueue.h"
+
+// 0 trace, 1 debug, 2 info, 3 warn, 4 error, 5 off (igual que spdlog::level)
+#ifndef DUNE_FRAME_LOG_LEVEL
+#ifdef NDEBUG
+#define DUNE_FRAME_LOG_LEVEL 2
+#else
+#define DUNE_FRAME_LOG_LEVEL 1
+#endif
+#endif
+
+namespace dune {
+
+// handle cacheado: spdlog::get hace un lookup con mutex en cada llamada
+// (el logger "console" tiene que existir antes de la primera llamada)
+inline spdlog::logger& console()
+{
+	static std::shared_ptr<spdlog::logger> logger = spdlog::get("console");
+	return *logger;
+}
+
+const size_t FRAME_LOG_TEXT_SIZE = 116;
+
+// estado por sitio de llamada (static dentro de la macro): los ultimos mensajes distintos
+struct log_site
+{
+	static const size_t SLOTS = 4;
+
+	struct entry
+	{
+		uint64_t hash = 0;
+		uint64_t last_ns = 0;
+		unsigned int suppressed = 0;
+		spdlog::level::level_enum level = spdlog::level::info;
+		char text[FRAME_LOG_TEXT_SIZE];
+	};
+
+	entry entries[SLOTS];
+	bool registered = false;
+};
+
+class frame_log
+{
+public:
+	static const size_t TEXT_SIZE = FRAME_LOG_TEXT_SIZE;
+	static const size_t RING_SIZE = 1024;
+	static const size_t MAX_SITES = 256;
+
+	/*
+	interval: minimum time between two messages of the same call site.
+	Only one thread may write (the frame thread).
+	*/
+	explicit frame_log(std::shared_ptr<spdlog::logger> logger,
+					   std::chrono::milliseconds interval = std::chrono::milliseconds(250),
+					   std::chrono::milliseconds flush = std::chrono::milliseconds(5))
+		: _logger(std::move(logger))
+		, _interval_ns((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count())
+		, _flush(flush)
+		, _stop(false)
+		, _site_count(0)
+		, _previous(current())
+	{
+		_worker = std::thread([this]() {
+			while (!_stop.load(std::memory_order_acquire))
+			{
+				flush_pending();
+				std::this_thread::sleep_for(_flush);
+			}
+			flush_pending();
+		});
+		current() = this;
+	}
+
+	~frame_log()
+	{
+		// las repeticiones pendientes no se pierden al salir
+		flush_suppressed(true);
+		current() = _previous;
+		_stop.store(true, std::memory_order_release);
+		_worker.join();
+		_logger->flush();
+	}
+
+	frame_log(const frame_log&) = delete;
+	frame_log& operator=(const frame_log&) = delete;
+
+	// instancia usada por las macros FRAME_LOG*
+	static frame_log*& current()
+	{
+		static frame_log* instance = nullptr;
+		return instance;
+	}
+
+	template <typename... Args>
+	void write(log_site& site, spdlog::level::level_enum level, const char* format, Args... args)
+	{
+		record r;
+		r.level = level;
+		r.repeats = 0;
+		r.summary = false;
+		format_text(r.text, format, args...);
+		uint64_t hash = hash_text(r.text);
+		uint64_t now = input_clock_ns();
+		if (!site.registered && _site_count < MAX_SITES)
+		{
+			site.registered = true;
+			_sites[_site_count++] = &site;
+		}
+
+		// el mismo mensaje: limitado; si no, ocupa el hueco mas antiguo
+		log_site::entry* slot = &site.entries[0];
+		for (log_site::entry& e : site.entries)
+		{
+			if (e.last_ns != 0 && e.hash == hash)
+			{
+				slot = &e;
+				break;
+			}
+			if (e.last_ns < slot->last_ns)
+				slot = &e;
+		}
+		if (slot->last_ns != 0 && slot->hash == hash)
+		{
+			if (now - slot->last_ns < _interval_ns)
+			{
+				++slot->suppressed;
+				return;
+			}
+			r.repeats = slot->suppressed;
+		}
+		else
+		{
+			push_summary(*slot);
+			slot->hash = hash;
+			slot->level = level;
+			std::memcpy(slot->text, r.text, TEXT_SIZE);
+		}
+		slot->last_ns = now;
+		slot->suppressed = 0;
+		// lleno: se descarta, nunca espera
+		_ring.push(r);
+	}
+
+	/*
+	From the frame thread, once per frame: reports the messages that were
+	suppressed and whose interval has already passed.
+	*/
+	void tick()
+	{
+		flush_suppressed(false);
+	}
+
+	size_t dropped() const { return _ring.dropped(); }
+
+protected:
+	struct record
+	{
+		spdlog::level::level_enum level;
+		unsigned int repeats;
+		// solo el recuento de repeticiones de text
+		bool summary;
+		char text[TEXT_SIZE];
+	};
+
+	static uint64_t hash_text(const char* text)
+	{
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+		for (; *text; ++text)
+			hash = (hash ^ (unsigned char)*text) * 1099511628211ull;
+		return hash;
+	}
+
+	void push_summary(log_site::entry& e)
+	{
+		if (!e.suppressed)
+			return;
+		record r;
+		r.level = e.level;
+		r.repeats = e.suppressed;
+		r.summary = true;
+		std::memcpy(r.text, e.text, TEXT_SIZE);
+		_ring.push(r);
+		e.suppressed = 0;
+	}
+
+	void flush_suppressed(bool all)
+	{
+		uint64_t now = input_clock_ns();
+		for (size_t i = 0; i < _site_count; ++i)
+		{
+			for (log_site::entry& e : _sites[i]->entries)
+			{
+				if (e.suppressed && (all || now - e.last_ns >= _interval_ns))
+				{
+					push_summary(e);
+					// el siguiente igual vuelve a esperar el intervalo
+					e.last_ns = now;
+				}
+			}
+		}
+	}
+
+	static void format_text(char* out, const char* text)
+	{
+		std::snprintf(out, TEXT_SIZE, "%s", text);
+	}
+
+	template <typename... Args>
+	static void format_text(char* out, const char* format, Args... args)
+	{
+		std::snprintf(out, TEXT_SIZE, format, args...);
+	}
+
+	void flush_pending()
+	{
+		_ring.drain([this](const record& r) {
+			if (r.summary)
+				_logger->log(r.level, "{} (repeated {} times)", r.text, r.repeats);
+			else if (r.repeats)
+				_logger->log(r.level, "{} (+{} suppressed)", r.text, r.repeats);
+			else
+				_logger->log(r.level, "{}", r.text);
+		});
+	}
+
+protected:
+	std::shared_ptr<spdlog::logger> _logger;
+	uint64_t _interval_ns;
+	std::chrono::milliseconds _flush;
+	spsc_ring<record, RING_SIZE> _ring;
+	std::atomic<bool> _stop;
+	std::thread _worker;
+	// sitios que han escrito (solo el hilo del frame)
+	log_site* _sites[MAX_SITES];
+	size_t _site_count;
+	frame_log* _previous;
+};
+
+} // end namespace dune
+
+#define DUNE_FRAME_LOG(level, ...) \
+	do { \
+		if (dune::frame_log* _log = dune::frame_log::current()) \
+		{ \
+			static dune::log_site _site; \
+			_log->write(_site, level, __VA_ARGS__); \
+		} \
+	} while (0)
+
+#if DUNE_FRAME_LOG_LEVEL <= 1
+#define FRAME_LOGD(...) DUNE_FRAME_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+#define FRAME_LOGD(...) do { } while (0)
+#endif
+
+#if DUNE_FRAME_LOG_LEVEL <= 2
+#define FRAME_LOGI(...) DUNE_FRAME_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+#define FRAME_LOGI(...) do { } while (0)
+#endif
+
+#if DUNE_FRAME_LOG_LEVEL <= 3
+#define FRAME_LOGW(...) DUNE_FRAME_LOG(spdlog::level::warn, __VA_ARGS__)
+#else
+#define FRAME_LOGW(...) do { } while (0)
+#endif
+
+#if DUNE_FRAME_LOG_LEVEL <= 4
+#define FRAME_LOGE(...) DUNE_FRAME_LOG(spdlog::level::err, __VA_ARGS__)
+#else
+#define FRAME_LOGE(...) do { } while (0)
+#endif
+
+#endif // FRAMELOG_H
@@ -0,0 +1,321 @@
+/**
+@file FrameScheduler.h
+
+Frame budgets on top of cu::parallel_scheduler. The scheduler only
+round-robins coroutines; frame_scheduler decides how long each one may
+keep running inside a frame:
+
+	- task_critical: the render loop. Calls begin_frame() once per frame
+	  and is never held back.
+	- task_per_frame: one step per frame (simulation), wait_next_frame()
+	  after each step.
+	- task_background: time sliced. yield() returns only when the task
+	  still has budget this frame and its deadline has not passed; the
+	  time of higher priority tasks that did not run yet is reserved.
+
+The background deadline (deadline_ms = 0) is the frame target minus
+what the critical task usually takes, so the next render starts in
+time to finish before the next vsync (present waits for the rest).
+
+	auto loader = fs.spawn(sch, background("loader", 2.0), [&](auto& yield, frame_scheduler::task_id id) {
+		while (pending())
+		{
+			load_one();
+			if (fs.should_yield(id))
+				fs.yield(id, yield);
+		}
+	});
+
+All tasks run in the scheduler thread; nothing here is synchronized.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+namespace dune {
+
+enum task_kind
+{
+	task_critical,
+	task_per_frame,
+	task_background
+};
+
+struct task_options
+{
+	std::string name;
+	task_kind kind = task_background;
+	// mayor primero
+	int priority = 0;
+	// tiempo por frame (background), 0 = sin limite
+	double budget_ms = 0.0;
+	// desde el inicio del frame, 0 = objetivo del frame - lo que tarda el critico
+	double deadline_ms = 0.0;
+};
+
+inline task_options critical(const std::string& name)
+{
+	task_options options;
+	options.name = name;
+	options.kind = task_critical;
+	options.priority = 100;
+	return options;
+}
+
+inline task_options per_frame(const std::string& name, int priority = 50)
+{
+	task_options options;
+	options.name = name;
+	options.kind = task_per_frame;
+	options.priority = priority;
+	return options;
+}
+
+inline task_options background(const std::string& name, double budget_ms, int priority = 0)
+{
+	task_options options;
+	options.name = name;
+	options.kind = task_background;
+	options.priority = priority;
+	options.budget_ms = budget_ms;
+	return options;
+}
+
+struct task_stats
+{
+	// tiempo de ejecucion en el ultimo frame completo
+	double last_ms = 0.0;
+	// media movil
+	double avg_ms = 0.0;
+	double max_ms = 0.0;
+	uint64_t slices = 0;
+	// slices que se pasaron del presupuesto
+	uint64_t overruns = 0;
+	// slices que terminaron despues del deadline
+	uint64_t deadline_misses = 0;
+	// frames en los que quiso correr y no le toco
+	uint64_t starved_frames = 0;
+};
+
+class frame_scheduler
+{
+public:
+	typedef size_t task_id;
+	typedef std::chrono::steady_clock clock;
+
+	// tolerance_ms: lo que una tarea puede pasarse antes de contar como overrun o deadline miss
+	explicit frame_scheduler(double frame_ms = 1000.0 / 60.0, double tolerance_ms = 0.25)
+		: _frame_ms(frame_ms)
+		, _tolerance_ms(tolerance_ms)
+		, _frame(0)
+		, _frame_start(clock::now())
+		, _critical_ms(0.0)
+		, _late_frames(0)
+		, _stopped(false)
+	{
+
+	}
+
+	frame_scheduler(const frame_scheduler&) = delete;
+	frame_scheduler& operator=(const frame_scheduler&) = delete;
+
+	task_id add(const task_options& options)
+	{
+		task t;
+		t.options = options;
+		_tasks.push_back(t);
+		return _tasks.size() - 1;
+	}
+
+	/*
+	Spawns func(yield, id) in the cu::parallel_scheduler sch and
+	measures it. The first critical task that finishes stops the
+	frames: waiting tasks are released so they can see their exit
+	condition.
+	*/
+	template <typename Scheduler, typename Func>
+	task_id spawn(Scheduler& sch, const task_options& options, Func func)
+	{
+		task_id id = add(options);
+		sch.spawn([this, id, func](auto& yield) mutable {
+			resume(id);
+			func(yield, id);
+			suspend(id);
+			_tasks[id].finished = true;
+			if (_tasks[id].options.kind == task_critical)
+				_stopped = true;
+		});
+		return id;
+	}
+
+	// desde la tarea critica, al empezar cada frame
+	void begin_frame()
+	{
+		clock::time_point now = clock::now();
+		if (_frame > 0 && elapsed_ms(_frame_start, now) > _frame_ms)
+			++_late_frames;
+
+		for (task& t : _tasks)
+		{
+			t.stats.last_ms = t.frame_ms;
+			t.stats.avg_ms += (t.frame_ms - t.stats.avg_ms) * 0.1;
+			t.stats.max_ms = std::max(t.stats.max_ms, t.frame_ms);
+			if (t.options.kind == task_critical)
+				_critical_ms = std::max(_critical_ms * 0.9, t.frame_ms);
+			if (t.waiting_budget && t.frame_ms == 0.0)
+				++t.stats.starved_frames;
+			t.frame_ms = 0.0;
+			t.waiting_budget = false;
+			t.parked = false;
+		}
+		++_frame;
+		_frame_start = now;
+	}
+
+	// true si la tarea deberia ceder ya
+	bool should_yield(task_id id) const
+	{
+		const task& t = _tasks[id];
+		if (_stopped || t.options.kind == task_critical)
+			return false;
+		if (t.options.kind == task_per_frame)
+			return true;
+
+		clock::time_point now = clock::now();
+		double used = t.frame_ms + (t.running ? elapsed_ms(t.resumed, now) : 0.0);
+		if (t.options.budget_ms > 0.0 && used >= t.options.budget_ms)
+			return true;
+		double left = deadline_ms(t) - elapsed_ms(_frame_start, now);
+		return left <= reserved_ms(t);
+	}
+
+	/*
+	Yields to the other coroutines. A background task comes back only
+	when it can run again in this frame or in a later one.
+	*/
+	template <typename Yield>
+	void yield(task_id id, Yield& yield)
+	{
+		suspend(id);
+		yield({});
+		task& t = _tasks[id];
+		while (!_stopped && t.options.kind == task_background && should_yield(id))
+		{
+			t.waiting_budget = true;
+			yield({});
+		}
+		resume(id);
+	}
+
+	// cede hasta que empiece el siguiente frame
+	template <typename Yield>
+	void wait_next_frame(task_id id, Yield& yield)
+	{
+		suspend(id);
+		_tasks[id].parked = true;
+		uint64_t frame = _frame;
+		do
+		{
+			yield({});
+		} while (!_stopped && _frame == frame);
+		resume(id);
+	}
+
+	const task_stats& stats(task_id id) const { return _tasks[id].stats; }
+	const std::string& name(task_id id) const { return _tasks[id].options.name; }
+	size_t size() const { return _tasks.size(); }
+	uint64_t frame() const { return _frame; }
+	// frames que duraron mas que el objetivo
+	uint64_t late_frames() const { return _late_frames; }
+	double frame_ms() const { return _frame_ms; }
+
+protected:
+	struct task
+	{
+		task_options options;
+		task_stats stats;
+		// tiempo usado en el frame actual
+		double frame_ms = 0.0;
+		clock::time_point resumed;
+		bool running = false;
+		bool finished = false;
+		bool waiting_budget = false;
+		// en wait_next_frame: no reserva tiempo este frame
+		bool parked = false;
+	};
+
+	void resume(task_id id)
+	{
+		task& t = _tasks[id];
+		t.resumed = clock::now();
+		t.running = true;
+	}
+
+	void suspend(task_id id)
+	{
+		task& t = _tasks[id];
+		if (!t.running)
+			return;
+		clock::time_point now = clock::now();
+		double slice = elapsed_ms(t.resumed, now);
+		t.frame_ms += slice;
+		t.running = false;
+		++t.stats.slices;
+		if (t.options.kind != task_background)
+			return;
+		if (t.options.budget_ms > 0.0 && t.frame_ms > t.options.budget_ms + _tolerance_ms)
+			++t.stats.overruns;
+		if (elapsed_ms(_frame_start, now) > deadline_ms(t) + _tolerance_ms)
+			++t.stats.deadline_misses;
+	}
+
+	double deadline_ms(const task& t) const
+	{
+		if (t.options.deadline_ms > 0.0)
+			return t.options.deadline_ms;
+		return _frame_ms - _critical_ms;
+	}
+
+	// presupuesto sin gastar de las tareas background con mas prioridad
+	double reserved_ms(const task& t) const
+	{
+		double reserved = 0.0;
+		for (const task& other : _tasks)
+		{
+			if (&other == &t || other.finished || other.parked || other.options.kind != task_background || other.options.priority <= t.options.priority)
+				continue;
+			if (other.options.budget_ms > other.frame_ms)
+				reserved += other.options.budget_ms - other.frame_ms;
+		}
+		return reserved;
+	}
+
+	static double elapsed_ms(clock::time_point from, clock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+protected:
+	std::vector<task> _tasks;
+	double _frame_ms;
+	double _tolerance_ms;
+	uint64_t _frame;
+	clock::time_point _frame_start;
+	// lo que suele tardar la tarea critica (pico con caida lenta)
+	double _critical_ms;
+	uint64_t _late_frames;
+	bool _stopped;
+};
+
+} // end namespace dune
+
+#endif // FRAMESCHEDULER_H
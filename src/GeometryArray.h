@@ -13,6 +13,9 @@ OpenGL VAO abstraction for GUI
 #include <memory>
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include "RenderStats.h"
+#include "FrameArena.h"
+#include "GpuResources.h"
 
 typedef enum {
 	AttribPosition,
@@ -78,12 +81,32 @@ public:
 		// unbind buffers
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// con gestor: contabilidad y borrado aplazado
+		_owner = gpu_resources::current();
+		if (_owner)
+		{
+			gpu_object object;
+			object.type = gpu_mesh;
+			object.names[0] = _vao;
+			object.names[1] = _vao_buffer;
+			object.bytes = sizeof(V) * vert_max;
+			_resource = _owner->adopt(object);
+		}
 	}
 
 	~StaticGeometryArray()
 	{
-		glDeleteBuffers(1, &_vao_buffer);
-		glDeleteVertexArrays(1, &_vao);
+		if (!_owner)
+		{
+			glDeleteBuffers(1, &_vao_buffer);
+			glDeleteVertexArrays(1, &_vao);
+		}
+		else if (gpu_resources::current() == _owner)
+		{
+			// si el gestor ya no existe, el lo ha borrado
+			_owner->release(_resource);
+		}
 	}
 
 	unsigned int getHandler() { return _vao; }
@@ -94,12 +117,25 @@ public:
 			bind();
 			glBindBuffer(GL_ARRAY_BUFFER, _vao_buffer);
 			glBufferSubData(GL_ARRAY_BUFFER, 0, vert_num * sizeof(V), &(vertices[0]));
+			frame_stats().upload(vert_num * sizeof(V));
+		}
+	}
+	// raw upload (arena, mapped files)
+	inline void upload_data(const V* vertices, unsigned int vert_num)
+	{
+		if (vert_num > 0)
+		{
+			bind();
+			glBindBuffer(GL_ARRAY_BUFFER, _vao_buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, vert_num * sizeof(V), vertices);
+			frame_stats().upload(vert_num * sizeof(V));
 		}
 	}
 	inline void render(GLsizei vert_num, GLenum mode = GL_TRIANGLES)
 	{
 		bind();
 		glDrawArrays(mode, 0, vert_num);
+		++frame_stats().draw_calls;
 	}
 protected:
 	inline void bind()
@@ -111,6 +147,8 @@ protected:
 	unsigned int _vao;
 	// buffer del gui
 	unsigned int _vao_buffer;
+	gpu_resources* _owner;
+	gpu_handle _resource;
 };
 
 template <typename V>
@@ -147,6 +185,42 @@ public:
 		_vert_num = (int)_vertexs.size();
 	}
 
+	/*
+	Bulk emission: space for up to max_vertices from arena (or from an
+	arena owned by the geometry). reserve_vertices() can be called from
+	several threads, each one fills its own span; end_batch() publishes
+	the count and flush() uploads it in one call. An external arena must
+	not be reset before the flush; clear_vertices() goes back to AddVert.
+	Returns false if the arena has no room for max_vertices.
+	*/
+	bool begin_batch(unsigned int max_vertices, frame_arena* arena = nullptr)
+	{
+		if (!arena)
+		{
+			_local_arena.reserve(sizeof(V) * max_vertices + 16);
+			_local_arena.reset();
+			arena = &_local_arena;
+		}
+		_batched = true;
+		if (!_batch.begin(*arena, max_vertices))
+		{
+			LOGE("Geometry %u: no room in the arena for a batch of %u vertices", _handler, max_vertices);
+			return false;
+		}
+		return true;
+	}
+
+	inline span<V> reserve_vertices(unsigned int count)
+	{
+		return _batch.reserve(count);
+	}
+
+	void end_batch()
+	{
+		_vert_num = (unsigned int)_batch.count();
+		_dirty = true;
+	}
+
 	void flush()
 	{
 		if (_vert_num > _vert_max)
@@ -161,7 +235,10 @@ public:
 			_dirty = false;
 
 			// cpu to gpu
-			_vao->upload_data(_vertexs, _vert_num);
+			if (_batched)
+				_vao->upload_data(_batch.data(), _vert_num);
+			else
+				_vao->upload_data(_vertexs, _vert_num);
 		}
 	}
 
@@ -177,6 +254,8 @@ public:
 	void clear_vertices()
 	{
 		_vertexs.clear();
+		_batch.clear();
+		_batched = false;
 	}
 
 public:
@@ -195,6 +274,10 @@ protected:
 	unsigned int _vert_max;
 	// geometry active
 	std::shared_ptr<StaticGeometryArray<V> > _vao;
+	// emision en bloque
+	bulk_range<V> _batch;
+	frame_arena _local_arena;
+	bool _batched = false;
 	// count compiled geometries
 	static int _counter_geometries;
 };
@@ -10,6 +10,7 @@ OpenGL VAO abstraction for GUI
 #ifndef GEOMETRYELEMENT_H
 #define GEOMETRYELEMENT_H
 
+#include <algorithm>
 #include "GeometryArray.h"
 
 namespace dune {
@@ -37,7 +38,8 @@ template <typename V>
 class StaticGeometryElement
 {
 public:
-	StaticGeometryElement(unsigned int vert_max, unsigned int indexes_max)
+	StaticGeometryElement(unsigned int vert_max, unsigned int indexes_max, GLenum index_type = GL_UNSIGNED_INT)
+		: _index_type(index_type)
 	{
 		// gen vao
 		glGenVertexArrays(1, &_vao);
@@ -54,7 +56,7 @@ public:
 
 		// crear un buffer de indices
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vao_buffer[1]);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexes_max, NULL, GL_DYNAMIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size() * indexes_max, NULL, GL_DYNAMIC_DRAW);
 		
 		// build opengl convention
 		V::build((GLsizei)(sizeof(V)));
@@ -63,12 +65,33 @@ public:
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		// con gestor: contabilidad y borrado aplazado
+		_owner = gpu_resources::current();
+		if (_owner)
+		{
+			gpu_object object;
+			object.type = gpu_mesh;
+			object.names[0] = _vao;
+			object.names[1] = _vao_buffer[0];
+			object.names[2] = _vao_buffer[1];
+			object.bytes = sizeof(V) * vert_max + index_size() * indexes_max;
+			_resource = _owner->adopt(object);
+		}
 	}
 
 	~StaticGeometryElement()
 	{
-		glDeleteBuffers(2, _vao_buffer);
-		glDeleteVertexArrays(1, &_vao);
+		if (!_owner)
+		{
+			glDeleteBuffers(2, _vao_buffer);
+			glDeleteVertexArrays(1, &_vao);
+		}
+		else if (gpu_resources::current() == _owner)
+		{
+			// si el gestor ya no existe, el lo ha borrado
+			_owner->release(_resource);
+		}
 	}
 
 	inline unsigned int getHandler() { return _vao; }
@@ -79,21 +102,101 @@ public:
 			bind();
 			glBindBuffer(GL_ARRAY_BUFFER, _vao_buffer[0]);
 			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(V) * vert_num, &(vertices[0]));
+			frame_stats().upload(sizeof(V) * vert_num);
 		}
 	}
 	inline void upload_indexes(const std::vector<GLuint>& indexes, unsigned int indexes_num)
 	{
-		if (indexes_num > 0)
+		if (indexes_num > 0 && _index_type == GL_UNSIGNED_SHORT)
+		{
+			// buffer de 16 bits: se estrecha antes de subir
+			std::vector<GLushort> narrow(indexes.begin(), indexes.begin() + indexes_num);
+			upload_indexes(narrow, indexes_num);
+		}
+		else if (indexes_num > 0)
 		{
 			bind();
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vao_buffer[1]);
 			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLuint) * indexes_num, &(indexes[0]));
+			frame_stats().upload(sizeof(GLuint) * indexes_num);
+		}
+	}
+	inline void upload_indexes(const std::vector<GLushort>& indexes, unsigned int indexes_num)
+	{
+		if (indexes_num > 0 && _index_type == GL_UNSIGNED_INT)
+		{
+			std::vector<GLuint> wide(indexes.begin(), indexes.begin() + indexes_num);
+			upload_indexes(wide, indexes_num);
+		}
+		else if (indexes_num > 0)
+		{
+			bind();
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vao_buffer[1]);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLushort) * indexes_num, &(indexes[0]));
+			frame_stats().upload(sizeof(GLushort) * indexes_num);
+		}
+	}
+	// raw upload (mapped files), indexes en el formato de index_type()
+	inline void upload_data(const V* vertices, unsigned int vert_num)
+	{
+		if (vert_num)
+		{
+			bind();
+			glBindBuffer(GL_ARRAY_BUFFER, _vao_buffer[0]);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(V) * vert_num, vertices);
+			frame_stats().upload(sizeof(V) * vert_num);
+		}
+	}
+	inline void upload_indexes(const void* indexes, unsigned int indexes_num)
+	{
+		if (indexes_num > 0)
+		{
+			bind();
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vao_buffer[1]);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_size() * indexes_num, indexes);
+			frame_stats().upload(index_size() * indexes_num);
+		}
+	}
+	// sub rangos: first en elementos
+	inline void upload_data_range(unsigned int first, const V* vertices, unsigned int vert_num)
+	{
+		if (vert_num)
+		{
+			bind();
+			glBindBuffer(GL_ARRAY_BUFFER, _vao_buffer[0]);
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(V) * first, sizeof(V) * vert_num, vertices);
+			frame_stats().upload(sizeof(V) * vert_num);
+		}
+	}
+	inline void upload_indexes_range(unsigned int first, const void* indexes, unsigned int indexes_num)
+	{
+		if (indexes_num > 0)
+		{
+			bind();
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vao_buffer[1]);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_size() * first, index_size() * indexes_num, indexes);
+			frame_stats().upload(index_size() * indexes_num);
 		}
 	}
 	inline void render(GLsizei indexes_num, GLenum mode = GL_TRIANGLES)
 	{
 		bind();
-		glDrawElements(mode, indexes_num, GL_UNSIGNED_INT, 0);
+		glDrawElements(mode, indexes_num, _index_type, 0);
+		++frame_stats().draw_calls;
+		frame_stats().indexes += indexes_num;
+	}
+	// un rango del buffer de indices (submeshes, niveles de detalle)
+	inline void render_range(unsigned int first_index, GLsizei indexes_num, GLenum mode = GL_TRIANGLES)
+	{
+		bind();
+		glDrawElements(mode, indexes_num, _index_type, BUFFER_OFFSET(index_size() * first_index));
+		++frame_stats().draw_calls;
+		frame_stats().indexes += indexes_num;
+	}
+	inline GLenum index_type() const { return _index_type; }
+	inline GLsizei index_size() const
+	{
+		return (_index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
 	}
 protected:
 	inline void bind()
@@ -105,6 +208,10 @@ protected:
 	unsigned int _vao;
 	// buffer del gui
 	unsigned int _vao_buffer[2];
+	// GL_UNSIGNED_SHORT o GL_UNSIGNED_INT
+	GLenum _index_type;
+	gpu_resources* _owner;
+	gpu_handle _resource;
 };
 
 template <typename V>
@@ -150,25 +257,116 @@ public:
 		_indexes_num = (int)_indexes.size();
 	}
 
+	/*
+	Bulk emission (see DynamicGeometryArray::begin_batch). Index values
+	are relative to the batch: use span.first of the vertex reservation.
+	Returns false if the arena has no room for both ranges.
+	*/
+	bool begin_batch(unsigned int max_vertices, unsigned int max_indexes, frame_arena* arena = nullptr)
+	{
+		if (!arena)
+		{
+			_local_arena.reserve(sizeof(V) * max_vertices + sizeof(GLuint) * max_indexes + 32);
+			_local_arena.reset();
+			arena = &_local_arena;
+		}
+		bool vertices_ok = _batch.begin(*arena, max_vertices);
+		bool indexes_ok = _batch_indexes.begin(*arena, max_indexes);
+		_batched = true;
+		if (!vertices_ok || !indexes_ok)
+		{
+			// las reservas devolveran spans vacios: el lote queda sin pintar
+			LOGE("Geometry %u: no room in the arena for a batch of %u vertices and %u indexes", _handler, max_vertices, max_indexes);
+			return false;
+		}
+		return true;
+	}
+
+	inline span<V> reserve_vertices(unsigned int count)
+	{
+		return _batch.reserve(count);
+	}
+
+	inline span<GLuint> reserve_indexes(unsigned int count)
+	{
+		return _batch_indexes.reserve(count);
+	}
+
+	void end_batch()
+	{
+		_vert_num = (unsigned int)_batch.count();
+		_indexes_num = (unsigned int)_batch_indexes.count();
+		_dirty = true;
+		_dirty_indexes = true;
+	}
+
+	/*
+	Retained mode: fixed size arrays written by sub ranges (UI widgets);
+	flush() only uploads the part that was written since the last one.
+	*/
+	void resize(unsigned int vertices, unsigned int indexes)
+	{
+		_vertexs.resize(vertices);
+		_indexes.resize(indexes);
+		if (vertices > _vert_num)
+			mark_vertices(_vert_num, vertices);
+		if (indexes > _indexes_num)
+			mark_indexes(_indexes_num, indexes);
+		_vert_num = vertices;
+		_indexes_num = indexes;
+	}
+
+	void write_vertices(unsigned int first, const V* vertices, unsigned int count)
+	{
+		std::copy(vertices, vertices + count, _vertexs.begin() + first);
+		mark_vertices(first, first + count);
+	}
+
+	void write_indexes(unsigned int first, const GLuint* indexes, unsigned int count)
+	{
+		std::copy(indexes, indexes + count, _indexes.begin() + first);
+		mark_indexes(first, first + count);
+	}
+
 	void flush()
 	{
-		if (_vert_num > _vert_max)
+		if (_vert_num > _vert_max || _indexes_num > _indexes_max)
 		{
-			_vert_max = _vert_num;
-			_vao = std::make_shared<StaticGeometryElement<V> >(_vert_max, _indexes_num);
+			_vert_max = std::max(_vert_max, _vert_num);
+			_indexes_max = std::max(_indexes_max, _indexes_num);
+			_vao = std::make_shared<StaticGeometryElement<V> >(_vert_max, _indexes_max);
+			// buffer nuevo: hay que subirlo entero
+			_dirty = _vert_num > 0;
+			_dirty_indexes = _indexes_num > 0;
 		}
 
 		if (_dirty)
 		{
 			_dirty = false;
-			_vao->upload_data(_vertexs, _vert_num);
+			if (_batched)
+				_vao->upload_data(_batch.data(), _vert_num);
+			else
+				_vao->upload_data(_vertexs, _vert_num);
+		}
+		else if (_vert_range[1] > _vert_range[0])
+		{
+			_vao->upload_data_range(_vert_range[0], &_vertexs[_vert_range[0]], _vert_range[1] - _vert_range[0]);
 		}
 
 		if (_dirty_indexes)
 		{
 			_dirty_indexes = false;
-			_vao->upload_indexes(_indexes, _indexes_num);
+			if (_batched)
+				_vao->upload_indexes(_batch_indexes.data(), _indexes_num);
+			else
+				_vao->upload_indexes(_indexes, _indexes_num);
+		}
+		else if (_index_range[1] > _index_range[0])
+		{
+			_vao->upload_indexes_range(_index_range[0], &_indexes[_index_range[0]], _index_range[1] - _index_range[0]);
 		}
+		_vert_range[0] = _vert_range[1] = 0;
+		_index_range[0] = _index_range[1] = 0;
 	}
 
 	virtual void render(GLenum mode = GL_TRIANGLES) override
@@ -184,6 +382,38 @@ public:
 	{
 		_vertexs.clear();
 		_indexes.clear();
+		_batch.clear();
+		_batch_indexes.clear();
+		_batched = false;
+	}
+
+protected:
+	void mark_vertices(unsigned int first, unsigned int last)
+	{
+		if (_vert_range[1] <= _vert_range[0])
+		{
+			_vert_range[0] = first;
+			_vert_range[1] = last;
+		}
+		else
+		{
+			_vert_range[0] = std::min(_vert_range[0], first);
+			_vert_range[1] = std::max(_vert_range[1], last);
+		}
+	}
+
+	void mark_indexes(unsigned int first, unsigned int last)
+	{
+		if (_index_range[1] <= _index_range[0])
+		{
+			_index_range[0] = first;
+			_index_range[1] = last;
+		}
+		else
+		{
+			_index_range[0] = std::min(_index_range[0], first);
+			_index_range[1] = std::max(_index_range[1], last);
+		}
 	}
 
 public:
@@ -203,8 +433,17 @@ protected:
 	unsigned int _indexes_num;
 	// reverva activa;
 	unsigned int _vert_max;
+	unsigned int _indexes_max = 0;
 	// geometry active
 	std::shared_ptr<StaticGeometryElement<V> > _vao;
+	// emision en bloque
+	bulk_range<V> _batch;
+	bulk_range<GLuint> _batch_indexes;
+	frame_arena _local_arena;
+	bool _batched = false;
+	// sub rangos escritos desde el ultimo flush [first, last)
+	unsigned int _vert_range[2] = {0, 0};
+	unsigned int _index_range[2] = {0, 0};
 	// count compiled geometries
 	static int _counter_geometries;
 };
@@ -0,0 +1,618 @@
+/**
+@file GlyphAtlas.h
+
+Glyphs rasterized on demand into signed distance field pages. Every
+glyph is rasterized once at a fixed size (sdf_size) and drawn at any
+size by the text shader, so the atlas key is only (font, codepoint).
+
+Pages are grids of equal cells; when all the pages are full the glyph
+least recently used (frame stamp) is evicted and its cell generation
+increased, so whoever kept the cell (shaped runs) can see it is stale.
+Glyphs used in the current frame are never evicted.
+
+Fonts implement glyph_rasterizer. Font 0 is always the built-in debug
+bitmap font (ASCII, 8x12); a FreeType rasterizer is available with
+DUNE_FREETYPE.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <GL/glew.h>
+#include "GpuResources.h"
+
+#ifdef DUNE_FREETYPE
+#include <string>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#endif
+
+namespace dune {
+
+// cobertura 0..255, fila 0 arriba
+struct glyph_bitmap
+{
+	int width = 0;
+	int height = 0;
+	// desde la posicion del lapiz: left a la derecha, top por encima de la linea base
+	int left = 0;
+	int top = 0;
+	float advance = 0.0f;
+	std::vector<unsigned char> coverage;
+};
+
+class glyph_rasterizer
+{
+public:
+	virtual ~glyph_rasterizer() { }
+
+	// false si la fuente no tiene el glifo
+	virtual bool rasterize(uint32_t codepoint, unsigned int pixel_size, glyph_bitmap& out) = 0;
+
+	virtual float ascender(unsigned int pixel_size) = 0;
+	virtual float line_height(unsigned int pixel_size) = 0;
+
+	virtual float kerning(uint32_t, uint32_t, unsigned int)
+	{
+		return 0.0f;
+	}
+};
+
+/*
+ASCII 32..126 in 8x12 cells, baseline under row 8. Bit x of a row is
+column x. Scaled with nearest sampling, the SDF smooths the steps.
+*/
+class debug_font : public glyph_rasterizer
+{
+public:
+	bool rasterize(uint32_t codepoint, unsigned int pixel_size, glyph_bitmap& out) override
+	{
+		if (codepoint < 32 || codepoint > 126)
+			return false;
+		const unsigned char* rows = glyphs()[codepoint - 32];
+		float scale = pixel_size / 12.0f;
+		out.width = std::max(1, (int)std::lround(8 * scale));
+		out.height = std::max(1, (int)std::lround(12 * scale));
+		out.left = 0;
+		out.top = (int)std::lround(9 * scale);
+		out.advance = 8 * scale;
+		out.coverage.resize((size_t)out.width * out.height);
+		for (int y = 0; y < out.height; ++y)
+		{
+			unsigned char row = rows[std::min(11, (int)(y / scale))];
+			for (int x = 0; x < out.width; ++x)
+				out.coverage[(size_t)y * out.width + x] = (row >> std::min(7, (int)(x / scale)) & 1) ? 255 : 0;
+		}
+		return true;
+	}
+
+	float ascender(unsigned int pixel_size) override
+	{
+		return pixel_size * (9.0f / 12.0f);
+	}
+
+	float line_height(unsigned int pixel_size) override
+	{
+		return (float)pixel_size;
+	}
+
+protected:
+	static const unsigned char (*glyphs())[12]
+	{
+		static const unsigned char data[95][12] = {
+			{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// espacio
+			{0x00, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00},	// !
+			{0x00, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// "
+			{0x00, 0x28, 0x24, 0x7E, 0x14, 0x14, 0x3F, 0x12, 0x0A, 0x00, 0x00, 0x00},	// #
+			{0x00, 0x08, 0x3C, 0x0A, 0x0A, 0x1C, 0x28, 0x28, 0x1E, 0x08, 0x08, 0x00},	// $
+			{0x00, 0x07, 0x05, 0x27, 0x18, 0x04, 0x3B, 0x28, 0x38, 0x00, 0x00, 0x00},	// %
+			{0x00, 0x1C, 0x04, 0x04, 0x0C, 0x5A, 0x52, 0x22, 0x7C, 0x00, 0x00, 0x00},	// &
+			{0x00, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// '
+			{0x08, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x08, 0x00, 0x00},	// (
+			{0x04, 0x04, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x04, 0x04, 0x00, 0x00},	// )
+			{0x00, 0x08, 0x2A, 0x1C, 0x1C, 0x2A, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00},	// *
+			{0x00, 0x00, 0x00, 0x08, 0x08, 0x3E, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00},	// +
+			{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x04, 0x00, 0x00},	// ,
+			{0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// -
+			{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 0x00, 0x00},	// .
+			{0x00, 0x20, 0x10, 0x10, 0x08, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00, 0x00},	// /
+			{0x00, 0x3C, 0x66, 0x42, 0x52, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00},	// 0
+			{0x00, 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x3E, 0x00, 0x00, 0x00},	// 1
+			{0x00, 0x3C, 0x42, 0x40, 0x60, 0x30, 0x18, 0x04, 0x7E, 0x00, 0x00, 0x00},	// 2
+			{0x00, 0x3C, 0x42, 0x40, 0x3C, 0x60, 0x40, 0x42, 0x3C, 0x00, 0x00, 0x00},	// 3
+			{0x00, 0x30, 0x30, 0x28, 0x24, 0x26, 0x7E, 0x20, 0x20, 0x00, 0x00, 0x00},	// 4
+			{0x00, 0x3E, 0x02, 0x02, 0x3E, 0x60, 0x40, 0x40, 0x3E, 0x00, 0x00, 0x00},	// 5
+			{0x00, 0x78, 0x04, 0x02, 0x3A, 0x46, 0x42, 0x42, 0x3C, 0x00, 0x00, 0x00},	// 6
+			{0x00, 0x7E, 0x20, 0x20, 0x10, 0x10, 0x08, 0x08, 0x04, 0x00, 0x00, 0x00},	// 7
+			{0x00, 0x3C, 0x42, 0x42, 0x3C, 0x42, 0x42, 0x42, 0x3C, 0x00, 0x00, 0x00},	// 8
+			{0x00, 0x3C, 0x42, 0x42, 0x42, 0x7C, 0x40, 0x20, 0x1E, 0x00, 0x00, 0x00},	// 9
+			{0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 0x00, 0x08, 0x08, 0x00, 0x00, 0x00},	// :
+			{0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 0x00, 0x08, 0x08, 0x04, 0x00, 0x00},	// ;
+			{0x00, 0x00, 0x00, 0x40, 0x38, 0x06, 0x1C, 0x60, 0x00, 0x00, 0x00, 0x00},	// <
+			{0x00, 0x00, 0x00, 0x00, 0x3F, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00},	// =
+			{0x00, 0x00, 0x00, 0x02, 0x1C, 0x60, 0x38, 0x06, 0x00, 0x00, 0x00, 0x00},	// >
+			{0x00, 0x1C, 0x20, 0x30, 0x18, 0x08, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00},	// ?
+			{0x00, 0x38, 0x64, 0x42, 0x72, 0x4A, 0x4A, 0x72, 0x06, 0x04, 0x38, 0x00},	// @
+			{0x00, 0x18, 0x18, 0x18, 0x24, 0x24, 0x3C, 0x42, 0x42, 0x00, 0x00, 0x00},	// A
+			{0x00, 0x3E, 0x42, 0x42, 0x3E, 0x42, 0x42, 0x42, 0x3E, 0x00, 0x00, 0x00},	// B
+			{0x00, 0x38, 0x44, 0x02, 0x02, 0x02, 0x02, 0x44, 0x38, 0x00, 0x00, 0x00},	// C
+			{0x00, 0x1E, 0x22, 0x42, 0x42, 0x42, 0x42, 0x22, 0x1E, 0x00, 0x00, 0x00},	// D
+			{0x00, 0x7E, 0x02, 0x02, 0x7E, 0x02, 0x02, 0x02, 0x7E, 0x00, 0x00, 0x00},	// E
+			{0x00, 0x7E, 0x02, 0x02, 0x7E, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00},	// F
+			{0x00, 0x38, 0x44, 0x02, 0x02, 0x62, 0x42, 0x44, 0x38, 0x00, 0x00, 0x00},	// G
+			{0x00, 0x42, 0x42, 0x42, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00},	// H
+			{0x00, 0x3E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x3E, 0x00, 0x00, 0x00},	// I
+			{0x00, 0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x22, 0x1C, 0x00, 0x00, 0x00},	// J
+			{0x00, 0x22, 0x12, 0x0A, 0x06, 0x0A, 0x12, 0x22, 0x42, 0x00, 0x00, 0x00},	// K
+			{0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x7E, 0x00, 0x00, 0x00},	// L
+			{0x00, 0x42, 0x66, 0x66, 0x5A, 0x5A, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00},	// M
+			{0x00, 0x42, 0x46, 0x4A, 0x4A, 0x52, 0x52, 0x62, 0x42, 0x00, 0x00, 0x00},	// N
+			{0x00, 0x3C, 0x66, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00},	// O
+			{0x00, 0x3E, 0x42, 0x42, 0x42, 0x3E, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00},	// P
+			{0x00, 0x3C, 0x66, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x60, 0x00, 0x00},	// Q
+			{0x00, 0x3E, 0x42, 0x42, 0x42, 0x3E, 0x22, 0x42, 0x82, 0x00, 0x00, 0x00},	// R
+			{0x00, 0x3C, 0x42, 0x02, 0x1E, 0x60, 0x40, 0x42, 0x3C, 0x00, 0x00, 0x00},	// S
+			{0x00, 0x7F, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00},	// T
+			{0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3C, 0x00, 0x00, 0x00},	// U
+			{0x00, 0x42, 0x42, 0x24, 0x24, 0x24, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00},	// V
+			{0x00, 0x41, 0x49, 0x49, 0x55, 0x36, 0x36, 0x22, 0x22, 0x00, 0x00, 0x00},	// W
+			{0x00, 0x42, 0x24, 0x24, 0x18, 0x18, 0x24, 0x24, 0x42, 0x00, 0x00, 0x00},	// X
+			{0x00, 0x63, 0x22, 0x14, 0x1C, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00},	// Y
+			{0x00, 0x7E, 0x20, 0x20, 0x10, 0x08, 0x0C, 0x04, 0x7E, 0x00, 0x00, 0x00},	// Z
+			{0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0C, 0x00, 0x00},	// [
+			{0x00, 0x02, 0x04, 0x04, 0x08, 0x08, 0x08, 0x10, 0x10, 0x20, 0x00, 0x00},	// backslash
+			{0x0C, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0C, 0x00, 0x00},	// ]
+			{0x00, 0x0C, 0x12, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// ^
+			{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7F},	// _
+			{0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// `
+			{0x00, 0x00, 0x00, 0x1E, 0x20, 0x3C, 0x22, 0x22, 0x3C, 0x00, 0x00, 0x00},	// a
+			{0x02, 0x02, 0x02, 0x1E, 0x22, 0x22, 0x22, 0x22, 0x1E, 0x00, 0x00, 0x00},	// b
+			{0x00, 0x00, 0x00, 0x3C, 0x06, 0x02, 0x02, 0x06, 0x3C, 0x00, 0x00, 0x00},	// c
+			{0x20, 0x20, 0x20, 0x3C, 0x22, 0x22, 0x22, 0x22, 0x3C, 0x00, 0x00, 0x00},	// d
+			{0x00, 0x00, 0x00, 0x1C, 0x22, 0x3E, 0x02, 0x02, 0x3C, 0x00, 0x00, 0x00},	// e
+			{0x30, 0x08, 0x08, 0x3E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00},	// f
+			{0x00, 0x00, 0x00, 0x3C, 0x22, 0x22, 0x22, 0x22, 0x3C, 0x20, 0x1C, 0x00},	// g
+			{0x02, 0x02, 0x02, 0x1A, 0x26, 0x22, 0x22, 0x22, 0x22, 0x00, 0x00, 0x00},	// h
+			{0x08, 0x00, 0x00, 0x0E, 0x08, 0x08, 0x08, 0x08, 0x3E, 0x00, 0x00, 0x00},	// i
+			{0x08, 0x00, 0x00, 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x06, 0x00},	// j
+			{0x02, 0x02, 0x02, 0x12, 0x0A, 0x06, 0x0A, 0x12, 0x22, 0x00, 0x00, 0x00},	// k
+			{0x07, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x18, 0x00, 0x00, 0x00},	// l
+			{0x00, 0x00, 0x00, 0x3E, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x00, 0x00, 0x00},	// m
+			{0x00, 0x00, 0x00, 0x1A, 0x26, 0x22, 0x22, 0x22, 0x22, 0x00, 0x00, 0x00},	// n
+			{0x00, 0x00, 0x00, 0x1C, 0x22, 0x22, 0x22, 0x22, 0x1C, 0x00, 0x00, 0x00},	// o
+			{0x00, 0x00, 0x00, 0x1E, 0x22, 0x22, 0x22, 0x22, 0x1E, 0x02, 0x02, 0x00},	// p
+			{0x00, 0x00, 0x00, 0x3C, 0x22, 0x22, 0x22, 0x22, 0x3C, 0x20, 0x20, 0x00},	// q
+			{0x00, 0x00, 0x00, 0x3C, 0x24, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00},	// r
+			{0x00, 0x00, 0x00, 0x3C, 0x02, 0x0E, 0x30, 0x20, 0x1E, 0x00, 0x00, 0x00},	// s
+			{0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x04, 0x04, 0x1C, 0x00, 0x00, 0x00},	// t
+			{0x00, 0x00, 0x00, 0x22, 0x22, 0x22, 0x22, 0x22, 0x3C, 0x00, 0x00, 0x00},	// u
+			{0x00, 0x00, 0x00, 0x22, 0x22, 0x14, 0x14, 0x14, 0x08, 0x00, 0x00, 0x00},	// v
+			{0x00, 0x00, 0x00, 0x41, 0x41, 0x2A, 0x2A, 0x14, 0x14, 0x00, 0x00, 0x00},	// w
+			{0x00, 0x00, 0x00, 0x36, 0x14, 0x08, 0x08, 0x14, 0x36, 0x00, 0x00, 0x00},	// x
+			{0x00, 0x00, 0x00, 0x22, 0x12, 0x14, 0x14, 0x0C, 0x08, 0x04, 0x06, 0x00},	// y
+			{0x00, 0x00, 0x00, 0x3E, 0x10, 0x18, 0x0C, 0x04, 0x3E, 0x00, 0x00, 0x00},	// z
+			{0x38, 0x08, 0x08, 0x08, 0x06, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00, 0x00},	// {
+			{0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00},	// |
+			{0x0E, 0x08, 0x08, 0x08, 0x30, 0x08, 0x08, 0x08, 0x08, 0x0E, 0x00, 0x00},	// }
+			{0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00},	// ~
+		};
+		return data;
+	}
+};
+
+#ifdef DUNE_FREETYPE
+class freetype_font : public glyph_rasterizer
+{
+public:
+	explicit freetype_font(const std::string& filename)
+		: _library(nullptr)
+		, _face(nullptr)
+		, _size(0)
+	{
+		if (FT_Init_FreeType(&_library) != 0)
+		{
+			LOGE("Can't init FreeType");
+			_library = nullptr;
+			return;
+		}
+		if (FT_New_Face(_library, filename.c_str(), 0, &_face) != 0)
+		{
+			LOGE("Can't load font %s", filename.c_str());
+			_face = nullptr;
+		}
+	}
+
+	~freetype_font()
+	{
+		if (_face)
+			FT_Done_Face(_face);
+		if (_library)
+			FT_Done_FreeType(_library);
+	}
+
+	bool is_valid() const { return _face != nullptr; }
+
+	bool rasterize(uint32_t codepoint, unsigned int pixel_size, glyph_bitmap& out) override
+	{
+		if (!set_size(pixel_size))
+			return false;
+		FT_UInt index = FT_Get_Char_Index(_face, codepoint);
+		if (index == 0 || FT_Load_Glyph(_face, index, FT_LOAD_RENDER) != 0)
+			return false;
+		FT_GlyphSlot slot = _face->glyph;
+		out.width = (int)slot->bitmap.width;
+		out.height = (int)slot->bitmap.rows;
+		out.left = slot->bitmap_left;
+		out.top = slot->bitmap_top;
+		out.advance = slot->advance.x / 64.0f;
+		out.coverage.resize((size_t)out.width * out.height);
+		for (int y = 0; y < out.height; ++y)
+			std::copy(slot->bitmap.buffer + y * slot->bitmap.pitch, slot->bitmap.buffer + y * slot->bitmap.pitch + out.width,
+					  out.coverage.begin() + (size_t)y * out.width);
+		return true;
+	}
+
+	float ascender(unsigned int pixel_size) override
+	{
+		return set_size(pixel_size) ? _face->size->metrics.ascender / 64.0f : 0.0f;
+	}
+
+	float line_height(unsigned int pixel_size) override
+	{
+		return set_size(pixel_size) ? _face->size->metrics.height / 64.0f : (float)pixel_size;
+	}
+
+	float kerning(uint32_t left, uint32_t right, unsigned int pixel_size) override
+	{
+		if (!FT_HAS_KERNING(_face) || !set_size(pixel_size))
+			return 0.0f;
+		FT_Vector delta;
+		if (FT_Get_Kerning(_face, FT_Get_Char_Index(_face, left), FT_Get_Char_Index(_face, right), FT_KERNING_DEFAULT, &delta) != 0)
+			return 0.0f;
+		return delta.x / 64.0f;
+	}
+
+protected:
+	bool set_size(unsigned int pixel_size)
+	{
+		if (!_face)
+			return false;
+		if (pixel_size != _size)
+		{
+			if (FT_Set_Pixel_Sizes(_face, 0, pixel_size) != 0)
+				return false;
+			_size = pixel_size;
+		}
+		return true;
+	}
+
+protected:
+	FT_Library _library;
+	FT_Face _face;
+	unsigned int _size;
+};
+#endif
+
+struct atlas_options
+{
+	unsigned int page_size = 1024;
+	// tamaño al que se rasteriza cada glifo
+	unsigned int sdf_size = 32;
+	// pixeles de distancia codificados a cada lado del borde
+	unsigned int spread = 4;
+	unsigned int max_pages = 4;
+};
+
+struct atlas_glyph
+{
+	uint64_t key = 0;
+	uint32_t generation = 0;
+	uint64_t last_used = 0;
+	bool used = false;
+	// rectangulo en la pagina
+	float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+	// quad en ems desde el lapiz, y hacia abajo (sin quad: espacios)
+	float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;
+	float advance = 0.0f;
+	bool empty = true;
+};
+
+class glyph_atlas
+{
+public:
+	static const uint32_t no_glyph = 0xFFFFFFFFu;
+
+	explicit glyph_atlas(const atlas_options& options = atlas_options())
+		: _options(options)
+		, _frame(1)
+		, _misses(0)
+		, _evictions(0)
+		, _dropped(0)
+		, _owner(gpu_resources::current())
+	{
+		_cell_size = options.sdf_size + options.sdf_size / 4 + 2 * options.spread;
+		_columns = std::max(1u, options.page_size / _cell_size);
+		_fonts.emplace_back(std::make_unique<debug_font>());
+	}
+
+	~glyph_atlas()
+	{
+		if (!_owner)
+		{
+			if (!_textures.empty())
+				glDeleteTextures((GLsizei)_textures.size(), _textures.data());
+		}
+		else if (gpu_resources::current() == _owner)
+		{
+			for (gpu_handle handle : _resources)
+				_owner->release(handle);
+		}
+	}
+
+	glyph_atlas(const glyph_atlas&) = delete;
+	glyph_atlas& operator=(const glyph_atlas&) = delete;
+
+	// devuelve el id de la fuente
+	unsigned int add_font(std::unique_ptr<glyph_rasterizer> font)
+	{
+		_fonts.emplace_back(std::move(font));
+		return (unsigned int)_fonts.size() - 1;
+	}
+
+	glyph_rasterizer& font(unsigned int id) { return *_fonts[id < _fonts.size() ? id : 0]; }
+
+	// los glifos usados en este frame no se pueden expulsar
+	void begin_frame() { ++_frame; }
+
+	/*
+	Cell of the glyph, rasterized if needed, marked as used this frame.
+	no_glyph if the font doesn't have it or every cell is in use by
+	this frame.
+	*/
+	uint32_t find(unsigned int font, uint32_t codepoint)
+	{
+		uint64_t key = ((uint64_t)font << 32) | codepoint;
+		auto it = _lookup.find(key);
+		if (it != _lookup.end())
+		{
+			_cells[it->second].last_used = _frame;
+			return it->second;
+		}
+
+		++_misses;
+		if (!this->font(font).rasterize(codepoint, _options.sdf_size, _bitmap))
+			return no_glyph;
+		uint32_t cell = take_cell();
+		if (cell == no_glyph)
+		{
+			++_dropped;
+			return no_glyph;
+		}
+		store(cell, key, _bitmap);
+		_lookup[key] = cell;
+		return cell;
+	}
+
+	inline void touch(uint32_t cell) { _cells[cell].last_used = _frame; }
+	inline const atlas_glyph& glyph(uint32_t cell) const { return _cells[cell]; }
+	inline unsigned int page_of(uint32_t cell) const { return cell / cells_per_page(); }
+
+	inline unsigned int cells_per_page() const { return _columns * _columns; }
+	inline size_t pages() const { return _textures.size(); }
+	inline GLuint texture(unsigned int page) const { return _textures[page]; }
+	inline const atlas_options& options() const { return _options; }
+	inline uint64_t frame() const { return _frame; }
+
+	// estadisticas
+	inline size_t misses() const { return _misses; }
+	inline size_t evictions() const { return _evictions; }
+	inline size_t dropped() const { return _dropped; }
+
+	/*
+	Signed distance field of a coverage bitmap: w x h bytes, 128 on the
+	edge, +127 / -128 at spread pixels inside / outside.
+	*/
+	static void build_sdf(const glyph_bitmap& bitmap, int offset, int w, int h, int spread, unsigned char* out)
+	{
+		const float far = 1e20f;
+		size_t n = (size_t)w * h;
+		std::vector<float> to_inside(n, far), to_outside(n, 0.0f);
+		for (int y = 0; y < bitmap.height; ++y)
+		{
+			for (int x = 0; x < bitmap.width; ++x)
+			{
+				int gx = x + offset, gy = y + offset;
+				if (gx >= w || gy >= h || bitmap.coverage[(size_t)y * bitmap.width + x] < 128)
+					continue;
+				to_inside[(size_t)gy * w + gx] = 0.0f;
+				to_outside[(size_t)gy * w + gx] = far;
+			}
+		}
+		distance_2d(to_inside, w, h);
+		distance_2d(to_outside, w, h);
+		float scale = 127.0f / spread;
+		for (size_t i = 0; i < n; ++i)
+		{
+			// distancia al borde (entre pixeles), positiva dentro
+			float d = (to_outside[i] > 0.0f) ? std::sqrt(to_outside[i]) - 0.5f : 0.5f - std::sqrt(to_inside[i]);
+			out[i] = (unsigned char)std::min(255.0f, std::max(0.0f, 128.0f + d * scale));
+		}
+	}
+
+protected:
+	uint32_t take_cell()
+	{
+		if (_cells.size() < _textures.size() * cells_per_page())
+		{
+			_cells.emplace_back();
+			return (uint32_t)_cells.size() - 1;
+		}
+		if (_textures.size() < _options.max_pages)
+		{
+			add_page();
+			_cells.emplace_back();
+			return (uint32_t)_cells.size() - 1;
+		}
+
+		// lleno: el usado hace mas tiempo, nunca uno de este frame
+		uint32_t oldest = no_glyph;
+		for (uint32_t i = 0; i < (uint32_t)_cells.size(); ++i)
+		{
+			if (_cells[i].last_used < _frame && (oldest == no_glyph || _cells[i].last_used < _cells[oldest].last_used))
+				oldest = i;
+		}
+		if (oldest != no_glyph)
+		{
+			_lookup.erase(_cells[oldest].key);
+			++_evictions;
+		}
+		return oldest;
+	}
+
+	void add_page()
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// fuera de los glifos: lejos del borde
+		std::vector<unsigned char> empty((size_t)_options.page_size * _options.page_size, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, _options.page_size, _options.page_size, 0, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+		_textures.push_back(texture);
+		if (_owner)
+		{
+			gpu_object object;
+			object.type = gpu_texture;
+			object.names[0] = texture;
+			object.bytes = empty.size();
+			_resources.push_back(_owner->adopt(object));
+		}
+	}
+
+	void store(uint32_t cell, uint64_t key, const glyph_bitmap& bitmap)
+	{
+		atlas_glyph& g = _cells[cell];
+		g.key = key;
+		++g.generation;
+		g.last_used = _frame;
+		g.used = true;
+		float em = (float)_options.sdf_size;
+		g.advance = bitmap.advance / em;
+		g.empty = std::none_of(bitmap.coverage.begin(), bitmap.coverage.end(), [](unsigned char c) { return c >= 128; });
+		if (g.empty)
+			return;
+
+		int spread = (int)_options.spread;
+		int w = std::min(bitmap.width + 2 * spread, (int)_cell_size);
+		int h = std::min(bitmap.height + 2 * spread, (int)_cell_size);
+		_sdf.resize((size_t)w * h);
+		build_sdf(bitmap, spread, w, h, spread, _sdf.data());
+
+		unsigned int index = cell % cells_per_page();
+		int x = (int)((index % _columns) * _cell_size);
+		int y = (int)((index / _columns) * _cell_size);
+		glBindTexture(GL_TEXTURE_2D, _textures[page_of(cell)]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, _sdf.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		float page = (float)_options.page_size;
+		g.u0 = x / page;
+		g.v0 = y / page;
+		g.u1 = (x + w) / page;
+		g.v1 = (y + h) / page;
+		g.x0 = (bitmap.left - spread) / em;
+		g.y0 = (-bitmap.top - spread) / em;
+		g.x1 = g.x0 + w / em;
+		g.y1 = g.y0 + h / em;
+	}
+
+	// distancia euclidea al cuadrado (Felzenszwalb): 0 en las semillas
+	static void distance_2d(std::vector<float>& grid, int w, int h)
+	{
+		int n = std::max(w, h);
+		std::vector<float> f(n), d(n), z(n + 1);
+		std::vector<int> v(n);
+		for (int x = 0; x < w; ++x)
+		{
+			for (int y = 0; y < h; ++y)
+				f[y] = grid[(size_t)y * w + x];
+			distance_1d(f.data(), h, d.data(), v.data(), z.data());
+			for (int y = 0; y < h; ++y)
+				grid[(size_t)y * w + x] = d[y];
+		}
+		for (int y = 0; y < h; ++y)
+		{
+			std::copy(grid.begin() + (size_t)y * w, grid.begin() + (size_t)(y + 1) * w, f.begin());
+			distance_1d(f.data(), w, d.data(), v.data(), z.data());
+			std::copy(d.begin(), d.begin() + w, grid.begin() + (size_t)y * w);
+		}
+	}
+
+	static void distance_1d(const float* f, int n, float* d, int* v, float* z)
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		int k = 0;
+		v[0] = 0;
+		z[0] = -inf;
+		z[1] = inf;
+		for (int q = 1; q < n; ++q)
+		{
+			// corte de la parabola q con la ultima de la envolvente
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+			while (s <= z[k])
+			{
+				--k;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+			}
+			++k;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = inf;
+		}
+		k = 0;
+		for (int q = 0; q < n; ++q)
+		{
+			while (z[k + 1] < q)
+				++k;
+			d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+
+protected:
+	atlas_options _options;
+	unsigned int _cell_size;
+	unsigned int _columns;
+	std::vector<std::unique_ptr<glyph_rasterizer> > _fonts;
+	std::vector<GLuint> _textures;
+	std::vector<atlas_glyph> _cells;
+	std::unordered_map<uint64_t, uint32_t> _lookup;
+	uint64_t _frame;
+	size_t _misses;
+	size_t _evictions;
+	size_t _dropped;
+	// buffers reutilizados entre glifos
+	glyph_bitmap _bitmap;
+	std::vector<unsigned char> _sdf;
+	gpu_resources* _owner;
+	std::vector<gpu_handle> _resources;
+};
+
+} // end namespace dune
+
+#endif // GLYPHATLAS_H
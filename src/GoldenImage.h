@@ -0,0 +1,278 @@
+/**
+@file GoldenImage.h
+
+Golden image comparison for rendering regressions. The metric is
+tolerant to small differences between GL implementations:
+	- mean SSIM of the luma in 8x8 windows
+	- ratio of pixels with a perceptual color difference over a threshold
+
+A scene script (.scene) says how long to run and which frames to check:
+
+	# comentario
+	frames 120
+	budget_ms 8
+	replay input.rec
+	golden 1 bounce_0001.png
+	golden 60 bounce_0060.png
+
+Paths are relative to the script. Frames are counted from 1.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef GOLDENIMAGE_H
+#define GOLDENIMAGE_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <FreeImage.h>
+
+namespace dune {
+
+// RGBA8, fila 0 arriba
+struct image
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> rgba;
+};
+
+struct image_diff
+{
+	// 1.0 identicas
+	double ssim = 0.0;
+	// pixeles con diferencia de color > threshold / total
+	double bad_pixel_ratio = 1.0;
+	double max_delta = 0.0;
+	bool size_mismatch = false;
+
+	bool passed(double min_ssim = 0.98, double max_bad_ratio = 0.001) const
+	{
+		return !size_mismatch && ssim >= min_ssim && bad_pixel_ratio <= max_bad_ratio;
+	}
+};
+
+// lectura sincrona (para tests, no para el frame loop: ver frame_capture)
+inline void read_framebuffer(GLuint fbo, int width, int height, image& out)
+{
+	out.width = width;
+	out.height = height;
+	out.rgba.resize((size_t)width * height * 4);
+	std::vector<unsigned char> bottom_up(out.rgba.size());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glReadBuffer(fbo ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, bottom_up.data());
+	const size_t row = (size_t)width * 4;
+	for (int y = 0; y < height; ++y)
+		std::copy(&bottom_up[(height - 1 - y) * row], &bottom_up[(height - y) * row], &out.rgba[y * row]);
+}
+
+inline bool load_png(const std::string& filename, image& out)
+{
+	FIBITMAP* bitmap = FreeImage_Load(FIF_PNG, filename.c_str(), 0);
+	if (!bitmap)
+		return false;
+	FIBITMAP* converted = FreeImage_ConvertTo32Bits(bitmap);
+	FreeImage_Unload(bitmap);
+	if (!converted)
+		return false;
+
+	out.width = (int)FreeImage_GetWidth(converted);
+	out.height = (int)FreeImage_GetHeight(converted);
+	out.rgba.resize((size_t)out.width * out.height * 4);
+	unsigned int pitch = FreeImage_GetPitch(converted);
+	BYTE* bits = FreeImage_GetBits(converted);
+	for (int y = 0; y < out.height; ++y)
+	{
+		// FreeImage: abajo a arriba, BGRA
+		const BYTE* src = bits + (size_t)(out.height - 1 - y) * pitch;
+		unsigned char* dst = &out.rgba[(size_t)y * out.width * 4];
+		for (int x = 0; x < out.width; ++x)
+		{
+			dst[x * 4 + 0] = src[x * 4 + 2];
+			dst[x * 4 + 1] = src[x * 4 + 1];
+			dst[x * 4 + 2] = src[x * 4 + 0];
+			dst[x * 4 + 3] = src[x * 4 + 3];
+		}
+	}
+	FreeImage_Unload(converted);
+	return true;
+}
+
+inline bool save_png(const std::string& filename, const image& img)
+{
+	std::vector<unsigned char> bgra(img.rgba.size());
+	for (size_t i = 0; i < img.rgba.size(); i += 4)
+	{
+		bgra[i + 0] = img.rgba[i + 2];
+		bgra[i + 1] = img.rgba[i + 1];
+		bgra[i + 2] = img.rgba[i + 0];
+		bgra[i + 3] = img.rgba[i + 3];
+	}
+	FIBITMAP* bitmap = FreeImage_ConvertFromRawBits(bgra.data(), img.width, img.height, img.width * 4, 32,
+													FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
+	if (!bitmap)
+		return false;
+	bool ok = FreeImage_Save(FIF_PNG, bitmap, filename.c_str(), 0) != 0;
+	FreeImage_Unload(bitmap);
+	return ok;
+}
+
+inline double luma(const unsigned char* p)
+{
+	return 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+}
+
+/*
+Color difference in YCbCr weighted towards luma (cheap approximation of
+a perceptual distance), range [0, ~255].
+*/
+inline double color_delta(const unsigned char* a, const unsigned char* b)
+{
+	double dy = luma(a) - luma(b);
+	double dcb = (-0.168736 * a[0] - 0.331264 * a[1] + 0.5 * a[2]) - (-0.168736 * b[0] - 0.331264 * b[1] + 0.5 * b[2]);
+	double dcr = (0.5 * a[0] - 0.418688 * a[1] - 0.081312 * a[2]) - (0.5 * b[0] - 0.418688 * b[1] - 0.081312 * b[2]);
+	return std::sqrt(dy * dy + 0.5 * dcb * dcb + 0.5 * dcr * dcr);
+}
+
+inline image_diff compare(const image& a, const image& b, double delta_threshold = 8.0)
+{
+	image_diff diff;
+	if (a.width != b.width || a.height != b.height)
+	{
+		diff.size_mismatch = true;
+		return diff;
+	}
+
+	size_t bad = 0;
+	const size_t pixels = (size_t)a.width * a.height;
+	for (size_t i = 0; i < pixels; ++i)
+	{
+		double delta = color_delta(&a.rgba[i * 4], &b.rgba[i * 4]);
+		diff.max_delta = std::max(diff.max_delta, delta);
+		if (delta > delta_threshold)
+			++bad;
+	}
+	diff.bad_pixel_ratio = pixels ? (double)bad / pixels : 0.0;
+
+	// SSIM por ventanas 8x8 sin solape
+	const double c1 = (0.01 * 255) * (0.01 * 255);
+	const double c2 = (0.03 * 255) * (0.03 * 255);
+	const int window = 8;
+	double total = 0.0;
+	int windows = 0;
+	for (int wy = 0; wy + window <= a.height; wy += window)
+	{
+		for (int wx = 0; wx + window <= a.width; wx += window)
+		{
+			double sum_a = 0, sum_b = 0, sum_aa = 0, sum_bb = 0, sum_ab = 0;
+			for (int y = wy; y < wy + window; ++y)
+			{
+				for (int x = wx; x < wx + window; ++x)
+				{
+					size_t index = ((size_t)y * a.width + x) * 4;
+					double la = luma(&a.rgba[index]);
+					double lb = luma(&b.rgba[index]);
+					sum_a += la; sum_b += lb;
+					sum_aa += la * la; sum_bb += lb * lb; sum_ab += la * lb;
+				}
+			}
+			const double n = window * window;
+			double mean_a = sum_a / n, mean_b = sum_b / n;
+			double var_a = sum_aa / n - mean_a * mean_a;
+			double var_b = sum_bb / n - mean_b * mean_b;
+			double cov = sum_ab / n - mean_a * mean_b;
+			total += ((2 * mean_a * mean_b + c1) * (2 * cov + c2)) /
+					 ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+			++windows;
+		}
+	}
+	diff.ssim = windows ? total / windows : 1.0;
+	return diff;
+}
+
+struct golden_check
+{
+	long frame;
+	std::string file;
+};
+
+struct golden_scene
+{
+	std::string name;
+	long frames = 0;
+	// ms por frame, 0 = sin limite
+	double budget_ms = 0.0;
+	std::string replay;
+	std::vector<golden_check> checks;
+};
+
+inline bool load_scene(const std::string& filename, golden_scene& scene)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		LOGE("Can't open scene %s", filename.c_str());
+		return false;
+	}
+	size_t slash = filename.find_last_of("/\\");
+	std::string dir = (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
+	std::string base = filename.substr(dir.size());
+	scene = golden_scene();
+	scene.name = base.substr(0, base.rfind('.'));
+
+	std::string line;
+	int number = 0;
+	while (std::getline(file, line))
+	{
+		++number;
+		std::istringstream in(line);
+		std::string tag;
+		if (!(in >> tag) || tag[0] == '#')
+			continue;
+		bool ok = true;
+		if (tag == "frames")
+			ok = (bool)(in >> scene.frames) && scene.frames > 0;
+		else if (tag == "budget_ms")
+			ok = (bool)(in >> scene.budget_ms);
+		else if (tag == "replay")
+		{
+			ok = (bool)(in >> scene.replay);
+			scene.replay = dir + scene.replay;
+		}
+		else if (tag == "golden")
+		{
+			golden_check check;
+			ok = (bool)(in >> check.frame >> check.file) && check.frame > 0;
+			check.file = dir + check.file;
+			scene.checks.push_back(check);
+		}
+		else
+			ok = false;
+		if (!ok)
+		{
+			LOGE("Scene %s:%d: invalid line '%s'", filename.c_str(), number, line.c_str());
+			return false;
+		}
+	}
+	for (const golden_check& check : scene.checks)
+		scene.frames = std::max(scene.frames, check.frame);
+	if (scene.checks.empty())
+	{
+		LOGE("Scene %s: no golden frames", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+} // end namespace dune
+
+#endif // GOLDENIMAGE_H
@@ -0,0 +1,543 @@
+/**
+@file GpuResources.h
+
+Owner of the GL objects (buffers, VAOs, textures, programs, meshes):
+
+	- generational handles: a released handle never aliases a new one
+	- reference counting (retain / release, or gpu_ref)
+	- deferred destruction: an object released in frame F is deleted
+	  when F + destroy_delay frames have passed and the fence of frame F
+	  is signaled, so the GPU never sees a name disappear mid frame
+	- per type memory accounting
+	- LRU eviction of textures and meshes created with a loader when the
+	  resident bytes exceed the VRAM budget; use() loads them again
+
+StaticGeometryArray / StaticGeometryElement and the glyph atlas pages
+register themselves in gpu_resources::current() when there is one.
+Only the GL thread may touch it.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef GPURESOURCES_H
+#define GPURESOURCES_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <GL/glew.h>
+
+namespace dune {
+
+enum gpu_type
+{
+	gpu_buffer,
+	gpu_vertex_array,
+	gpu_texture,
+	gpu_program,
+	// vao + vertex buffer + index buffer
+	gpu_mesh,
+	gpu_type_count
+};
+
+struct gpu_handle
+{
+	uint32_t index = 0xFFFFFFFFu;
+	uint32_t generation = 0;
+
+	bool valid() const { return index != 0xFFFFFFFFu; }
+	bool operator==(const gpu_handle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const gpu_handle& other) const { return !(*this == other); }
+};
+
+struct gpu_object
+{
+	gpu_type type = gpu_buffer;
+	GLuint names[3] = {0, 0, 0};
+	size_t bytes = 0;
+};
+
+// crea (o vuelve a crear tras una expulsion) el objeto; false si falla
+typedef std::function<bool(gpu_object&)> gpu_loader;
+
+struct gpu_options
+{
+	size_t budget_bytes = (size_t)512 << 20;
+	// frames entre release y el borrado real
+	unsigned int destroy_delay = 3;
+};
+
+class gpu_resources
+{
+public:
+	explicit gpu_resources(const gpu_options& options = gpu_options())
+		: _options(options)
+		, _frame(0)
+		, _completed(0)
+		, _pending_bytes(0)
+		, _lru_head(nil)
+		, _lru_tail(nil)
+		, _evictions(0)
+		, _reloads(0)
+	{
+		for (int i = 0; i < gpu_type_count; ++i)
+		{
+			_bytes[i] = 0;
+			_count[i] = 0;
+		}
+		_previous = current();
+		current() = this;
+	}
+
+	// con el contexto GL aun vivo
+	~gpu_resources()
+	{
+		for (auto& fence : _fences)
+			glDeleteSync(fence.sync);
+		for (const pending& p : _pending)
+			destroy(p.object);
+		for (slot& s : _slots)
+		{
+			if (s.alive && s.resident)
+				destroy(s.object);
+		}
+		current() = _previous;
+	}
+
+	gpu_resources(const gpu_resources&) = delete;
+	gpu_resources& operator=(const gpu_resources&) = delete;
+
+	// gestor activo (el ultimo creado), nullptr si no hay
+	static gpu_resources*& current()
+	{
+		static gpu_resources* instance = nullptr;
+		return instance;
+	}
+
+	// objeto ya creado; sin loader no se puede expulsar
+	gpu_handle adopt(const gpu_object& object)
+	{
+		gpu_handle handle = allocate();
+		slot& s = _slots[handle.index];
+		s.object = object;
+		s.resident = true;
+		account(s.object, +1);
+		return handle;
+	}
+
+	/*
+	Creates the object with loader. Evictable objects are deleted when
+	over budget and created again by the same loader on the next use().
+	*/
+	gpu_handle create(gpu_type type, const gpu_loader& loader, bool evictable = true)
+	{
+		gpu_handle handle = allocate();
+		slot& s = _slots[handle.index];
+		s.object.type = type;
+		s.loader = loader;
+		s.evictable = evictable;
+		if (!load(handle.index))
+		{
+			release(handle);
+			return gpu_handle();
+		}
+		evict_to_budget();
+		return handle;
+	}
+
+	void retain(gpu_handle handle)
+	{
+		if (slot* s = find(handle))
+			++s->refs;
+	}
+
+	// con la ultima referencia el handle deja de ser valido y el borrado se aplaza
+	void release(gpu_handle handle)
+	{
+		slot* s = find(handle);
+		if (!s || --s->refs > 0)
+			return;
+		if (s->resident)
+		{
+			unlink(handle.index);
+			retire(s->object);
+		}
+		*s = slot(s->generation + 1);
+		_free.push_back(handle.index);
+	}
+
+	/*
+	GL name i of the object, loaded again if it was evicted. Marks it as
+	used in this frame (it won't be evicted until the next one). 0 if the
+	handle is no longer valid or the load failed.
+	*/
+	GLuint use(gpu_handle handle, unsigned int i = 0)
+	{
+		slot* s = find(handle);
+		if (!s)
+			return 0;
+		if (!s->resident)
+		{
+			++_reloads;
+			if (!load(handle.index))
+				return 0;
+			s = &_slots[handle.index];
+			evict_to_budget();
+		}
+		s->last_used = _frame;
+		touch(handle.index);
+		return s->object.names[i];
+	}
+
+	const gpu_object* get(gpu_handle handle) const
+	{
+		const slot* s = find(handle);
+		return (s && s->resident) ? &s->object : nullptr;
+	}
+
+	// el objeto ha cambiado de tamaño (glBufferData, glTexImage2D)
+	void resize(gpu_handle handle, size_t bytes)
+	{
+		slot* s = find(handle);
+		if (!s || !s->resident)
+			return;
+		_bytes[s->object.type] -= s->object.bytes;
+		s->object.bytes = bytes;
+		_bytes[s->object.type] += bytes;
+	}
+
+	/*
+	Once per frame, after the last draw: fences the frame, deletes what
+	the GPU can no longer be using and evicts down to the budget.
+	*/
+	void end_frame()
+	{
+		fence f;
+		f.frame = _frame;
+		f.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_fences.push_back(f);
+		++_frame;
+
+		// frames que la GPU ya ha terminado
+		while (!_fences.empty())
+		{
+			GLenum status = glClientWaitSync(_fences.front().sync, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			_completed = _fences.front().frame + 1;
+			glDeleteSync(_fences.front().sync);
+			_fences.pop_front();
+		}
+
+		while (!_pending.empty())
+		{
+			const pending& p = _pending.front();
+			if (p.frame + _options.destroy_delay > _frame || p.frame >= _completed)
+				break;
+			_pending_bytes -= p.object.bytes;
+			destroy(p.object);
+			_pending.pop_front();
+		}
+
+		evict_to_budget();
+	}
+
+	void set_budget(size_t bytes)
+	{
+		_options.budget_bytes = bytes;
+		evict_to_budget();
+	}
+
+	// contabilidad (solo objetos residentes)
+	inline size_t bytes(gpu_type type) const { return _bytes[type]; }
+	inline size_t count(gpu_type type) const { return _count[type]; }
+	size_t resident_bytes() const
+	{
+		size_t total = 0;
+		for (int i = 0; i < gpu_type_count; ++i)
+			total += _bytes[i];
+		return total;
+	}
+	// liberados pero aun no borrados
+	inline size_t pending_bytes() const { return _pending_bytes; }
+	inline size_t evictions() const { return _evictions; }
+	inline size_t reloads() const { return _reloads; }
+	inline uint64_t frame() const { return _frame; }
+
+protected:
+	static const uint32_t nil = 0xFFFFFFFFu;
+
+	struct slot
+	{
+		explicit slot(uint32_t generation_ = 0)
+			: generation(generation_)
+		{
+
+		}
+
+		gpu_object object;
+		gpu_loader loader;
+		uint32_t generation;
+		uint32_t refs = 0;
+		uint64_t last_used = 0;
+		bool alive = false;
+		bool resident = false;
+		bool evictable = false;
+		// lista LRU de residentes expulsables
+		uint32_t prev = nil;
+		uint32_t next = nil;
+	};
+
+	struct pending
+	{
+		gpu_object object;
+		uint64_t frame;
+	};
+
+	struct fence
+	{
+		uint64_t frame;
+		GLsync sync;
+	};
+
+	gpu_handle allocate()
+	{
+		uint32_t index;
+		if (!_free.empty())
+		{
+			index = _free.back();
+			_free.pop_back();
+		}
+		else
+		{
+			index = (uint32_t)_slots.size();
+			_slots.emplace_back();
+		}
+		slot& s = _slots[index];
+		s.alive = true;
+		s.refs = 1;
+		s.last_used = _frame;
+		gpu_handle handle;
+		handle.index = index;
+		handle.generation = s.generation;
+		return handle;
+	}
+
+	slot* find(gpu_handle handle)
+	{
+		if (handle.index >= _slots.size())
+			return nullptr;
+		slot& s = _slots[handle.index];
+		return (s.alive && s.generation == handle.generation) ? &s : nullptr;
+	}
+
+	const slot* find(gpu_handle handle) const
+	{
+		return const_cast<gpu_resources*>(this)->find(handle);
+	}
+
+	bool load(uint32_t index)
+	{
+		slot& s = _slots[index];
+		gpu_object object;
+		object.type = s.object.type;
+		if (!s.loader || !s.loader(object))
+		{
+			LOGE("Can't load GPU resource %u", index);
+			return false;
+		}
+		s.object = object;
+		s.resident = true;
+		s.last_used = _frame;
+		account(s.object, +1);
+		if (s.evictable)
+			link_front(index);
+		return true;
+	}
+
+	void evict_to_budget()
+	{
+		// del menos usado hacia delante, nunca lo usado en este frame
+		uint32_t index = _lru_tail;
+		while (index != nil && resident_bytes() > _options.budget_bytes)
+		{
+			slot& s = _slots[index];
+			uint32_t prev = s.prev;
+			if (s.last_used >= _frame)
+				break;
+			unlink(index);
+			retire(s.object);
+			s.resident = false;
+			++_evictions;
+			index = prev;
+		}
+	}
+
+	// sale de la contabilidad y espera a que la GPU termine con el
+	void retire(const gpu_object& object)
+	{
+		account(object, -1);
+		pending p;
+		p.object = object;
+		p.frame = _frame;
+		_pending.push_back(p);
+		_pending_bytes += object.bytes;
+	}
+
+	void account(const gpu_object& object, int sign)
+	{
+		if (sign > 0)
+		{
+			_bytes[object.type] += object.bytes;
+			++_count[object.type];
+		}
+		else
+		{
+			_bytes[object.type] -= object.bytes;
+			--_count[object.type];
+		}
+	}
+
+	static void destroy(const gpu_object& object)
+	{
+		switch (object.type)
+		{
+			case gpu_buffer:
+				glDeleteBuffers(1, &object.names[0]);
+				break;
+			case gpu_vertex_array:
+				glDeleteVertexArrays(1, &object.names[0]);
+				break;
+			case gpu_texture:
+				glDeleteTextures(1, &object.names[0]);
+				break;
+			case gpu_program:
+				glDeleteProgram(object.names[0]);
+				break;
+			case gpu_mesh:
+				glDeleteVertexArrays(1, &object.names[0]);
+				for (int i = 1; i < 3; ++i)
+					if (object.names[i])
+						glDeleteBuffers(1, &object.names[i]);
+				break;
+			default:
+				break;
+		}
+	}
+
+	void touch(uint32_t index)
+	{
+		if (!_slots[index].evictable || _lru_head == index)
+			return;
+		unlink(index);
+		link_front(index);
+	}
+
+	void link_front(uint32_t index)
+	{
+		slot& s = _slots[index];
+		s.prev = nil;
+		s.next = _lru_head;
+		if (_lru_head != nil)
+			_slots[_lru_head].prev = index;
+		_lru_head = index;
+		if (_lru_tail == nil)
+			_lru_tail = index;
+	}
+
+	void unlink(uint32_t index)
+	{
+		slot& s = _slots[index];
+		if (!s.evictable)
+			return;
+		if (s.prev != nil)
+			_slots[s.prev].next = s.next;
+		else if (_lru_head == index)
+			_lru_head = s.next;
+		if (s.next != nil)
+			_slots[s.next].prev = s.prev;
+		else if (_lru_tail == index)
+			_lru_tail = s.prev;
+		s.prev = s.next = nil;
+	}
+
+protected:
+	gpu_options _options;
+	gpu_resources* _previous;
+	uint64_t _frame;
+	// frames < _completed ya terminados en la GPU
+	uint64_t _completed;
+	std::vector<slot> _slots;
+	std::vector<uint32_t> _free;
+	std::deque<pending> _pending;
+	std::deque<fence> _fences;
+	size_t _pending_bytes;
+	size_t _bytes[gpu_type_count];
+	size_t _count[gpu_type_count];
+	uint32_t _lru_head;
+	uint32_t _lru_tail;
+	size_t _evictions;
+	size_t _reloads;
+};
+
+// referencia con RAII: copia = retain, destructor = release
+class gpu_ref
+{
+public:
+	gpu_ref()
+		: _owner(nullptr)
+	{
+
+	}
+
+	gpu_ref(gpu_resources& owner, gpu_handle handle)
+		: _owner(&owner)
+		, _handle(handle)
+	{
+
+	}
+
+	gpu_ref(const gpu_ref& other)
+		: _owner(other._owner)
+		, _handle(other._handle)
+	{
+		if (_owner)
+			_owner->retain(_handle);
+	}
+
+	gpu_ref(gpu_ref&& other)
+		: _owner(other._owner)
+		, _handle(other._handle)
+	{
+		other._owner = nullptr;
+		other._handle = gpu_handle();
+	}
+
+	gpu_ref& operator=(gpu_ref other)
+	{
+		std::swap(_owner, other._owner);
+		std::swap(_handle, other._handle);
+		return *this;
+	}
+
+	~gpu_ref()
+	{
+		if (_owner)
+			_owner->release(_handle);
+	}
+
+	GLuint use(unsigned int i = 0) const { return _owner ? _owner->use(_handle, i) : 0; }
+	gpu_handle handle() const { return _handle; }
+	explicit operator bool() const { return _owner && _handle.valid(); }
+
+protected:
+	gpu_resources* _owner;
+	gpu_handle _handle;
+};
+
+} // end namespace dune
+
+#endif // GPURESOURCES_H
@@ -0,0 +1,163 @@
+/**
+@file InputQueue.h
+
+Timestamped input events and lock-free single producer / single consumer
+ring. The capture thread produces, the simulation step consumes.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace dune {
+
+// reloj monotono en nanosegundos
+inline uint64_t input_clock_ns()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum input_event_type : uint8_t
+{
+	input_key_pressed,
+	input_key_released,
+	input_mouse_moved,
+	input_mouse_pressed,
+	input_mouse_released,
+	input_joy_button_pressed,
+	input_joy_button_released,
+	input_joy_axis,
+	input_joy_pov,
+	input_joy_vector3,
+	input_event_type_count
+};
+
+/*
+Copy of an OIS event (OIS events hold references to device state,
+they can't be stored).
+*/
+struct input_event
+{
+	uint64_t time_ns;
+	input_event_type type;
+	// key code, mouse button, joystick button / axis / pov / vector index
+	int32_t code;
+	// key text (unicode)
+	uint32_t text;
+	// mouse absolute, axis value (x), pov direction (x)
+	int32_t x, y, z;
+	// mouse relative
+	int32_t rel_x, rel_y, rel_z;
+	// mouse buttons mask
+	int32_t buttons;
+	// joystick vector3
+	float vec[3];
+};
+
+/*
+Merges b into a if both can be delivered as one event: mouse moves
+(relative motion is accumulated) and moves of the same axis.
+*/
+inline bool coalesce(input_event& a, const input_event& b)
+{
+	if (a.type != b.type)
+		return false;
+	if (a.type == input_mouse_moved && a.buttons == b.buttons)
+	{
+		a.rel_x += b.rel_x;
+		a.rel_y += b.rel_y;
+		a.rel_z += b.rel_z;
+		a.x = b.x;
+		a.y = b.y;
+		a.z = b.z;
+		// el timestamp del mas antiguo: la latencia se mide desde el primero
+		return true;
+	}
+	if (a.type == input_joy_axis && a.code == b.code)
+	{
+		a.x = b.x;
+		return true;
+	}
+	return false;
+}
+
+/*
+Lock-free ring, one producer thread and one consumer thread.
+N must be power of two.
+*/
+template <typename T, size_t N>
+class spsc_ring
+{
+	static_assert((N & (N - 1)) == 0, "spsc_ring size must be power of two");
+public:
+	spsc_ring()
+		: _head(0)
+		, _tail(0)
+		, _dropped(0)
+	{
+
+	}
+
+	spsc_ring(const spsc_ring&) = delete;
+	spsc_ring& operator=(const spsc_ring&) = delete;
+
+	// productor; false si esta lleno (el evento se descarta)
+	bool push(const T& item)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head - _tail.load(std::memory_order_acquire) == N)
+		{
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		_items[head & (N - 1)] = item;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumidor
+	bool pop(T& item)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire))
+			return false;
+		item = _items[tail & (N - 1)];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumidor: vacia todo de una vez, func(const T&)
+	template <typename F>
+	size_t drain(F&& func)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		size_t head = _head.load(std::memory_order_acquire);
+		for (size_t i = tail; i != head; ++i)
+			func(_items[i & (N - 1)]);
+		_tail.store(head, std::memory_order_release);
+		return head - tail;
+	}
+
+	size_t dropped() const
+	{
+		return _dropped.load(std::memory_order_relaxed);
+	}
+
+protected:
+	alignas(64) std::atomic<size_t> _head;
+	alignas(64) std::atomic<size_t> _tail;
+	alignas(64) std::atomic<size_t> _dropped;
+	T _items[N];
+};
+
+} // end namespace dune
+
+#endif // INPUTQUEUE_H
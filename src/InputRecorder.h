@@ -0,0 +1,306 @@
+/**
+@file InputRecorder.h
+
+Deterministic input record / replay. Events delivered by input_system
+are stored with their frame and time stamps in a compact stream:
+
+	"DINP" version
+	per event: type, varint frame delta, varint time delta (us),
+	           zigzag varint fields used by the type
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include "InputQueue.h"
+
+namespace dune {
+
+const uint32_t INPUT_LOG_MAGIC = 0x504E4944; // "DINP"
+const uint32_t INPUT_LOG_VERSION = 1;
+
+namespace varint {
+
+inline void write(std::vector<unsigned char>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+inline void write_signed(std::vector<unsigned char>& out, int64_t value)
+{
+	// zigzag: valores pequeños negativos ocupan poco
+	write(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+inline bool read(const unsigned char*& p, const unsigned char* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7)
+	{
+		unsigned char byte = *p++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+inline bool read_signed(const unsigned char*& p, const unsigned char* end, int64_t& value)
+{
+	uint64_t raw;
+	if (!read(p, end, raw))
+		return false;
+	value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+	return true;
+}
+
+} // end namespace varint
+
+class input_recorder
+{
+public:
+	input_recorder()
+		: _last_frame(0)
+		, _last_time_ns(0)
+		, _first(true)
+	{
+		append_u32(INPUT_LOG_MAGIC);
+		append_u32(INPUT_LOG_VERSION);
+	}
+
+	void record(uint64_t frame, const input_event& event)
+	{
+		if (_first)
+		{
+			_last_frame = frame;
+			_last_time_ns = event.time_ns;
+			_first = false;
+			// primer evento: frame y tiempo absolutos
+			_buffer.push_back(0xFF);
+			varint::write(_buffer, frame);
+			varint::write(_buffer, event.time_ns / 1000);
+		}
+
+		_buffer.push_back((unsigned char)event.type);
+		varint::write(_buffer, frame - _last_frame);
+		uint64_t time_us = event.time_ns / 1000;
+		uint64_t last_us = _last_time_ns / 1000;
+		varint::write(_buffer, time_us >= last_us ? time_us - last_us : 0);
+		_last_frame = frame;
+		_last_time_ns = event.time_ns;
+
+		varint::write_signed(_buffer, event.code);
+		switch (event.type)
+		{
+			case input_key_pressed:
+			case input_key_released:
+				varint::write(_buffer, event.text);
+				break;
+			case input_mouse_moved:
+			case input_mouse_pressed:
+			case input_mouse_released:
+				varint::write_signed(_buffer, event.x);
+				varint::write_signed(_buffer, event.y);
+				varint::write_signed(_buffer, event.z);
+				varint::write_signed(_buffer, event.rel_x);
+				varint::write_signed(_buffer, event.rel_y);
+				varint::write_signed(_buffer, event.rel_z);
+				varint::write(_buffer, (uint32_t)event.buttons);
+				break;
+			case input_joy_axis:
+			case input_joy_pov:
+				varint::write_signed(_buffer, event.x);
+				break;
+			case input_joy_vector3:
+			{
+				const unsigned char* raw = (const unsigned char*)event.vec;
+				_buffer.insert(_buffer.end(), raw, raw + sizeof(event.vec));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	const std::vector<unsigned char>& data() const { return _buffer; }
+
+	bool save(const std::string& filename) const
+	{
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		file.write((const char*)_buffer.data(), (std::streamsize)_buffer.size());
+		return (bool)file;
+	}
+
+protected:
+	void append_u32(uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+			_buffer.push_back((unsigned char)(value >> (i * 8)));
+	}
+
+protected:
+	std::vector<unsigned char> _buffer;
+	uint64_t _last_frame;
+	uint64_t _last_time_ns;
+	bool _first;
+};
+
+/*
+Decodes the whole stream at load; next_frame() returns the events
+of each frame in the recorded order.
+*/
+class input_player
+{
+public:
+	input_player()
+		: _cursor(0)
+	{
+
+	}
+
+	bool load(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		if (!file)
+			return false;
+		std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return parse(data);
+	}
+
+	bool parse(const std::vector<unsigned char>& data)
+	{
+		_events.clear();
+		_frames.clear();
+		_cursor = 0;
+		if (data.size() < 8)
+			return false;
+		uint32_t magic = 0, version = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			magic |= (uint32_t)data[i] << (i * 8);
+			version |= (uint32_t)data[4 + i] << (i * 8);
+		}
+		if (magic != INPUT_LOG_MAGIC || version != INPUT_LOG_VERSION)
+			return false;
+
+		const unsigned char* p = data.data() + 8;
+		const unsigned char* end = data.data() + data.size();
+		uint64_t frame = 0, time_us = 0;
+		while (p < end)
+		{
+			unsigned char type = *p++;
+			if (type == 0xFF)
+			{
+				if (!varint::read(p, end, frame) || !varint::read(p, end, time_us))
+					return false;
+				continue;
+			}
+			if (type >= input_event_type_count)
+				return false;
+
+			uint64_t frame_delta, time_delta;
+			int64_t code;
+			if (!varint::read(p, end, frame_delta) || !varint::read(p, end, time_delta) || !varint::read_signed(p, end, code))
+				return false;
+			frame += frame_delta;
+			time_us += time_delta;
+
+			input_event event = {};
+			event.type = (input_event_type)type;
+			event.time_ns = time_us * 1000;
+			event.code = (int32_t)code;
+
+			bool ok = true;
+			switch (event.type)
+			{
+				case input_key_pressed:
+				case input_key_released:
+				{
+					uint64_t text;
+					ok = varint::read(p, end, text);
+					event.text = (uint32_t)text;
+					break;
+				}
+				case input_mouse_moved:
+				case input_mouse_pressed:
+				case input_mouse_released:
+				{
+					int64_t v[6];
+					uint64_t buttons = 0;
+					for (int i = 0; i < 6 && ok; ++i)
+						ok = varint::read_signed(p, end, v[i]);
+					ok = ok && varint::read(p, end, buttons);
+					event.x = (int32_t)v[0]; event.y = (int32_t)v[1]; event.z = (int32_t)v[2];
+					event.rel_x = (int32_t)v[3]; event.rel_y = (int32_t)v[4]; event.rel_z = (int32_t)v[5];
+					event.buttons = (int32_t)buttons;
+					break;
+				}
+				case input_joy_axis:
+				case input_joy_pov:
+				{
+					int64_t x;
+					ok = varint::read_signed(p, end, x);
+					event.x = (int32_t)x;
+					break;
+				}
+				case input_joy_vector3:
+					ok = (end - p) >= (ptrdiff_t)sizeof(event.vec);
+					if (ok)
+					{
+						std::memcpy(event.vec, p, sizeof(event.vec));
+						p += sizeof(event.vec);
+					}
+					break;
+				default:
+					break;
+			}
+			if (!ok)
+				return false;
+			_events.push_back(event);
+			_frames.push_back(frame);
+		}
+		return true;
+	}
+
+	/*
+	Calls func(event) for every event of 'frame'. Frames must be
+	requested in increasing order.
+	*/
+	template <typename F>
+	void next_frame(uint64_t frame, F&& func)
+	{
+		while (_cursor < _events.size() && _frames[_cursor] <= frame)
+		{
+			func(_events[_cursor]);
+			++_cursor;
+		}
+	}
+
+	bool finished() const { return _cursor >= _events.size(); }
+	size_t size() const { return _events.size(); }
+	// ultimo frame con eventos
+	uint64_t last_frame() const { return _frames.empty() ? 0 : _frames.back(); }
+
+protected:
+	std::vector<input_event> _events;
+	std::vector<uint64_t> _frames;
+	size_t _cursor;
+};
+
+} // end namespace dune
+
+#endif // INPUTRECORDER_H
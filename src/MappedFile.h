@@ -0,0 +1,137 @@
+/**
+@file MappedFile.h
+
+Read only file mapped in memory (mmap / MapViewOfFile).
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+namespace dune {
+
+class mapped_file
+{
+public:
+	mapped_file()
+		: _data(nullptr)
+		, _size(0)
+#ifdef _WIN32
+		, _file(INVALID_HANDLE_VALUE)
+		, _mapping(NULL)
+#endif
+	{
+
+	}
+
+	~mapped_file()
+	{
+		close();
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	bool open(const std::string& filename)
+	{
+		close();
+#ifdef _WIN32
+		_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (_file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		GetFileSizeEx(_file, &size);
+		_size = (size_t)size.QuadPart;
+		if (_size == 0)
+			return true;
+		_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_mapping == NULL)
+		{
+			close();
+			return false;
+		}
+		_data = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+		_size = (size_t)st.st_size;
+		if (_size == 0)
+		{
+			::close(fd);
+			return true;
+		}
+		void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// el mapping sobrevive al descriptor
+		::close(fd);
+		if (data == MAP_FAILED)
+		{
+			_size = 0;
+			return false;
+		}
+		// lectura secuencial, que el kernel adelante paginas
+		// los consejos no son flags: una llamada por cada uno
+		madvise(data, _size, MADV_SEQUENTIAL);
+		madvise(data, _size, MADV_WILLNEED);
+		_data = (const unsigned char*)data;
+#endif
+		if (_data == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (_data)
+			UnmapViewOfFile(_data);
+		if (_mapping != NULL)
+			CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE)
+			CloseHandle(_file);
+		_mapping = NULL;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		if (_data)
+			munmap((void*)_data, _size);
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+
+	const unsigned char* data() const { return _data; }
+	size_t size() const { return _size; }
+
+protected:
+	const unsigned char* _data;
+	size_t _size;
+#ifdef _WIN32
+	HANDLE _file;
+	HANDLE _mapping;
+#endif
+};
+
+} // end namespace dune
+
+#endif // MAPPEDFILE_H
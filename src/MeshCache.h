@@ -0,0 +1,378 @@
+/**
+@file MeshCache.h
+
+Binary mesh cache. Versioned container loaded mapping the file in memory:
+
+	header
+	vertex format descriptor (must match V::build)
+	vertex blob
+	index blob (16 or 32 bits, every level of detail)
+	submesh table (with bounding volumes, level 0 first)
+	level of detail table (first submesh + error)
+
+Blobs are uploaded directly from the mapping, without parsing nor copies.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <sys/stat.h>
+#include "MappedFile.h"
+#include "Bounds.h"
+#include "MeshImporter.h"
+#include "MeshLod.h"
+
+namespace dune {
+
+const uint32_t MESH_CACHE_MAGIC = 0x48534D44; // "DMSH"
+const uint32_t MESH_CACHE_VERSION = 2;
+
+struct mesh_cache_attribute
+{
+	uint32_t slot;
+	uint32_t components;
+	uint32_t type;
+	uint32_t normalized;
+	uint32_t offset;
+
+	bool operator==(const mesh_cache_attribute& other) const
+	{
+		return std::memcmp(this, &other, sizeof(mesh_cache_attribute)) == 0;
+	}
+};
+
+struct mesh_cache_submesh
+{
+	uint32_t first_index;
+	uint32_t index_count;
+	aabb box;
+	sphere bounding_sphere;
+};
+
+struct mesh_cache_lod
+{
+	uint32_t first_submesh;
+	float error;
+};
+
+struct mesh_cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertex_stride;
+	uint32_t attribute_count;
+	uint32_t index_type;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t submesh_count;
+	uint32_t lod_count;
+	uint64_t attributes_offset;
+	uint64_t vertices_offset;
+	uint64_t indexes_offset;
+	uint64_t submeshes_offset;
+	uint64_t lods_offset;
+	uint64_t file_size;
+	aabb box;
+	sphere bounding_sphere;
+};
+
+/*
+Vertex layout descriptor, the same that V::build declares to OpenGL.
+A cache with another layout is rejected (must be rebuilt).
+*/
+template <typename V>
+struct vertex_format;
+
+template <>
+struct vertex_format<MeshBuffer>
+{
+	static std::vector<mesh_cache_attribute> attributes()
+	{
+		return {
+			{AttribPosition, 3, GL_FLOAT, GL_FALSE, 0},
+			{AttribNormal, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3},
+			{AttribCoord, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 6},
+			{AttribColor, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 8},
+		};
+	}
+};
+
+template <>
+struct vertex_format<MeshSkinnedBuffer>
+{
+	static std::vector<mesh_cache_attribute> attributes()
+	{
+		std::vector<mesh_cache_attribute> attribs = vertex_format<MeshBuffer>::attributes();
+		attribs.push_back({AttribBones, MAX_BONES_PER_VERTICES, GL_FLOAT, GL_FALSE, sizeof(float) * 12});
+		attribs.push_back({AttribWeights, MAX_BONES_PER_VERTICES, GL_FLOAT, GL_FALSE, sizeof(float) * (12 + MAX_BONES_PER_VERTICES)});
+		return attribs;
+	}
+};
+
+namespace mesh {
+
+inline uint64_t align16(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t(15);
+}
+
+template <typename V>
+bool save_cache(const std::string& filename, const mesh_data<V>& mesh)
+{
+	std::vector<mesh_cache_attribute> attribs = vertex_format<V>::attributes();
+	const size_t index_size = (mesh.index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+	const void* index_data = (mesh.index_type == GL_UNSIGNED_SHORT) ? (const void*)mesh.indexes16.data() : (const void*)mesh.indexes.data();
+
+	std::vector<mesh_cache_submesh> submeshes;
+	for (const submesh& sub : mesh.submeshes)
+	{
+		mesh_cache_submesh entry;
+		entry.first_index = sub.first_index;
+		entry.index_count = sub.index_count;
+		entry.box = aabb::empty();
+		for (unsigned int i = sub.first_index; i < sub.first_index + sub.index_count; ++i)
+		{
+			unsigned int index = (mesh.index_type == GL_UNSIGNED_SHORT) ? mesh.indexes16[i] : mesh.indexes[i];
+			entry.box.extend(mesh.vertices[index].position);
+		}
+		entry.bounding_sphere = sphere::from(entry.box);
+		submeshes.push_back(entry);
+	}
+
+	std::vector<mesh_cache_lod> lods;
+	for (const mesh_lod& lod : mesh.lods)
+		lods.push_back(mesh_cache_lod{lod.first_submesh, lod.error});
+	if (lods.empty())
+		lods.push_back(mesh_cache_lod{0, 0.0f});
+
+	mesh_cache_header header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertex_stride = sizeof(V);
+	header.attribute_count = (uint32_t)attribs.size();
+	header.index_type = mesh.index_type;
+	header.vertex_count = (uint32_t)mesh.vertices.size();
+	header.index_count = mesh.index_count();
+	header.submesh_count = (uint32_t)submeshes.size();
+	header.lod_count = (uint32_t)lods.size();
+	header.attributes_offset = align16(sizeof(mesh_cache_header));
+	header.vertices_offset = align16(header.attributes_offset + sizeof(mesh_cache_attribute) * attribs.size());
+	header.indexes_offset = align16(header.vertices_offset + sizeof(V) * mesh.vertices.size());
+	header.submeshes_offset = align16(header.indexes_offset + index_size * header.index_count);
+	header.lods_offset = align16(header.submeshes_offset + sizeof(mesh_cache_submesh) * submeshes.size());
+	header.file_size = header.lods_offset + sizeof(mesh_cache_lod) * lods.size();
+	header.box = compute_aabb(mesh.vertices.data(), mesh.vertices.size());
+	header.bounding_sphere = sphere::from(header.box);
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOGE("Can't write mesh cache %s", filename.c_str());
+		return false;
+	}
+
+	const char padding[16] = {0};
+	auto write_at = [&](uint64_t offset, const void* data, size_t size) {
+		uint64_t position = (uint64_t)file.tellp();
+		file.write(padding, (std::streamsize)(offset - position));
+		if (size > 0)
+			file.write((const char*)data, (std::streamsize)size);
+	};
+	write_at(0, &header, sizeof(header));
+	write_at(header.attributes_offset, attribs.data(), sizeof(mesh_cache_attribute) * attribs.size());
+	write_at(header.vertices_offset, mesh.vertices.data(), sizeof(V) * mesh.vertices.size());
+	write_at(header.indexes_offset, index_data, index_size * header.index_count);
+	write_at(header.submeshes_offset, submeshes.data(), sizeof(mesh_cache_submesh) * submeshes.size());
+	write_at(header.lods_offset, lods.data(), sizeof(mesh_cache_lod) * lods.size());
+	return (bool)file;
+}
+
+} // end namespace mesh
+
+/*
+Mesh cache mapped in memory. Pointers are valid while the object lives.
+*/
+template <typename V>
+class mesh_cache
+{
+public:
+	bool open(const std::string& filename)
+	{
+		_header = nullptr;
+		if (!_file.open(filename))
+			return false;
+
+		if (_file.size() < sizeof(mesh_cache_header))
+		{
+			LOGE("Mesh cache %s truncated", filename.c_str());
+			return false;
+		}
+		const mesh_cache_header* header = (const mesh_cache_header*)_file.data();
+		if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION)
+		{
+			LOGE("Mesh cache %s: invalid magic or version", filename.c_str());
+			return false;
+		}
+		if (header->file_size != _file.size() || header->vertex_stride != sizeof(V))
+		{
+			LOGE("Mesh cache %s: size mismatch", filename.c_str());
+			return false;
+		}
+		if (header->index_type != GL_UNSIGNED_SHORT && header->index_type != GL_UNSIGNED_INT)
+		{
+			LOGE("Mesh cache %s: invalid index type", filename.c_str());
+			return false;
+		}
+		const size_t index_size = (header->index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+		if (!in_bounds(header->attributes_offset, header->attribute_count, sizeof(mesh_cache_attribute)) ||
+			!in_bounds(header->vertices_offset, header->vertex_count, sizeof(V)) ||
+			!in_bounds(header->indexes_offset, header->index_count, index_size) ||
+			!in_bounds(header->submeshes_offset, header->submesh_count, sizeof(mesh_cache_submesh)))
+		{
+			LOGE("Mesh cache %s: section out of bounds", filename.c_str());
+			return false;
+		}
+		std::vector<mesh_cache_attribute> expected = vertex_format<V>::attributes();
+		const mesh_cache_attribute* attribs = (const mesh_cache_attribute*)(_file.data() + header->attributes_offset);
+		if (header->attribute_count != expected.size() || !std::equal(expected.begin(), expected.end(), attribs))
+		{
+			LOGE("Mesh cache %s: vertex format mismatch", filename.c_str());
+			return false;
+		}
+		// indices fuera del VBO: glDrawElements leeria mas alla del buffer
+		if (!indexes_in_range(_file.data() + header->indexes_offset, header->index_count, header->index_type, header->vertex_count))
+		{
+			LOGE("Mesh cache %s: index out of range", filename.c_str());
+			return false;
+		}
+		const mesh_cache_submesh* subs = (const mesh_cache_submesh*)(_file.data() + header->submeshes_offset);
+		for (uint32_t i = 0; i < header->submesh_count; ++i)
+		{
+			if (subs[i].first_index > header->index_count || subs[i].index_count > header->index_count - subs[i].first_index)
+			{
+				LOGE("Mesh cache %s: submesh %u out of range", filename.c_str(), i);
+				return false;
+			}
+		}
+		// lod_mesh::render usa [first_submesh de un nivel, first_submesh del siguiente)
+		if (header->lod_count == 0 || !in_bounds(header->lods_offset, header->lod_count, sizeof(mesh_cache_lod)))
+		{
+			LOGE("Mesh cache %s: lod table out of bounds", filename.c_str());
+			return false;
+		}
+		const mesh_cache_lod* lods = (const mesh_cache_lod*)(_file.data() + header->lods_offset);
+		for (uint32_t i = 0; i < header->lod_count; ++i)
+		{
+			uint32_t previous = (i == 0) ? 0 : lods[i - 1].first_submesh;
+			if ((i == 0 && lods[i].first_submesh != 0) || lods[i].first_submesh < previous || lods[i].first_submesh > header->submesh_count)
+			{
+				LOGE("Mesh cache %s: lod %u out of range", filename.c_str(), i);
+				return false;
+			}
+		}
+		_header = header;
+		return true;
+	}
+
+	const mesh_cache_header& header() const { return *_header; }
+	const V* vertices() const { return (const V*)(_file.data() + _header->vertices_offset); }
+	const void* indexes() const { return _file.data() + _header->indexes_offset; }
+	const mesh_cache_submesh* submeshes() const { return (const mesh_cache_submesh*)(_file.data() + _header->submeshes_offset); }
+	const mesh_cache_lod* lods() const { return (const mesh_cache_lod*)(_file.data() + _header->lods_offset); }
+
+	std::unique_ptr<StaticGeometryElement<V> > create_element() const
+	{
+		auto element = std::make_unique<StaticGeometryElement<V> >(_header->vertex_count, _header->index_count, _header->index_type);
+		element->upload_data(vertices(), _header->vertex_count);
+		element->upload_indexes(indexes(), _header->index_count);
+		return element;
+	}
+
+	std::unique_ptr<lod_mesh<V> > create_lod_mesh() const
+	{
+		std::vector<submesh> subs;
+		for (uint32_t i = 0; i < _header->submesh_count; ++i)
+			subs.push_back({submeshes()[i].first_index, submeshes()[i].index_count});
+		std::vector<mesh_lod> levels;
+		for (uint32_t i = 0; i < _header->lod_count; ++i)
+			levels.push_back(mesh_lod{lods()[i].first_submesh, lods()[i].error});
+		return std::make_unique<lod_mesh<V> >(create_element(), subs, levels, _header->bounding_sphere);
+	}
+
+	void close()
+	{
+		_header = nullptr;
+		_file.close();
+	}
+
+protected:
+	static bool indexes_in_range(const void* data, uint32_t count, uint32_t index_type, uint32_t vertex_count)
+	{
+		if (index_type == GL_UNSIGNED_SHORT)
+		{
+			const GLushort* indexes = (const GLushort*)data;
+			return std::all_of(indexes, indexes + count, [vertex_count](GLushort i) { return i < vertex_count; });
+		}
+		const GLuint* indexes = (const GLuint*)data;
+		return std::all_of(indexes, indexes + count, [vertex_count](GLuint i) { return i < vertex_count; });
+	}
+
+	// seccion alineada (como la escribe save_cache) y dentro del fichero
+	bool in_bounds(uint64_t offset, uint64_t count, uint64_t element_size) const
+	{
+		uint64_t size = _file.size();
+		return (offset % 16) == 0 && offset >= sizeof(mesh_cache_header) && offset <= size && count <= (size - offset) / element_size;
+	}
+
+protected:
+	mapped_file _file;
+	const mesh_cache_header* _header = nullptr;
+};
+
+namespace mesh {
+
+inline bool is_newer(const std::string& a, const std::string& b)
+{
+	struct stat sa, sb;
+	if (stat(a.c_str(), &sa) != 0)
+		return false;
+	if (stat(b.c_str(), &sb) != 0)
+		return true;
+	return sa.st_mtime >= sb.st_mtime;
+}
+
+/*
+Opens cache_file if it is up to date with source_file (OBJ), else
+imports and optimizes the source, generates its levels of detail and
+rewrites the cache (caches of older versions are rebuilt too).
+*/
+inline bool load_cached(const std::string& source_file, const std::string& cache_file, mesh_cache<MeshBuffer>& cache,
+						const lod_options& options = lod_options())
+{
+	if (is_newer(cache_file, source_file) && cache.open(cache_file))
+		return true;
+
+	mesh_data<MeshBuffer> mesh;
+	if (!load_obj(source_file, mesh))
+		return false;
+	generate_lods(mesh, options);
+	if (!save_cache(cache_file, mesh))
+		return false;
+	return cache.open(cache_file);
+}
+
+} // end namespace mesh
+
+} // end namespace dune
+
+#endif // MESHCACHE_H
@@ -0,0 +1,517 @@
+/**
+@file MeshImporter.h
+
+Mesh import pipeline: OBJ parsing, vertex welding, vertex cache (Forsyth)
+and vertex fetch optimization, 16 bits index compression.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef MESHIMPORTER_H
+#define MESHIMPORTER_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include "GeometryElement.h"
+#include "GeometryMesh.h"
+
+namespace dune {
+
+struct submesh
+{
+	// primer indice del submesh
+	unsigned int first_index;
+	// num indices
+	unsigned int index_count;
+};
+
+// nivel de detalle (MeshLod.h)
+struct mesh_lod
+{
+	// primer submesh del nivel, cada nivel tiene tantos como el nivel 0
+	unsigned int first_submesh;
+	// error geometrico respecto al nivel 0 (unidades del modelo)
+	float error;
+};
+
+template <typename V>
+struct mesh_data
+{
+	std::vector<V> vertices;
+	// solo una de las dos listas tiene datos, segun index_type
+	std::vector<GLuint> indexes;
+	std::vector<GLushort> indexes16;
+	GLenum index_type = GL_UNSIGNED_INT;
+	std::vector<submesh> submeshes;
+	// vacio: solo el nivel 0 (todos los submeshes)
+	std::vector<mesh_lod> lods;
+
+	unsigned int index_count() const
+	{
+		return (unsigned int)((index_type == GL_UNSIGNED_SHORT) ? indexes16.size() : indexes.size());
+	}
+
+	std::unique_ptr<StaticGeometryElement<V> > create_element() const
+	{
+		auto element = std::make_unique<StaticGeometryElement<V> >((unsigned int)vertices.size(), index_count(), index_type);
+		upload(*element);
+		return element;
+	}
+
+	void upload(StaticGeometryElement<V>& element) const
+	{
+		element.upload_data(vertices, (unsigned int)vertices.size());
+		if (index_type == GL_UNSIGNED_SHORT)
+			element.upload_indexes(indexes16, (unsigned int)indexes16.size());
+		else
+			element.upload_indexes(indexes, (unsigned int)indexes.size());
+	}
+};
+
+namespace mesh {
+
+// FNV-1a sobre los bytes del vertice (los vertices son POD)
+inline uint64_t hash_bytes(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; ++i)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/*
+Soup of vertices (3 per triangle) to unique vertices + indexes.
+Uses an open addressing table, no allocation per vertex.
+*/
+template <typename V>
+void weld_vertices(const std::vector<V>& soup, std::vector<V>& vertices, std::vector<GLuint>& indexes)
+{
+	const GLuint empty = std::numeric_limits<GLuint>::max();
+	size_t table_size = 1;
+	while (table_size < soup.size() * 2)
+		table_size <<= 1;
+	std::vector<GLuint> table(table_size, empty);
+
+	vertices.clear();
+	vertices.reserve(soup.size());
+	indexes.clear();
+	indexes.reserve(soup.size());
+
+	for (const V& v : soup)
+	{
+		size_t slot = (size_t)hash_bytes(&v, sizeof(V)) & (table_size - 1);
+		while (true)
+		{
+			GLuint candidate = table[slot];
+			if (candidate == empty)
+			{
+				candidate = (GLuint)vertices.size();
+				vertices.emplace_back(v);
+				table[slot] = candidate;
+				indexes.push_back(candidate);
+				break;
+			}
+			if (std::memcmp(&vertices[candidate], &v, sizeof(V)) == 0)
+			{
+				indexes.push_back(candidate);
+				break;
+			}
+			slot = (slot + 1) & (table_size - 1);
+		}
+	}
+}
+
+const int VERTEX_CACHE_SIZE = 32;
+
+inline float forsyth_score(int cache_position, unsigned int remaining)
+{
+	if (remaining == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cache_position >= 0)
+	{
+		if (cache_position < 3)
+		{
+			// los 3 ultimos vertices del triangulo anterior
+			score = 0.75f;
+		}
+		else
+		{
+			const float scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cache_position - 3) * scaler, 1.5f);
+		}
+	}
+	// bonus para vertices con pocos triangulos pendientes
+	score += 2.0f / std::sqrt((float)remaining);
+	return score;
+}
+
+/*
+Tom Forsyth "Linear-Speed Vertex Cache Optimisation".
+Reorders triangles in [first, first + count) in place.
+*/
+inline void optimize_vertex_cache(GLuint* indexes, size_t count, size_t vert_count)
+{
+	const size_t tri_count = count / 3;
+	if (tri_count == 0)
+		return;
+
+	// adyacencia vertice -> triangulos
+	std::vector<unsigned int> remaining(vert_count, 0);
+	for (size_t i = 0; i < count; ++i)
+		++remaining[indexes[i]];
+
+	std::vector<unsigned int> offsets(vert_count + 1, 0);
+	for (size_t v = 0; v < vert_count; ++v)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(count);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < tri_count; ++t)
+			for (int k = 0; k < 3; ++k)
+				adjacency[fill[indexes[t * 3 + k]]++] = (unsigned int)t;
+	}
+
+	std::vector<int> cache_position(vert_count, -1);
+	std::vector<float> vertex_score(vert_count);
+	for (size_t v = 0; v < vert_count; ++v)
+		vertex_score[v] = forsyth_score(-1, remaining[v]);
+
+	std::vector<float> tri_score(tri_count);
+	std::vector<bool> emitted(tri_count, false);
+	for (size_t t = 0; t < tri_count; ++t)
+		tri_score[t] = vertex_score[indexes[t * 3]] + vertex_score[indexes[t * 3 + 1]] + vertex_score[indexes[t * 3 + 2]];
+
+	std::vector<GLuint> output;
+	output.reserve(count);
+
+	int cache[VERTEX_CACHE_SIZE + 3];
+	int cache_size = 0;
+	size_t best = 0;
+	float best_score = -1.0f;
+	for (size_t t = 0; t < tri_count; ++t)
+	{
+		if (tri_score[t] > best_score)
+		{
+			best_score = tri_score[t];
+			best = t;
+		}
+	}
+	size_t scan = 0;
+
+	for (size_t emitted_count = 0; emitted_count < tri_count; ++emitted_count)
+	{
+		if (best_score < 0.0f)
+		{
+			// ningun candidato en cache, primer triangulo pendiente
+			while (emitted[scan])
+				++scan;
+			best = scan;
+		}
+
+		emitted[best] = true;
+		const GLuint* tri = &indexes[best * 3];
+		for (int k = 0; k < 3; ++k)
+			output.push_back(tri[k]);
+
+		// quitar triangulo de la adyacencia
+		for (int k = 0; k < 3; ++k)
+		{
+			GLuint v = tri[k];
+			unsigned int* begin = &adjacency[offsets[v]];
+			unsigned int* end = begin + remaining[v];
+			unsigned int* it = std::find(begin, end, (unsigned int)best);
+			std::swap(*it, *(end - 1));
+			--remaining[v];
+		}
+
+		// LRU: los vertices del triangulo pasan al frente
+		int new_cache[VERTEX_CACHE_SIZE + 3];
+		int new_size = 0;
+		for (int k = 0; k < 3; ++k)
+			new_cache[new_size++] = (int)tri[k];
+		for (int i = 0; i < cache_size; ++i)
+		{
+			int v = cache[i];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+				new_cache[new_size++] = v;
+		}
+
+		// recalcular puntuaciones de los vertices tocados
+		for (int i = 0; i < new_size; ++i)
+		{
+			int v = new_cache[i];
+			cache_position[v] = (i < VERTEX_CACHE_SIZE) ? i : -1;
+			vertex_score[v] = forsyth_score(cache_position[v], remaining[v]);
+		}
+
+		best_score = -1.0f;
+		for (int i = 0; i < new_size; ++i)
+		{
+			int v = new_cache[i];
+			for (unsigned int a = 0; a < remaining[v]; ++a)
+			{
+				unsigned int t = adjacency[offsets[v] + a];
+				const GLuint* other = &indexes[t * 3];
+				tri_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+				if (tri_score[t] > best_score)
+				{
+					best_score = tri_score[t];
+					best = t;
+				}
+			}
+		}
+
+		cache_size = std::min(new_size, VERTEX_CACHE_SIZE);
+		std::copy(new_cache, new_cache + cache_size, cache);
+	}
+
+	std::copy(output.begin(), output.end(), indexes);
+}
+
+/*
+Reorders vertices in order of first use, so vertex fetch is sequential.
+*/
+template <typename V>
+void optimize_vertex_fetch(std::vector<V>& vertices, std::vector<GLuint>& indexes)
+{
+	const GLuint unused = std::numeric_limits<GLuint>::max();
+	std::vector<GLuint> remap(vertices.size(), unused);
+	std::vector<V> reordered;
+	reordered.reserve(vertices.size());
+	for (GLuint& index : indexes)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (GLuint)reordered.size();
+			reordered.emplace_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	// vertices no referenciados se descartan
+	vertices.swap(reordered);
+}
+
+/*
+Average cache miss ratio: transformed vertices / triangles (FIFO of cache_size).
+1.0 ideal for grids, 3.0 worst case.
+*/
+inline float average_cache_miss_ratio(const std::vector<GLuint>& indexes, size_t vert_count, int cache_size = 16)
+{
+	if (indexes.size() < 3)
+		return 0.0f;
+	std::vector<size_t> timestamp(vert_count, 0);
+	size_t time = cache_size + 1;
+	size_t misses = 0;
+	for (GLuint index : indexes)
+	{
+		if (time - timestamp[index] > (size_t)cache_size)
+		{
+			timestamp[index] = time++;
+			++misses;
+		}
+	}
+	return (float)misses / (indexes.size() / 3);
+}
+
+template <typename V>
+void compress_indexes(mesh_data<V>& mesh)
+{
+	if (mesh.vertices.size() <= 0xFFFF)
+	{
+		mesh.indexes16.assign(mesh.indexes.begin(), mesh.indexes.end());
+		std::vector<GLuint>().swap(mesh.indexes);
+		mesh.index_type = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		mesh.indexes16.clear();
+		mesh.index_type = GL_UNSIGNED_INT;
+	}
+}
+
+/*
+Collects triangle soup grouped in submeshes and produces an optimized mesh.
+*/
+template <typename V>
+class mesh_builder
+{
+public:
+	void begin_submesh()
+	{
+		if (_soup.size() != _submesh_begin)
+			_ranges.push_back(_soup.size());
+		_submesh_begin = _soup.size();
+	}
+
+	void add_triangle(const V& a, const V& b, const V& c)
+	{
+		_soup.emplace_back(a);
+		_soup.emplace_back(b);
+		_soup.emplace_back(c);
+	}
+
+	bool empty() const
+	{
+		return _soup.empty();
+	}
+
+	mesh_data<V> build() const
+	{
+		mesh_data<V> mesh;
+		weld_vertices(_soup, mesh.vertices, mesh.indexes);
+
+		std::vector<size_t> bounds(_ranges);
+		bounds.push_back(_soup.size());
+		size_t begin = 0;
+		for (size_t end : bounds)
+		{
+			if (end > begin)
+			{
+				optimize_vertex_cache(&mesh.indexes[begin], end - begin, mesh.vertices.size());
+				mesh.submeshes.push_back({(unsigned int)begin, (unsigned int)(end - begin)});
+			}
+			begin = end;
+		}
+
+		optimize_vertex_fetch(mesh.vertices, mesh.indexes);
+		compress_indexes(mesh);
+		return mesh;
+	}
+
+protected:
+	std::vector<V> _soup;
+	std::vector<size_t> _ranges;
+	size_t _submesh_begin = 0;
+};
+
+// indices OBJ: 1-based, negativos relativos al final
+inline int obj_index(const char* str, size_t count)
+{
+	int index = std::atoi(str);
+	if (index < 0)
+		return (int)count + index;
+	return index - 1;
+}
+
+/*
+Wavefront OBJ (v, vt, vn, f, g/o/usemtl) to MeshBuffer.
+Polygons are triangulated as fans. Each g/o/usemtl starts a submesh.
+*/
+inline bool load_obj(const std::string& filename, mesh_data<MeshBuffer>& mesh)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		LOGE("Can't open mesh %s", filename.c_str());
+		return false;
+	}
+
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> coords;
+	mesh_builder<MeshBuffer> builder;
+	std::vector<MeshBuffer> face;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream in(line);
+		std::string tag;
+		in >> tag;
+		if (tag == "v")
+		{
+			float x = 0, y = 0, z = 0;
+			in >> x >> y >> z;
+			positions.insert(positions.end(), {x, y, z});
+		}
+		else if (tag == "vn")
+		{
+			float x = 0, y = 0, z = 0;
+			in >> x >> y >> z;
+			normals.insert(normals.end(), {x, y, z});
+		}
+		else if (tag == "vt")
+		{
+			float u = 0, v = 0;
+			in >> u >> v;
+			coords.insert(coords.end(), {u, v});
+		}
+		else if (tag == "g" || tag == "o" || tag == "usemtl")
+		{
+			builder.begin_submesh();
+		}
+		else if (tag == "f")
+		{
+			face.clear();
+			std::string token;
+			while (in >> token)
+			{
+				MeshBuffer vertex;
+				std::memset(&vertex, 0, sizeof(MeshBuffer));
+				vertex.color[0] = vertex.color[1] = vertex.color[2] = vertex.color[3] = 1.0f;
+
+				const char* str = token.c_str();
+				int p = obj_index(str, positions.size() / 3);
+				if (p < 0 || (size_t)p * 3 >= positions.size())
+				{
+					LOGE("Invalid face in %s: %s", filename.c_str(), line.c_str());
+					return false;
+				}
+				std::memcpy(vertex.position, &positions[p * 3], sizeof(float) * 3);
+
+				const char* slash = std::strchr(str, '/');
+				if (slash)
+				{
+					if (slash[1] != '/' && slash[1] != '\0')
+					{
+						int t = obj_index(slash + 1, coords.size() / 2);
+						if (t >= 0 && (size_t)t * 2 < coords.size())
+							std::memcpy(vertex.coord, &coords[t * 2], sizeof(float) * 2);
+					}
+					const char* slash2 = std::strchr(slash + 1, '/');
+					if (slash2 && slash2[1] != '\0')
+					{
+						int n = obj_index(slash2 + 1, normals.size() / 3);
+						if (n >= 0 && (size_t)n * 3 < normals.size())
+							std::memcpy(vertex.normal, &normals[n * 3], sizeof(float) * 3);
+					}
+				}
+				face.emplace_back(vertex);
+			}
+			for (size_t i = 2; i < face.size(); ++i)
+				builder.add_triangle(face[0], face[i - 1], face[i]);
+		}
+	}
+
+	if (builder.empty())
+	{
+		LOGE("Mesh %s without faces", filename.c_str());
+		return false;
+	}
+
+	mesh = builder.build();
+	LOGI("Mesh %s: %d vertices, %d indexes (%s)", filename.c_str(), (int)mesh.vertices.size(), (int)mesh.index_count(),
+		(mesh.index_type == GL_UNSIGNED_SHORT) ? "16 bits" : "32 bits");
+	return true;
+}
+
+} // end namespace mesh
+
+} // end namespace dune
+
+#endif // MESHIMPORTER_H
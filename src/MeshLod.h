@@ -0,0 +1,671 @@
+/**
+@file MeshLod.h
+
+Levels of detail for meshes. generate_lods() simplifies the level 0 with
+quadric error metrics (Garland & Heckbert) and appends each level to the
+index list of the mesh: all levels share the same vertices, only the
+index ranges change (one StaticGeometryElement per mesh).
+
+Simplification is by half edge collapse (a vertex moves onto a
+neighbour, no new vertices), so:
+	- vertices split by uv or normal (seams) only move along the seam
+	  and together with their twin, the seam stays closed
+	- open borders only move along the border
+	- vertices between submeshes and non manifold ones never move
+
+At runtime lod_mesh selects the level with the projected size on
+screen: the coarsest level whose error is under max_pixel_error pixels,
+with hysteresis so it does not flicker at the threshold.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "Bounds.h"
+#include "MeshImporter.h"
+
+namespace dune {
+
+struct lod_options
+{
+	// niveles ademas del 0
+	unsigned int levels = 3;
+	// indices de cada nivel respecto al anterior
+	float ratio = 0.5f;
+	// error maximo de un nivel, relativo al radio de la malla
+	float max_error = 0.05f;
+};
+
+namespace mesh {
+
+// forma cuadratica simetrica 4x4 (10 coeficientes) + peso acumulado
+struct quadric
+{
+	double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+	double weight;
+
+	static quadric zero()
+	{
+		quadric q;
+		q.a00 = q.a01 = q.a02 = q.a03 = q.a11 = q.a12 = q.a13 = q.a22 = q.a23 = q.a33 = 0.0;
+		q.weight = 0.0;
+		return q;
+	}
+
+	// plano n.p + d = 0 (n unitario)
+	static quadric plane(double a, double b, double c, double d, double w)
+	{
+		quadric q;
+		q.a00 = w * a * a; q.a01 = w * a * b; q.a02 = w * a * c; q.a03 = w * a * d;
+		q.a11 = w * b * b; q.a12 = w * b * c; q.a13 = w * b * d;
+		q.a22 = w * c * c; q.a23 = w * c * d;
+		q.a33 = w * d * d;
+		q.weight = w;
+		return q;
+	}
+
+	void add(const quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		weight += q.weight;
+	}
+
+	// suma ponderada de distancias al cuadrado
+	double evaluate(const float* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+			+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+			+ a22 * z * z + 2.0 * a23 * z
+			+ a33;
+	}
+};
+
+inline void triangle_normal(const float* a, const float* b, const float* c, double* n)
+{
+	double u[3] = {(double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2]};
+	double v[3] = {(double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2]};
+	n[0] = u[1] * v[2] - u[2] * v[1];
+	n[1] = u[2] * v[0] - u[0] * v[2];
+	n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+inline uint64_t edge_key(GLuint a, GLuint b)
+{
+	return ((uint64_t)a << 32) | b;
+}
+
+/*
+Simplifies the triangles (indexes, one group per triangle) until
+target_index_count or until a collapse would be over max_error (model
+units). Writes the triangles that remain with their group and returns
+the error reached.
+*/
+template <typename V>
+float simplify(const std::vector<V>& vertices, const std::vector<GLuint>& indexes, const std::vector<unsigned int>& groups,
+			   size_t target_index_count, float max_error, std::vector<GLuint>& out_indexes, std::vector<unsigned int>& out_groups)
+{
+	enum vertex_kind { kind_manifold, kind_border, kind_seam, kind_locked };
+	const GLuint none = std::numeric_limits<GLuint>::max();
+	const size_t vertex_count = vertices.size();
+
+	// vertices en la misma posicion: el primero es el canonico
+	std::vector<GLuint> canonical(vertex_count);
+	{
+		std::unordered_map<uint64_t, std::vector<GLuint> > by_position;
+		for (GLuint v = 0; v < vertex_count; ++v)
+		{
+			const float* p = vertices[v].position;
+			// por valor: -0 y 0 son la misma posicion
+			float key[3] = {p[0] + 0.0f, p[1] + 0.0f, p[2] + 0.0f};
+			uint64_t h = hash_bytes(key, sizeof(key));
+			std::vector<GLuint>& bucket = by_position[h];
+			canonical[v] = v;
+			for (GLuint other : bucket)
+			{
+				const float* q = vertices[other].position;
+				if (q[0] == p[0] && q[1] == p[1] && q[2] == p[2])
+				{
+					canonical[v] = other;
+					break;
+				}
+			}
+			if (canonical[v] == v)
+				bucket.push_back(v);
+		}
+	}
+	auto position = [&](GLuint v) -> const float* { return vertices[v].position; };
+
+	std::vector<GLuint> tris(indexes);
+	std::vector<unsigned int> tri_groups(groups);
+
+	// error por posicion: planos de los triangulos (por area)
+	std::vector<quadric> quadrics(vertex_count, quadric::zero());
+	for (size_t t = 0; t < tris.size(); t += 3)
+	{
+		double n[3];
+		triangle_normal(position(tris[t]), position(tris[t + 1]), position(tris[t + 2]), n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		const float* p = position(tris[t]);
+		quadric q = quadric::plane(n[0], n[1], n[2], -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]), length * 0.5);
+		for (int k = 0; k < 3; ++k)
+			quadrics[canonical[tris[t + k]]].add(q);
+	}
+
+	std::vector<uint8_t> kind(vertex_count);
+	std::vector<GLuint> open_target(vertex_count);
+	std::vector<GLuint> open_source(vertex_count);
+	std::vector<GLuint> open_out(vertex_count);
+	std::vector<GLuint> open_in(vertex_count);
+	std::vector<uint8_t> open_seam(vertex_count);
+	std::vector<GLuint> wedge_count(vertex_count);
+	std::vector<GLuint> collapse_to(vertex_count);
+	std::vector<uint8_t> locked(vertex_count);
+	std::vector<GLuint> adjacency_offset(vertex_count + 1);
+	std::vector<GLuint> adjacency;
+	bool edge_quadrics = false;
+	float error = 0.0f;
+
+	struct candidate
+	{
+		GLuint from;
+		GLuint to;
+		float error;
+	};
+	std::vector<candidate> candidates;
+	std::vector<GLuint> ring;
+
+	while (tris.size() > target_index_count)
+	{
+		const size_t triangles = tris.size() / 3;
+
+		// aristas dirigidas: interior si la inversa existe en el mismo grupo
+		std::unordered_map<uint64_t, unsigned int> directed;
+		std::unordered_set<uint64_t> directed_canonical;
+		std::fill(locked.begin(), locked.end(), 0);
+		for (size_t t = 0; t < triangles; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				GLuint a = tris[t * 3 + k];
+				GLuint b = tris[t * 3 + (k + 1) % 3];
+				auto inserted = directed.insert(std::make_pair(edge_key(a, b), tri_groups[t]));
+				if (!inserted.second)
+				{
+					// arista repetida: no manifold
+					locked[canonical[a]] = locked[canonical[b]] = 1;
+				}
+				directed_canonical.insert(edge_key(canonical[a], canonical[b]));
+			}
+		}
+
+		std::fill(open_out.begin(), open_out.end(), 0);
+		std::fill(open_in.begin(), open_in.end(), 0);
+		std::fill(open_seam.begin(), open_seam.end(), 1);
+		std::fill(wedge_count.begin(), wedge_count.end(), 0);
+		std::vector<uint8_t> live(vertex_count, 0);
+		for (size_t t = 0; t < triangles; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				GLuint a = tris[t * 3 + k];
+				GLuint b = tris[t * 3 + (k + 1) % 3];
+				if (!live[a])
+				{
+					live[a] = 1;
+					++wedge_count[canonical[a]];
+				}
+				auto reverse = directed.find(edge_key(b, a));
+				if (reverse != directed.end() && reverse->second == tri_groups[t])
+					continue;
+				bool seam = directed_canonical.count(edge_key(canonical[b], canonical[a])) > 0;
+				// la inversa con los mismos vertices en otro grupo: limite entre submeshes
+				if (reverse != directed.end())
+					locked[canonical[a]] = locked[canonical[b]] = 1;
+				++open_out[a];
+				++open_in[b];
+				open_target[a] = b;
+				open_source[b] = a;
+				open_seam[a] &= seam ? 1 : 0;
+				open_seam[b] &= seam ? 1 : 0;
+
+				if (!edge_quadrics)
+				{
+					// borde o costura: plano perpendicular al triangulo por la arista, con mucho peso
+					double n[3];
+					triangle_normal(position(tris[t * 3]), position(tris[t * 3 + 1]), position(tris[t * 3 + 2]), n);
+					const float* pa = position(a);
+					const float* pb = position(b);
+					double e[3] = {(double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2]};
+					double length2 = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+					double m[3] = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0]};
+					double length = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+					if (length > 0.0)
+					{
+						m[0] /= length; m[1] /= length; m[2] /= length;
+						quadric q = quadric::plane(m[0], m[1], m[2], -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]), length2 * 10.0);
+						quadrics[canonical[a]].add(q);
+						quadrics[canonical[b]].add(q);
+					}
+				}
+			}
+		}
+		edge_quadrics = true;
+
+		// clasificacion por posicion
+		for (GLuint v = 0; v < vertex_count; ++v)
+			kind[v] = kind_manifold;
+		for (GLuint v = 0; v < vertex_count; ++v)
+		{
+			if (!live[v])
+				continue;
+			GLuint c = canonical[v];
+			bool open = open_out[v] || open_in[v];
+			bool single = open_out[v] == 1 && open_in[v] == 1;
+			if (locked[c])
+				kind[c] = kind_locked;
+			else if (wedge_count[c] == 1)
+				kind[c] = !open ? kind_manifold : (single && !open_seam[v]) ? kind_border : kind_locked;
+			else if (wedge_count[c] == 2 && single && open_seam[v])
+			{
+				if (kind[c] != kind_locked)
+					kind[c] = kind_seam;
+			}
+			else
+				kind[c] = kind_locked;
+		}
+
+		// triangulos alrededor de cada posicion
+		std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+		for (GLuint index : tris)
+			++adjacency_offset[canonical[index] + 1];
+		for (size_t v = 0; v < vertex_count; ++v)
+			adjacency_offset[v + 1] += adjacency_offset[v];
+		adjacency.resize(tris.size());
+		{
+			std::vector<GLuint> cursor(adjacency_offset.begin(), adjacency_offset.end() - 1);
+			for (size_t t = 0; t < triangles; ++t)
+			{
+				for (int k = 0; k < 3; ++k)
+					adjacency[cursor[canonical[tris[t * 3 + k]]]++] = (GLuint)t;
+			}
+		}
+
+		// candidatos: cada arista en los dos sentidos
+		candidates.clear();
+		for (size_t t = 0; t < triangles; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				for (int direction = 0; direction < 2; ++direction)
+				{
+					GLuint a = tris[t * 3 + (direction ? (k + 1) % 3 : k)];
+					GLuint b = tris[t * 3 + (direction ? k : (k + 1) % 3)];
+					GLuint ca = canonical[a];
+					GLuint cb = canonical[b];
+					if (ca == cb)
+						continue;
+					bool valid;
+					switch (kind[ca])
+					{
+					case kind_manifold:
+						valid = true;
+						break;
+					case kind_border:
+					case kind_seam:
+						// solo a lo largo del borde / la costura
+						valid = (open_out[a] && open_target[a] == b) || (open_in[a] && open_source[a] == b);
+						break;
+					default:
+						valid = false;
+						break;
+					}
+					if (!valid)
+						continue;
+					quadric q = quadrics[ca];
+					q.add(quadrics[cb]);
+					double cost = std::max(0.0, q.evaluate(position(cb))) / std::max(q.weight, 1e-12);
+					candidates.push_back(candidate{a, b, (float)std::sqrt(cost)});
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const candidate& x, const candidate& y) { return x.error < y.error; });
+
+		for (GLuint v = 0; v < vertex_count; ++v)
+			collapse_to[v] = v;
+		std::fill(locked.begin(), locked.end(), 0);
+		size_t removed = 0;
+		size_t goal = (tris.size() - target_index_count) / 3;
+		size_t collapses = 0;
+		for (const candidate& c : candidates)
+		{
+			if (removed >= goal || c.error > max_error)
+				break;
+			GLuint ca = canonical[c.from];
+			GLuint cb = canonical[c.to];
+			if (locked[ca] || locked[cb])
+				continue;
+
+			// la nueva posicion no puede dar la vuelta a ningun triangulo
+			bool flip = false;
+			size_t dying = 0;
+			for (GLuint i = adjacency_offset[ca]; i < adjacency_offset[ca + 1] && !flip; ++i)
+			{
+				const GLuint* tri = &tris[adjacency[i] * 3];
+				if (canonical[tri[0]] == cb || canonical[tri[1]] == cb || canonical[tri[2]] == cb)
+				{
+					++dying;
+					continue;
+				}
+				const float* p[3];
+				const float* q[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					p[k] = position(tri[k]);
+					q[k] = (canonical[tri[k]] == ca) ? position(cb) : p[k];
+				}
+				double before[3], after[3];
+				triangle_normal(p[0], p[1], p[2], before);
+				triangle_normal(q[0], q[1], q[2], after);
+				double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				flip = dot <= 0.0;
+			}
+			if (flip)
+				continue;
+
+			// condicion de enlace: solo pueden compartir vecinos los opuestos a la arista
+			ring.clear();
+			for (GLuint i = adjacency_offset[ca]; i < adjacency_offset[ca + 1]; ++i)
+			{
+				const GLuint* tri = &tris[adjacency[i] * 3];
+				for (int k = 0; k < 3; ++k)
+				{
+					GLuint n = canonical[tri[k]];
+					if (n != ca && n != cb)
+						ring.push_back(n);
+				}
+			}
+			std::sort(ring.begin(), ring.end());
+			ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+			size_t shared = 0;
+			for (GLuint n : ring)
+			{
+				for (GLuint i = adjacency_offset[cb]; i < adjacency_offset[cb + 1]; ++i)
+				{
+					const GLuint* tri = &tris[adjacency[i] * 3];
+					if (canonical[tri[0]] == n || canonical[tri[1]] == n || canonical[tri[2]] == n)
+					{
+						++shared;
+						break;
+					}
+				}
+			}
+			if (shared > dying)
+				continue;
+
+			// cada gemelo de la costura va a su gemelo en el destino
+			GLuint targets[2] = {none, none};
+			GLuint sources[2] = {c.from, none};
+			targets[0] = c.to;
+			if (kind[ca] == kind_seam)
+			{
+				for (GLuint i = adjacency_offset[ca]; i < adjacency_offset[ca + 1]; ++i)
+				{
+					const GLuint* tri = &tris[adjacency[i] * 3];
+					for (int k = 0; k < 3; ++k)
+					{
+						if (canonical[tri[k]] == ca && tri[k] != c.from)
+						{
+							sources[1] = tri[k];
+							for (int j = 0; j < 3; ++j)
+							{
+								if (canonical[tri[j]] == cb)
+									targets[1] = tri[j];
+							}
+						}
+					}
+					if (targets[1] != none)
+						break;
+				}
+				// los dos al mismo vertice: la costura se cierra ahi
+				if (targets[1] == none)
+					continue;
+			}
+
+			for (int w = 0; w < 2; ++w)
+			{
+				if (sources[w] != none)
+					collapse_to[sources[w]] = targets[w];
+			}
+			quadrics[cb].add(quadrics[ca]);
+			for (GLuint i = adjacency_offset[ca]; i < adjacency_offset[ca + 1]; ++i)
+			{
+				const GLuint* tri = &tris[adjacency[i] * 3];
+				for (int k = 0; k < 3; ++k)
+					locked[canonical[tri[k]]] = 1;
+			}
+			removed += dying;
+			error = std::max(error, c.error);
+			++collapses;
+		}
+		if (!collapses)
+			break;
+
+		// aplica y quita los triangulos degenerados
+		size_t write = 0;
+		for (size_t t = 0; t < triangles; ++t)
+		{
+			GLuint a = collapse_to[tris[t * 3]];
+			GLuint b = collapse_to[tris[t * 3 + 1]];
+			GLuint c = collapse_to[tris[t * 3 + 2]];
+			if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+				continue;
+			tris[write * 3] = a;
+			tris[write * 3 + 1] = b;
+			tris[write * 3 + 2] = c;
+			tri_groups[write] = tri_groups[t];
+			++write;
+		}
+		tris.resize(write * 3);
+		tri_groups.resize(write);
+	}
+
+	out_indexes.swap(tris);
+	out_groups.swap(tri_groups);
+	return error;
+}
+
+/*
+Appends up to options.levels simplified levels to the mesh (offline or
+in a worker: no GL). Each level simplifies the previous one as a whole,
+so submeshes stay closed between them; its triangles are split again
+per submesh and optimized for the vertex cache.
+*/
+template <typename V>
+void generate_lods(mesh_data<V>& mesh, const lod_options& options = lod_options())
+{
+	// se regenera desde el nivel 0
+	size_t submesh_count = mesh.lods.size() > 1 ? mesh.lods[1].first_submesh : mesh.submeshes.size();
+	mesh.submeshes.resize(submesh_count);
+	mesh.lods.assign(1, mesh_lod{0, 0.0f});
+
+	std::vector<GLuint> indexes;
+	if (mesh.index_type == GL_UNSIGNED_SHORT)
+		indexes.assign(mesh.indexes16.begin(), mesh.indexes16.end());
+	else
+		indexes.swap(mesh.indexes);
+
+	std::vector<GLuint> level;
+	std::vector<unsigned int> groups;
+	for (unsigned int s = 0; s < submesh_count; ++s)
+	{
+		submesh& sub = mesh.submeshes[s];
+		unsigned int first = (unsigned int)level.size();
+		level.insert(level.end(), indexes.begin() + sub.first_index, indexes.begin() + sub.first_index + sub.index_count);
+		groups.insert(groups.end(), sub.index_count / 3, s);
+		sub.first_index = first;
+	}
+	indexes = level;
+
+	float radius = sphere::from(compute_aabb(mesh.vertices.data(), mesh.vertices.size())).radius;
+	float max_error = options.max_error * radius;
+	float error = 0.0f;
+	std::vector<GLuint> simplified;
+	std::vector<unsigned int> simplified_groups;
+	for (unsigned int l = 1; l <= options.levels; ++l)
+	{
+		size_t target = (size_t)(level.size() * options.ratio) / 3 * 3;
+		float level_error = simplify(mesh.vertices, level, groups, target, max_error, simplified, simplified_groups);
+		// sin avance apreciable: no merece otro nivel
+		if (simplified.empty() || simplified.size() > level.size() * 9 / 10)
+			break;
+		error = std::max(error, level_error);
+
+		mesh.lods.push_back(mesh_lod{(unsigned int)mesh.submeshes.size(), error});
+		level.clear();
+		groups.clear();
+		for (unsigned int s = 0; s < submesh_count; ++s)
+		{
+			size_t first = indexes.size();
+			for (size_t t = 0; t < simplified_groups.size(); ++t)
+			{
+				if (simplified_groups[t] != s)
+					continue;
+				indexes.insert(indexes.end(), simplified.begin() + t * 3, simplified.begin() + t * 3 + 3);
+				level.insert(level.end(), simplified.begin() + t * 3, simplified.begin() + t * 3 + 3);
+				groups.push_back(s);
+			}
+			if (indexes.size() > first)
+				optimize_vertex_cache(&indexes[first], indexes.size() - first, mesh.vertices.size());
+			mesh.submeshes.push_back({(unsigned int)first, (unsigned int)(indexes.size() - first)});
+		}
+	}
+
+	mesh.indexes.swap(indexes);
+	if (mesh.index_type == GL_UNSIGNED_SHORT)
+		compress_indexes(mesh);
+	LOGI("Mesh LODs: %d levels, max error %f", (int)mesh.lods.size(), error);
+}
+
+} // end namespace mesh
+
+/*
+Diameter in pixels of a sphere seen from eye with a vertical field of
+view fov_y (radians) in a viewport of viewport_height pixels.
+*/
+inline float projected_size(const sphere& bounds, const float eye[3], float fov_y, float viewport_height)
+{
+	float dx = bounds.center[0] - eye[0];
+	float dy = bounds.center[1] - eye[1];
+	float dz = bounds.center[2] - eye[2];
+	float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+	if (distance <= bounds.radius)
+		return std::numeric_limits<float>::max();
+	return bounds.radius / (distance * std::tan(fov_y * 0.5f)) * viewport_height;
+}
+
+/*
+Coarsest level whose error projects under max_pixel_error pixels. Going
+to a coarser level than current needs a margin of hysteresis (0..1),
+going to a finer one is immediate.
+*/
+inline unsigned int select_lod(const mesh_lod* lods, size_t lod_count, float radius, float screen_size,
+							   unsigned int current, float max_pixel_error = 1.0f, float hysteresis = 0.25f)
+{
+	if (lod_count == 0 || radius <= 0.0f)
+		return 0;
+	float pixels_per_unit = screen_size / (2.0f * radius);
+	unsigned int target = 0;
+	// el error crece con el nivel
+	while (target + 1 < lod_count && lods[target + 1].error * pixels_per_unit <= max_pixel_error)
+		++target;
+	while (target > current && lods[target].error * pixels_per_unit > max_pixel_error * (1.0f - hysteresis))
+		--target;
+	return target;
+}
+
+/*
+Mesh with its levels in one StaticGeometryElement. update() picks the
+level for the size on screen, render() only submits its ranges.
+*/
+template <typename V>
+class lod_mesh
+{
+public:
+	lod_mesh(std::unique_ptr<StaticGeometryElement<V> > element, const std::vector<submesh>& submeshes,
+			 const std::vector<mesh_lod>& lods, const sphere& bounds)
+		: _element(std::move(element))
+		, _submeshes(submeshes)
+		, _lods(lods)
+		, _bounds(bounds)
+		, _lod(0)
+		, _max_pixel_error(1.0f)
+		, _hysteresis(0.25f)
+	{
+		if (_lods.empty())
+			_lods.push_back(mesh_lod{0, 0.0f});
+	}
+
+	explicit lod_mesh(const mesh_data<V>& mesh)
+		: lod_mesh(mesh.create_element(), mesh.submeshes, mesh.lods,
+				   sphere::from(compute_aabb(mesh.vertices.data(), mesh.vertices.size())))
+	{
+
+	}
+
+	void set_max_pixel_error(float pixels) { _max_pixel_error = pixels; }
+	void set_hysteresis(float hysteresis) { _hysteresis = hysteresis; }
+
+	// screen_size: projected_size() de bounds() en el mundo
+	unsigned int update(float screen_size)
+	{
+		_lod = select_lod(_lods.data(), _lods.size(), _bounds.radius, screen_size, _lod, _max_pixel_error, _hysteresis);
+		return _lod;
+	}
+
+	void render(GLenum mode = GL_TRIANGLES)
+	{
+		size_t first = _lods[_lod].first_submesh;
+		size_t end = (_lod + 1 < _lods.size()) ? _lods[_lod + 1].first_submesh : _submeshes.size();
+		for (size_t i = first; i < end; ++i)
+		{
+			if (_submeshes[i].index_count)
+				_element->render_range(_submeshes[i].first_index, (GLsizei)_submeshes[i].index_count, mode);
+		}
+	}
+
+	unsigned int lod() const { return _lod; }
+	unsigned int lod_count() const { return (unsigned int)_lods.size(); }
+	const sphere& bounds() const { return _bounds; }
+	StaticGeometryElement<V>& element() { return *_element; }
+
+protected:
+	std::unique_ptr<StaticGeometryElement<V> > _element;
+	std::vector<submesh> _submeshes;
+	std::vector<mesh_lod> _lods;
+	sphere _bounds;
+	unsigned int _lod;
+	float _max_pixel_error;
+	float _hysteresis;
+};
+
+} // end namespace dune
+
+#endif // MESHLOD_H
@@ -0,0 +1,168 @@
+/**
+@file MqttLink.h
+
+Non-blocking MQTT connection shared by telemetry and state replication.
+A service thread keeps the connection alive (reconnects and restores
+the subscriptions); publish() never waits, it drops the message when
+there is no connection or too many publications in flight.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef MQTTLINK_H
+#define MQTTLINK_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <mqtt/async_client.h>
+
+namespace dune {
+
+class mqtt_link : public mqtt::callback
+{
+public:
+	// topic, payload; se llama desde el hilo de paho
+	typedef std::function<void(const std::string&, const std::string&)> message_handler;
+
+	mqtt_link(const std::string& server, const std::string& client_id, size_t max_in_flight = 4)
+		: _client(server, client_id)
+		, _max_in_flight(max_in_flight)
+		, _stop(false)
+		, _connected(false)
+	{
+		_client.set_callback(*this);
+		_service = std::thread([this]() { service(); });
+	}
+
+	virtual ~mqtt_link()
+	{
+		_stop.store(true, std::memory_order_release);
+		_service.join();
+		try
+		{
+			if (_client.is_connected())
+				_client.disconnect()->wait_for(1000);
+		}
+		catch (const mqtt::exception&)
+		{
+			;
+		}
+	}
+
+	mqtt_link(const mqtt_link&) = delete;
+	mqtt_link& operator=(const mqtt_link&) = delete;
+
+	// antes de subscribe: el handler no se protege
+	void set_handler(const message_handler& handler)
+	{
+		_handler = handler;
+	}
+
+	// se repite en cada reconexion
+	void subscribe(const std::string& topic, int qos = 0)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_subscriptions.emplace_back(topic, qos);
+		if (_connected)
+			subscribe_now(topic, qos);
+	}
+
+	// false si se ha descartado
+	bool publish(const std::string& topic, const void* data, size_t size, int qos = 0)
+	{
+		try
+		{
+			if (!_client.is_connected() || _client.get_pending_delivery_tokens().size() >= _max_in_flight)
+				return false;
+			_client.publish(topic, data, size, qos, false);
+			return true;
+		}
+		catch (const mqtt::exception&)
+		{
+			return false;
+		}
+	}
+
+	bool is_connected() const { return _client.is_connected(); }
+
+protected:
+	void message_arrived(mqtt::const_message_ptr msg) override
+	{
+		if (_handler)
+			_handler(msg->get_topic(), msg->get_payload_str());
+	}
+
+	void service()
+	{
+		auto next_connect = std::chrono::steady_clock::now();
+		while (!_stop.load(std::memory_order_acquire))
+		{
+			bool connected = _client.is_connected();
+			if (connected && !_connected)
+			{
+				// conexion nueva: restaura las suscripciones
+				std::lock_guard<std::mutex> lock(_mutex);
+				_connected = true;
+				for (auto& s : _subscriptions)
+					subscribe_now(s.first, s.second);
+			}
+			else if (!connected)
+			{
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_connected = false;
+				}
+				auto now = std::chrono::steady_clock::now();
+				if (now >= next_connect)
+				{
+					// reintento sin bloquear: el resultado se ve en is_connected()
+					next_connect = now + std::chrono::seconds(2);
+					try
+					{
+						mqtt::connect_options options;
+						options.set_keep_alive_interval(20);
+						options.set_clean_session(true);
+						_client.connect(options);
+					}
+					catch (const mqtt::exception&)
+					{
+						;
+					}
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+
+	void subscribe_now(const std::string& topic, int qos)
+	{
+		try
+		{
+			_client.subscribe(topic, qos);
+		}
+		catch (const mqtt::exception&)
+		{
+			;
+		}
+	}
+
+protected:
+	mqtt::async_client _client;
+	size_t _max_in_flight;
+	message_handler _handler;
+	std::mutex _mutex;
+	std::vector<std::pair<std::string, int> > _subscriptions;
+	std::atomic<bool> _stop;
+	bool _connected;
+	std::thread _service;
+};
+
+} // end namespace dune
+
+#endif // MQTTLINK_H
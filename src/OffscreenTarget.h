@@ -0,0 +1,67 @@
+/**
+@file OffscreenTarget.h
+
+FBO with color (RGBA8) and depth (24 bits) used as backbuffer when
+there is no visible window (headless mode).
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef OFFSCREENTARGET_H
+#define OFFSCREENTARGET_H
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+namespace dune {
+
+class offscreen_target
+{
+public:
+	offscreen_target(GLsizei width, GLsizei height)
+		: _width(width)
+		, _height(height)
+	{
+		glGenFramebuffers(1, &_fbo);
+		glGenRenderbuffers(2, _renderbuffers);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _renderbuffers[1]);
+		_complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	~offscreen_target()
+	{
+		glDeleteFramebuffers(1, &_fbo);
+		glDeleteRenderbuffers(2, _renderbuffers);
+	}
+
+	offscreen_target(const offscreen_target&) = delete;
+	offscreen_target& operator=(const offscreen_target&) = delete;
+
+	GLuint fbo() const { return _fbo; }
+	GLsizei width() const { return _width; }
+	GLsizei height() const { return _height; }
+	bool is_complete() const { return _complete; }
+
+protected:
+	GLuint _fbo;
+	// color, depth
+	GLuint _renderbuffers[2];
+	GLsizei _width;
+	GLsizei _height;
+	bool _complete;
+};
+
+} // end namespace dune
+
+#endif // OFFSCREENTARGET_H
@@ -0,0 +1,691 @@
+/**
+@file RenderGraph.h
+
+Render graph: passes declare which resources (FBO attachments, buffers)
+read and write. compile() culls passes that do not contribute to an
+imported resource, orders passes by dependencies and aliases transient
+resources whose lifetimes do not overlap. execute() only changes
+framebuffer / viewport when the next pass needs it.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+namespace dune {
+
+struct resource_handle
+{
+	int id = -1;
+
+	bool valid() const { return id >= 0; }
+	bool operator==(const resource_handle& other) const { return id == other.id; }
+};
+
+struct texture_desc
+{
+	GLsizei width;
+	GLsizei height;
+	// GL_RGBA8, GL_RGBA16F, GL_DEPTH_COMPONENT24 ...
+	GLenum internal_format;
+
+	bool operator==(const texture_desc& other) const
+	{
+		return width == other.width && height == other.height && internal_format == other.internal_format;
+	}
+
+	bool is_depth() const
+	{
+		return internal_format == GL_DEPTH_COMPONENT16 || internal_format == GL_DEPTH_COMPONENT24 ||
+			   internal_format == GL_DEPTH_COMPONENT32F || internal_format == GL_DEPTH24_STENCIL8;
+	}
+
+	size_t bytes() const
+	{
+		size_t texel = 4;
+		if (internal_format == GL_RGBA16F || internal_format == GL_RG32F)
+			texel = 8;
+		else if (internal_format == GL_RGBA32F)
+			texel = 16;
+		return (size_t)width * height * texel;
+	}
+};
+
+class render_graph;
+
+struct pass_context
+{
+	render_graph& graph;
+	GLsizei width;
+	GLsizei height;
+
+	// nombre GL del recurso fisico (textura o buffer)
+	GLuint get(resource_handle handle) const;
+};
+
+class pass_builder
+{
+public:
+	pass_builder(render_graph& graph, int pass)
+		: _graph(graph)
+		, _pass(pass)
+	{
+
+	}
+
+	resource_handle create_texture(const std::string& name, const texture_desc& desc);
+	resource_handle create_buffer(const std::string& name, GLsizeiptr size);
+	void read(resource_handle handle);
+	void write(resource_handle handle);
+	void clear(float r, float g, float b, float a, bool depth = true);
+	// no se elimina aunque nadie lea lo que escribe
+	void side_effect();
+
+protected:
+	render_graph& _graph;
+	int _pass;
+};
+
+class render_graph
+{
+public:
+	typedef std::function<void(pass_builder&)> setup_func;
+	typedef std::function<void(const pass_context&)> execute_func;
+
+	render_graph()
+		: _compiled(false)
+	{
+		invalidate_state();
+	}
+
+	~render_graph()
+	{
+		release_physical();
+	}
+
+	render_graph(const render_graph&) = delete;
+	render_graph& operator=(const render_graph&) = delete;
+
+	// framebuffer por defecto de la ventana (o un FBO offscreen en headless)
+	resource_handle import_backbuffer(GLsizei width, GLsizei height, GLuint fbo = 0)
+	{
+		resource r;
+		r.name = "backbuffer";
+		r.kind = kind_texture;
+		r.desc = texture_desc{width, height, GL_RGBA8};
+		r.imported = true;
+		r.backbuffer = true;
+		r.gl_name = fbo;
+		_backbuffer_fbo = fbo;
+		return add_resource(r);
+	}
+
+	resource_handle import_texture(const std::string& name, GLuint texture, const texture_desc& desc)
+	{
+		resource r;
+		r.name = name;
+		r.kind = kind_texture;
+		r.desc = desc;
+		r.imported = true;
+		r.gl_name = texture;
+		return add_resource(r);
+	}
+
+	resource_handle import_buffer(const std::string& name, GLuint buffer)
+	{
+		resource r;
+		r.name = name;
+		r.kind = kind_buffer;
+		r.imported = true;
+		r.gl_name = buffer;
+		return add_resource(r);
+	}
+
+	void add_pass(const std::string& name, const setup_func& setup, const execute_func& execute)
+	{
+		pass p;
+		p.name = name;
+		p.execute = execute;
+		_passes.push_back(p);
+		_compiled = false;
+		pass_builder builder(*this, (int)_passes.size() - 1);
+		setup(builder);
+	}
+
+	/*
+	Removes passes and resources declared (physical resources and FBOs
+	are kept in the pool for the next frame).
+	*/
+	void reset()
+	{
+		_passes.clear();
+		_resources.clear();
+		_order.clear();
+		_compiled = false;
+	}
+
+	void compile()
+	{
+		cull_passes();
+		sort_passes();
+		compute_lifetimes();
+		assign_physical();
+		_compiled = true;
+	}
+
+	void execute()
+	{
+		if (!_compiled)
+			compile();
+
+		// entre frames otro codigo puede haber tocado el estado GL
+		invalidate_state();
+		for (int index : _order)
+		{
+			pass& p = _passes[index];
+			bind_targets(p);
+			if (p.clear)
+			{
+				glClearColor(p.clear_color[0], p.clear_color[1], p.clear_color[2], p.clear_color[3]);
+				glClear(GL_COLOR_BUFFER_BIT | (p.clear_depth ? GL_DEPTH_BUFFER_BIT : 0));
+			}
+			if (p.execute)
+				p.execute(pass_context{*this, _bound_viewport[0], _bound_viewport[1]});
+		}
+	}
+
+	GLuint get(resource_handle handle) const
+	{
+		const resource& r = _resources[handle.id];
+		if (r.imported)
+			return r.gl_name;
+		return (r.kind == kind_texture) ? _textures[r.physical].gl_name : _buffers[r.physical].gl_name;
+	}
+
+	// passes vivos en orden de ejecucion
+	std::vector<std::string> execution_order() const
+	{
+		std::vector<std::string> names;
+		for (int index : _order)
+			names.push_back(_passes[index].name);
+		return names;
+	}
+
+	// VRAM de transitorios con aliasing / sin aliasing
+	size_t transient_bytes() const
+	{
+		size_t total = 0;
+		for (const physical_texture& t : _textures)
+			total += t.desc.bytes();
+		for (const physical_buffer& b : _buffers)
+			total += (size_t)b.size;
+		return total;
+	}
+
+	size_t transient_bytes_without_aliasing() const
+	{
+		size_t total = 0;
+		for (const resource& r : _resources)
+		{
+			if (r.imported || r.first_use < 0)
+				continue;
+			total += (r.kind == kind_texture) ? r.desc.bytes() : (size_t)r.size;
+		}
+		return total;
+	}
+
+protected:
+	friend class pass_builder;
+
+	enum resource_kind
+	{
+		kind_texture,
+		kind_buffer
+	};
+
+	struct resource
+	{
+		std::string name;
+		resource_kind kind = kind_texture;
+		texture_desc desc{0, 0, GL_RGBA8};
+		GLsizeiptr size = 0;
+		bool imported = false;
+		bool backbuffer = false;
+		GLuint gl_name = 0;
+		int producer = -1;
+		int readers = 0;
+		int first_use = -1;
+		int last_use = -1;
+		int physical = -1;
+	};
+
+	struct pass
+	{
+		std::string name;
+		execute_func execute;
+		std::vector<int> reads;
+		std::vector<int> writes;
+		bool side_effect = false;
+		bool clear = false;
+		bool clear_depth = true;
+		float clear_color[4] = {0, 0, 0, 1};
+		int refcount = 0;
+		bool culled = false;
+	};
+
+	struct physical_texture
+	{
+		texture_desc desc;
+		GLuint gl_name;
+		int free_after;  // ultimo pass (en orden) que lo usa
+	};
+
+	struct physical_buffer
+	{
+		GLsizeiptr size;
+		GLuint gl_name;
+		int free_after;
+	};
+
+	struct framebuffer
+	{
+		std::vector<GLuint> colors;
+		GLuint depth;
+		GLuint gl_name;
+	};
+
+	resource_handle add_resource(const resource& r)
+	{
+		_resources.push_back(r);
+		_compiled = false;
+		resource_handle handle;
+		handle.id = (int)_resources.size() - 1;
+		return handle;
+	}
+
+	void cull_passes()
+	{
+		for (resource& r : _resources)
+			r.readers = 0;
+		for (pass& p : _passes)
+		{
+			p.culled = false;
+			p.refcount = (int)p.writes.size();
+			for (int read : p.reads)
+				++_resources[read].readers;
+		}
+
+		// recursos que nadie lee (y no importados) van liberando a su productor
+		std::vector<int> unreferenced;
+		for (int i = 0; i < (int)_resources.size(); ++i)
+			if (_resources[i].readers == 0 && !_resources[i].imported)
+				unreferenced.push_back(i);
+
+		while (!unreferenced.empty())
+		{
+			int index = unreferenced.back();
+			unreferenced.pop_back();
+			int producer = _resources[index].producer;
+			if (producer < 0)
+				continue;
+			pass& p = _passes[producer];
+			if (p.side_effect || p.culled)
+				continue;
+			if (--p.refcount == 0)
+			{
+				p.culled = true;
+				for (int read : p.reads)
+					if (--_resources[read].readers == 0 && !_resources[read].imported)
+						unreferenced.push_back(read);
+			}
+		}
+	}
+
+	void sort_passes()
+	{
+		// aristas: ultimo escritor previo -> lector/escritor (orden de declaracion para WAW)
+		// y lectores desde la ultima escritura -> siguiente escritor (WAR)
+		const int n = (int)_passes.size();
+		std::vector<std::vector<int> > edges(n);
+		std::vector<int> indegree(n, 0);
+		std::vector<int> last_writer(_resources.size(), -1);
+		std::vector<std::vector<int> > readers(_resources.size());
+		for (int i = 0; i < n; ++i)
+		{
+			if (_passes[i].culled)
+				continue;
+			for (int read : _passes[i].reads)
+			{
+				if (last_writer[read] >= 0)
+				{
+					edges[last_writer[read]].push_back(i);
+					++indegree[i];
+				}
+				readers[read].push_back(i);
+			}
+			for (int write : _passes[i].writes)
+			{
+				if (last_writer[write] >= 0)
+				{
+					edges[last_writer[write]].push_back(i);
+					++indegree[i];
+				}
+				for (int reader : readers[write])
+				{
+					if (reader == i)
+						continue;
+					edges[reader].push_back(i);
+					++indegree[i];
+				}
+				readers[write].clear();
+				last_writer[write] = i;
+			}
+		}
+
+		// Kahn; entre candidatos se prefiere el que reutiliza el mismo target (menos cambios de FBO)
+		_order.clear();
+		std::vector<int> ready;
+		for (int i = 0; i < n; ++i)
+			if (!_passes[i].culled && indegree[i] == 0)
+				ready.push_back(i);
+		while (!ready.empty())
+		{
+			size_t pick = 0;
+			if (!_order.empty())
+			{
+				const pass& prev = _passes[_order.back()];
+				for (size_t k = 0; k < ready.size(); ++k)
+					if (_passes[ready[k]].writes == prev.writes) { pick = k; break; }
+				if (_passes[ready[pick]].writes != prev.writes)
+					pick = std::min_element(ready.begin(), ready.end()) - ready.begin();
+			}
+			else
+			{
+				pick = std::min_element(ready.begin(), ready.end()) - ready.begin();
+			}
+			int current = ready[pick];
+			ready.erase(ready.begin() + pick);
+			_order.push_back(current);
+			for (int next : edges[current])
+				if (--indegree[next] == 0)
+					ready.push_back(next);
+		}
+	}
+
+	void compute_lifetimes()
+	{
+		for (resource& r : _resources)
+			r.first_use = r.last_use = -1;
+		for (int position = 0; position < (int)_order.size(); ++position)
+		{
+			const pass& p = _passes[_order[position]];
+			auto touch = [&](int index) {
+				resource& r = _resources[index];
+				if (r.first_use < 0)
+					r.first_use = position;
+				r.last_use = position;
+			};
+			for (int read : p.reads) touch(read);
+			for (int write : p.writes) touch(write);
+		}
+	}
+
+	void assign_physical()
+	{
+		for (physical_texture& t : _textures) t.free_after = -1;
+		for (physical_buffer& b : _buffers) b.free_after = -1;
+
+		// por orden de primer uso
+		std::vector<int> transients;
+		for (int i = 0; i < (int)_resources.size(); ++i)
+		{
+			_resources[i].physical = -1;
+			if (!_resources[i].imported && _resources[i].first_use >= 0)
+				transients.push_back(i);
+		}
+		std::sort(transients.begin(), transients.end(), [&](int a, int b) {
+			return _resources[a].first_use < _resources[b].first_use;
+		});
+
+		for (int index : transients)
+		{
+			resource& r = _resources[index];
+			if (r.kind == kind_texture)
+			{
+				for (int t = 0; t < (int)_textures.size(); ++t)
+				{
+					if (_textures[t].desc == r.desc && _textures[t].free_after < r.first_use)
+					{
+						r.physical = t;
+						break;
+					}
+				}
+				if (r.physical < 0)
+				{
+					physical_texture t;
+					t.desc = r.desc;
+					t.gl_name = create_texture(r.desc);
+					_textures.push_back(t);
+					r.physical = (int)_textures.size() - 1;
+				}
+				_textures[r.physical].free_after = r.last_use;
+			}
+			else
+			{
+				for (int b = 0; b < (int)_buffers.size(); ++b)
+				{
+					if (_buffers[b].size >= r.size && _buffers[b].free_after < r.first_use)
+					{
+						r.physical = b;
+						break;
+					}
+				}
+				if (r.physical < 0)
+				{
+					physical_buffer b;
+					b.size = r.size;
+					glGenBuffers(1, &b.gl_name);
+					glBindBuffer(GL_ARRAY_BUFFER, b.gl_name);
+					glBufferData(GL_ARRAY_BUFFER, r.size, NULL, GL_DYNAMIC_DRAW);
+					glBindBuffer(GL_ARRAY_BUFFER, 0);
+					_buffers.push_back(b);
+					r.physical = (int)_buffers.size() - 1;
+				}
+				_buffers[r.physical].free_after = r.last_use;
+			}
+		}
+	}
+
+	static GLuint create_texture(const texture_desc& desc)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		GLenum format = desc.is_depth() ? GL_DEPTH_COMPONENT : GL_RGBA;
+		GLenum type = desc.is_depth() ? GL_UNSIGNED_INT : GL_UNSIGNED_BYTE;
+		if (desc.internal_format == GL_DEPTH24_STENCIL8)
+		{
+			format = GL_DEPTH_STENCIL;
+			type = GL_UNSIGNED_INT_24_8;
+		}
+		else if (desc.internal_format == GL_DEPTH_COMPONENT32F)
+			type = GL_FLOAT;
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.internal_format, desc.width, desc.height, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+
+	// FBO cacheado por combinacion de attachments (0 = backbuffer)
+	int framebuffer_for(pass& p, GLsizei& width, GLsizei& height)
+	{
+		std::vector<GLuint> colors;
+		GLuint depth = 0;
+		bool backbuffer = false;
+		width = height = 0;
+		for (int write : p.writes)
+		{
+			const resource& r = _resources[write];
+			if (r.kind != kind_texture)
+				continue;
+			width = r.desc.width;
+			height = r.desc.height;
+			if (r.backbuffer)
+				backbuffer = true;
+			else if (r.desc.is_depth())
+				depth = get(resource_handle{write});
+			else
+				colors.push_back(get(resource_handle{write}));
+		}
+		if (backbuffer || (colors.empty() && depth == 0))
+			return -1;
+
+		for (int i = 0; i < (int)_framebuffers.size(); ++i)
+			if (_framebuffers[i].colors == colors && _framebuffers[i].depth == depth)
+				return i;
+
+		framebuffer fb;
+		fb.colors = colors;
+		fb.depth = depth;
+		glGenFramebuffers(1, &fb.gl_name);
+		glBindFramebuffer(GL_FRAMEBUFFER, fb.gl_name);
+		std::vector<GLenum> buffers;
+		for (size_t c = 0; c < colors.size(); ++c)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)c, GL_TEXTURE_2D, colors[c], 0);
+			buffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)c);
+		}
+		if (depth)
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+		if (buffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers((GLsizei)buffers.size(), buffers.data());
+		_framebuffers.push_back(fb);
+		_bound_fbo = (int)_framebuffers.size() - 1;
+		return _bound_fbo;
+	}
+
+	void bind_targets(pass& p)
+	{
+		GLsizei width, height;
+		int fbo = framebuffer_for(p, width, height);
+		if (width == 0 || height == 0)
+			return;  // pass sin render targets (compute, uploads)
+		if (fbo != _bound_fbo)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo < 0 ? _backbuffer_fbo : _framebuffers[fbo].gl_name);
+			_bound_fbo = fbo;
+		}
+		if (width != _bound_viewport[0] || height != _bound_viewport[1])
+		{
+			glViewport(0, 0, width, height);
+			_bound_viewport[0] = width;
+			_bound_viewport[1] = height;
+		}
+	}
+
+	void invalidate_state()
+	{
+		_bound_fbo = -2;
+		_bound_viewport[0] = _bound_viewport[1] = -1;
+	}
+
+	void release_physical()
+	{
+		for (framebuffer& fb : _framebuffers)
+			glDeleteFramebuffers(1, &fb.gl_name);
+		for (physical_texture& t : _textures)
+			glDeleteTextures(1, &t.gl_name);
+		for (physical_buffer& b : _buffers)
+			glDeleteBuffers(1, &b.gl_name);
+		_framebuffers.clear();
+		_textures.clear();
+		_buffers.clear();
+	}
+
+protected:
+	std::vector<pass> _passes;
+	std::vector<resource> _resources;
+	std::vector<int> _order;
+	std::vector<physical_texture> _textures;
+	std::vector<physical_buffer> _buffers;
+	std::vector<framebuffer> _framebuffers;
+	bool _compiled;
+	GLuint _backbuffer_fbo = 0;
+	// estado GL actual, para no repetir cambios (-1 backbuffer, -2 desconocido)
+	int _bound_fbo;
+	GLsizei _bound_viewport[2];
+};
+
+inline GLuint pass_context::get(resource_handle handle) const
+{
+	return graph.get(handle);
+}
+
+inline resource_handle pass_builder::create_texture(const std::string& name, const texture_desc& desc)
+{
+	render_graph::resource r;
+	r.name = name;
+	r.kind = render_graph::kind_texture;
+	r.desc = desc;
+	r.producer = _pass;
+	resource_handle handle = _graph.add_resource(r);
+	_graph._passes[_pass].writes.push_back(handle.id);
+	return handle;
+}
+
+inline resource_handle pass_builder::create_buffer(const std::string& name, GLsizeiptr size)
+{
+	render_graph::resource r;
+	r.name = name;
+	r.kind = render_graph::kind_buffer;
+	r.size = size;
+	r.producer = _pass;
+	resource_handle handle = _graph.add_resource(r);
+	_graph._passes[_pass].writes.push_back(handle.id);
+	return handle;
+}
+
+inline void pass_builder::read(resource_handle handle)
+{
+	_graph._passes[_pass].reads.push_back(handle.id);
+}
+
+inline void pass_builder::write(resource_handle handle)
+{
+	_graph._passes[_pass].writes.push_back(handle.id);
+	_graph._resources[handle.id].producer = _pass;
+}
+
+inline void pass_builder::clear(float r, float g, float b, float a, bool depth)
+{
+	render_graph::pass& p = _graph._passes[_pass];
+	p.clear = true;
+	p.clear_depth = depth;
+	p.clear_color[0] = r;
+	p.clear_color[1] = g;
+	p.clear_color[2] = b;
+	p.clear_color[3] = a;
+}
+
+inline void pass_builder::side_effect()
+{
+	_graph._passes[_pass].side_effect = true;
+}
+
+} // end namespace dune
+
+#endif // RENDERGRAPH_H
@@ -0,0 +1,50 @@
+/**
+@file RenderStats.h
+
+Per frame counters of draw calls and buffer uploads. Only the render
+thread touches them, the frame loop reads and resets them once per
+frame.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <cstdint>
+
+namespace dune {
+
+struct render_stats
+{
+	uint32_t draw_calls = 0;
+	uint32_t uploads = 0;
+	uint64_t upload_bytes = 0;
+	// indices enviados a dibujar (StaticGeometryElement)
+	uint64_t indexes = 0;
+
+	inline void upload(uint64_t bytes)
+	{
+		++uploads;
+		upload_bytes += bytes;
+	}
+
+	inline void reset()
+	{
+		draw_calls = 0;
+		uploads = 0;
+		upload_bytes = 0;
+		indexes = 0;
+	}
+};
+
+inline render_stats& frame_stats()
+{
+	static render_stats stats;
+	return stats;
+}
+
+} // end namespace dune
+
+#endif // RENDERSTATS_H
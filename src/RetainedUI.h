@@ -0,0 +1,514 @@
+/**
+@file RetainedUI.h
+
+Retained UI on top of one shared DynamicGeometryElement. Each widget
+owns a sub-range (vertices + indexes) of the shared buffer and only
+regenerates it when its content, style or layout changed; the change
+is propagated up the tree so update() only walks dirty branches. A
+frame without changes walks nothing and uploads nothing.
+
+Indexes of a range that is abandoned (the widget grew, was hidden or
+removed) are zeroed: degenerate triangles, no need to move the rest.
+Those holes are reused first-fit by the next widget that needs a
+range; when they still reach half of the buffer everything is packed
+again.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef RETAINEDUI_H
+#define RETAINEDUI_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "GeometryElement.h"
+
+namespace dune {
+
+// vertices e indices (locales al widget, empiezan en 0) de un widget
+class ui_builder
+{
+public:
+	void clear()
+	{
+		vertices.clear();
+		indexes.clear();
+	}
+
+	void quad(float x, float y, float w, float h, const unsigned char color[4],
+			  float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f)
+	{
+		GLuint base = (GLuint)vertices.size();
+		const float corners[4][4] = {
+			{x, y, u0, v0}, {x + w, y, u1, v0}, {x + w, y + h, u1, v1}, {x, y + h, u0, v1}
+		};
+		for (const auto& c : corners)
+		{
+			ElementsBuffer v;
+			v.position[0] = c[0];
+			v.position[1] = c[1];
+			v.position[2] = 0.0f;
+			v.coord[0] = c[2];
+			v.coord[1] = c[3];
+			std::copy(color, color + 4, v.color);
+			vertices.push_back(v);
+		}
+		const GLuint quad_indexes[6] = {0, 1, 2, 0, 2, 3};
+		for (GLuint i : quad_indexes)
+			indexes.push_back(base + i);
+	}
+
+public:
+	std::vector<ElementsBuffer> vertices;
+	std::vector<GLuint> indexes;
+};
+
+class ui_cache;
+
+class ui_widget
+{
+public:
+	ui_widget()
+		: _parent(nullptr)
+		, _cache(nullptr)
+		, _x(0.0f), _y(0.0f), _w(0.0f), _h(0.0f)
+		, _abs_x(0.0f), _abs_y(0.0f)
+		, _visible(true)
+		, _dirty_content(true)
+		, _dirty_layout(true)
+		, _dirty_subtree(false)
+	{
+
+	}
+
+	virtual ~ui_widget();
+
+	ui_widget(const ui_widget&) = delete;
+	ui_widget& operator=(const ui_widget&) = delete;
+
+	template <typename W>
+	W* add(std::unique_ptr<W> child)
+	{
+		W* raw = child.get();
+		raw->_parent = this;
+		raw->set_cache(_cache);
+		_children.emplace_back(std::move(child));
+		raw->invalidate_layout();
+		return raw;
+	}
+
+	void remove(ui_widget* child);
+
+	// posicion relativa al padre
+	void set_rect(float x, float y, float w, float h)
+	{
+		if (x == _x && y == _y && w == _w && h == _h)
+			return;
+		_x = x; _y = y; _w = w; _h = h;
+		invalidate_layout();
+	}
+
+	void set_visible(bool visible)
+	{
+		if (visible == _visible)
+			return;
+		_visible = visible;
+		invalidate_layout();
+	}
+
+	// contenido o estilo cambiado: solo este widget
+	void invalidate()
+	{
+		_dirty_content = true;
+		propagate();
+	}
+
+	// posicion o tamaño: este widget y sus hijos
+	void invalidate_layout()
+	{
+		_dirty_layout = true;
+		propagate();
+	}
+
+	float x() const { return _abs_x; }
+	float y() const { return _abs_y; }
+	float width() const { return _w; }
+	float height() const { return _h; }
+	bool visible() const { return _visible; }
+
+protected:
+	// genera la geometria en coordenadas absolutas (x(), y())
+	virtual void build(ui_builder&) { }
+
+	// invariante: si un nodo tiene _dirty_subtree, sus ancestros tambien
+	void propagate()
+	{
+		for (ui_widget* w = this; w && !w->_dirty_subtree; w = w->_parent)
+			w->_dirty_subtree = true;
+	}
+
+	void set_cache(ui_cache* cache)
+	{
+		_cache = cache;
+		for (auto& child : _children)
+			child->set_cache(cache);
+	}
+
+	struct slot
+	{
+		unsigned int first_vertex = 0;
+		unsigned int vertex_capacity = 0;
+		unsigned int first_index = 0;
+		unsigned int index_capacity = 0;
+		unsigned int index_count = 0;
+	};
+
+protected:
+	friend class ui_cache;
+	ui_widget* _parent;
+	ui_cache* _cache;
+	std::vector<std::unique_ptr<ui_widget> > _children;
+	float _x, _y, _w, _h;
+	float _abs_x, _abs_y;
+	bool _visible;
+	bool _dirty_content;
+	bool _dirty_layout;
+	bool _dirty_subtree;
+	slot _slot;
+};
+
+// rectangulo de color (fondos, barras del HUD)
+class ui_rect : public ui_widget
+{
+public:
+	void set_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a = 255)
+	{
+		if (_color[0] == r && _color[1] == g && _color[2] == b && _color[3] == a)
+			return;
+		_color[0] = r; _color[1] = g; _color[2] = b; _color[3] = a;
+		invalidate();
+	}
+
+protected:
+	void build(ui_builder& out) override
+	{
+		out.quad(x(), y(), width(), height(), _color);
+	}
+
+protected:
+	unsigned char _color[4] = {255, 255, 255, 255};
+};
+
+class ui_cache
+{
+public:
+	ui_cache()
+		: _vertex_end(0)
+		, _index_end(0)
+		, _wasted(0)
+		, _rebuilt(0)
+		, _program(0)
+		, _mvp_location(-1)
+	{
+		_root._cache = this;
+	}
+
+	~ui_cache()
+	{
+		if (_program)
+			glDeleteProgram(_program);
+	}
+
+	ui_cache(const ui_cache&) = delete;
+	ui_cache& operator=(const ui_cache&) = delete;
+
+	ui_widget& root() { return _root; }
+
+	/*
+	Regenerates the dirty widgets into their ranges. Returns how many
+	widgets were rebuilt (0 in a frame without changes).
+	*/
+	unsigned int update()
+	{
+		_rebuilt = 0;
+		if (!_root._dirty_subtree)
+			return 0;
+		update_node(_root, false);
+		if (_wasted * 2 > _index_end && _index_end > 1024)
+			compact();
+		return _rebuilt;
+	}
+
+	// solo sube los rangos escritos desde el ultimo render
+	void render()
+	{
+		_geometry.flush();
+		_geometry.render();
+	}
+
+	// con el programa de color plano propio; mvp: 4x4 por columnas (ortografica en pixeles)
+	void render(const float mvp[16])
+	{
+		if (!_program)
+		{
+			_program = create_program();
+			if (!_program)
+				return;
+			_mvp_location = glGetUniformLocation(_program, "mvp");
+		}
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glUseProgram(_program);
+		glUniformMatrix4fv(_mvp_location, 1, GL_FALSE, mvp);
+		render();
+		glUseProgram(0);
+		glDisable(GL_BLEND);
+	}
+
+	// el widget deja de usar su rango
+	void release(ui_widget& widget)
+	{
+		free_slot(widget._slot);
+		for (auto& child : widget._children)
+			release(*child);
+	}
+
+protected:
+	void update_node(ui_widget& node, bool parent_moved)
+	{
+		bool moved = parent_moved || node._dirty_layout;
+		if (moved)
+		{
+			node._abs_x = node._x + (node._parent ? node._parent->_abs_x : 0.0f);
+			node._abs_y = node._y + (node._parent ? node._parent->_abs_y : 0.0f);
+		}
+
+		if (!node._visible)
+		{
+			// oculto: la rama entera suelta sus rangos; al mostrarse se regenera por layout
+			hide(node);
+			return;
+		}
+
+		if (moved || node._dirty_content)
+		{
+			_builder.clear();
+			node.build(_builder);
+			store(node, _builder);
+			++_rebuilt;
+		}
+		node._dirty_content = false;
+		node._dirty_layout = false;
+
+		if (moved || node._dirty_subtree)
+		{
+			for (auto& child : node._children)
+			{
+				if (moved || child->_dirty_subtree || child->_dirty_layout || child->_dirty_content)
+					update_node(*child, moved);
+			}
+		}
+		node._dirty_subtree = false;
+	}
+
+	void hide(ui_widget& node)
+	{
+		free_slot(node._slot);
+		node._dirty_content = false;
+		node._dirty_layout = false;
+		node._dirty_subtree = false;
+		for (auto& child : node._children)
+			hide(*child);
+	}
+
+	void store(ui_widget& node, const ui_builder& data)
+	{
+		ui_widget::slot& s = node._slot;
+		unsigned int vertices = (unsigned int)data.vertices.size();
+		unsigned int indexes = (unsigned int)data.indexes.size();
+		if (vertices > s.vertex_capacity || indexes > s.index_capacity)
+		{
+			free_slot(s);
+			if (!reuse_slot(s, vertices, indexes))
+			{
+				// no cabe en ningun hueco: rango nuevo al final con margen para crecer
+				s.vertex_capacity = vertices + vertices / 2;
+				s.index_capacity = indexes + indexes / 2;
+				s.first_vertex = _vertex_end;
+				s.first_index = _index_end;
+				_vertex_end += s.vertex_capacity;
+				_index_end += s.index_capacity;
+				_geometry.resize(_vertex_end, _index_end);
+			}
+		}
+
+		if (vertices)
+			_geometry.write_vertices(s.first_vertex, data.vertices.data(), vertices);
+		_indexes.resize(s.index_capacity);
+		for (unsigned int i = 0; i < indexes; ++i)
+			_indexes[i] = data.indexes[i] + s.first_vertex;
+		// el resto de la capacidad: triangulos degenerados
+		std::fill(_indexes.begin() + indexes, _indexes.end(), 0u);
+		if (s.index_capacity)
+			_geometry.write_indexes(s.first_index, _indexes.data(), s.index_capacity);
+		s.index_count = indexes;
+	}
+
+	void free_slot(ui_widget::slot& s)
+	{
+		if (!s.index_capacity)
+			return;
+		_indexes.assign(s.index_capacity, 0u);
+		_geometry.write_indexes(s.first_index, _indexes.data(), s.index_capacity);
+		_wasted += s.index_capacity;
+		s.index_count = 0;
+		_free.push_back(s);
+		s = ui_widget::slot();
+	}
+
+	// primer hueco donde cabe
+	bool reuse_slot(ui_widget::slot& s, unsigned int vertices, unsigned int indexes)
+	{
+		for (size_t i = 0; i < _free.size(); ++i)
+		{
+			if (_free[i].vertex_capacity >= vertices && _free[i].index_capacity >= indexes)
+			{
+				s = _free[i];
+				_free[i] = _free.back();
+				_free.pop_back();
+				_wasted -= s.index_capacity;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// vuelve a empaquetar todos los rangos
+	void compact()
+	{
+		_vertex_end = 0;
+		_index_end = 0;
+		_wasted = 0;
+		_free.clear();
+		reset_slots(_root);
+		_geometry.resize(0, 0);
+		_root._dirty_layout = true;
+		_root._dirty_subtree = true;
+		update_node(_root, false);
+	}
+
+	void reset_slots(ui_widget& node)
+	{
+		node._slot = ui_widget::slot();
+		for (auto& child : node._children)
+			reset_slots(*child);
+	}
+
+	static GLuint compile_shader(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char error_log[1024];
+			glGetShaderInfoLog(shader, sizeof(error_log), NULL, error_log);
+			LOGE("Error compiling UI shader: '%s'", error_log);
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	static GLuint create_program()
+	{
+		// el color de ElementsBuffer llega sin normalizar (0..255)
+		const char* vertex_source =
+			"#version 330\n"
+			"in vec3 position;\n"
+			"in vec4 color;\n"
+			"uniform mat4 mvp;\n"
+			"out vec4 v_color;\n"
+			"void main()\n"
+			"{\n"
+			"	v_color = color / 255.0;\n"
+			"	gl_Position = mvp * vec4(position, 1.0);\n"
+			"}\n";
+		const char* fragment_source =
+			"#version 330\n"
+			"in vec4 v_color;\n"
+			"out vec4 FragColor;\n"
+			"void main()\n"
+			"{\n"
+			"	FragColor = v_color;\n"
+			"}\n";
+
+		GLuint vertex = compile_shader(GL_VERTEX_SHADER, vertex_source);
+		GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+		if (!vertex || !fragment)
+		{
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			return 0;
+		}
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glBindAttribLocation(program, AttribPosition, "position");
+		glBindAttribLocation(program, AttribColor, "color");
+		glBindFragDataLocation(program, 0, "FragColor");
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char error_log[1024];
+			glGetProgramInfoLog(program, sizeof(error_log), NULL, error_log);
+			LOGE("Error linking UI shader: '%s'", error_log);
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+protected:
+	ui_widget _root;
+	DynamicGeometryElement<ElementsBuffer> _geometry;
+	ui_builder _builder;
+	std::vector<GLuint> _indexes;
+	// rangos libres (indices a 0)
+	std::vector<ui_widget::slot> _free;
+	unsigned int _vertex_end;
+	unsigned int _index_end;
+	unsigned int _wasted;
+	unsigned int _rebuilt;
+	// programa de render(mvp), se crea en el primer uso (con contexto GL)
+	GLuint _program;
+	GLint _mvp_location;
+};
+
+inline ui_widget::~ui_widget()
+{
+
+}
+
+inline void ui_widget::remove(ui_widget* child)
+{
+	auto it = std::find_if(_children.begin(), _children.end(),
+						   [child](const std::unique_ptr<ui_widget>& c) { return c.get() == child; });
+	if (it == _children.end())
+		return;
+	if (_cache)
+		_cache->release(*child);
+	_children.erase(it);
+}
+
+} // end namespace dune
+
+#endif // RETAINEDUI_H
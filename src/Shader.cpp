@@ -1,4 +1,5 @@
 #include "Engine.h"
+#include "AssetArchive.h"
 //
 
 Shader::Shader()
@@ -16,16 +17,24 @@ Shader::~Shader()
 
 bool Shader::compile()
 {
-	char* bufferV = Sys_TextFileRead( _vertex_program_file.c_str() );
-	char* bufferF = Sys_TextFileRead( _fragment_program_file.c_str() );
+	// archivo montado: sin copias, texto directo del mapping
+	dune::asset vertex;
+	dune::asset fragment;
+	if (!dune::assets().read(_vertex_program_file, vertex) || !dune::assets().read(_fragment_program_file, fragment))
+	{
+		LOGE("Can't read %s / %s", _vertex_program_file.c_str(), _fragment_program_file.c_str());
+		return false;
+	}
 
 	LOGI("Compiling %s / %s", _vertex_program_file.c_str(),  _fragment_program_file.c_str()  );
 
-    _program = createProgram(bufferV, bufferF);
+	return compile_source(vertex.text(), fragment.text());
+}
 
-	// liberar memoria
-	free(bufferV);
-	free(bufferF);
+bool Shader::compile_source(const char* vertex_source, const char* fragment_source)
+{
+    _program = createProgram(vertex_source, fragment_source);
+	_parameters.clear();
 
     if(_program <= 0)
 	{
@@ -83,25 +92,7 @@ void Shader::bind_attrib(GLint numSlot, const char* attribName)
 
 int Shader::getParameter(const std::string& parmName)
 {
-	if(_parameters.count(parmName) <= 0)
-	{
-		// no hsy parametro, se busca en el shader
-		int idLocation = glGetUniformLocation(_program, parmName.c_str());
-		if(idLocation > -1)
-		{
-			_parameters[parmName] = idLocation;
-			return idLocation;
-		}
-		else
-		{
-			return -1;
-		}
-	}
-	else
-	{
-		// se tira de cache
-		return _parameters[parmName];
-	}
+	return _parameters.get(_program, parmName);
 }
 
 unsigned int Shader::loadShader(unsigned int shaderType, const char* pSource)
@@ -9,6 +9,8 @@
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include "gl_errors.h"
+#include "AssetArchive.h"
+#include "UniformCache.h"
 
 class Shader
 {
@@ -17,6 +19,30 @@ public:
 	~Shader();
 
 	bool compile();
+	bool compile_source(const char* vertex_source, const char* fragment_source);
+	/*
+	Reads both programs in one batch of io (async_io) and yields while
+	they load, the scheduler keeps running the other coroutines. Each file
+	is resolved by the vfs on its own: loose files (under the loose root)
+	go through io, files in a mounted archive are read without waiting.
+	*/
+	template <typename IO, typename Yield>
+	bool compile_async(IO& io, Yield& yield)
+	{
+		dune::asset vertex_packed;
+		dune::asset fragment_packed;
+		auto vertex = read_async(io, _vertex_program_file, vertex_packed);
+		auto fragment = read_async(io, _fragment_program_file, fragment_packed);
+		bool ok = (vertex ? io.await(yield, vertex) : !vertex_packed.empty());
+		ok = (fragment ? io.await(yield, fragment) : !fragment_packed.empty()) && ok;
+		if (!ok)
+		{
+			LOGE("Can't read %s / %s", _vertex_program_file.c_str(), _fragment_program_file.c_str());
+			return false;
+		}
+		return compile_source(vertex ? vertex->text() : vertex_packed.text(),
+							  fragment ? fragment->text() : fragment_packed.text());
+	}
     bool linking();
 	void Destroy();
 
@@ -56,6 +82,16 @@ public:
 
 protected:
 
+	// suelto: lectura encolada en io; si no, se lee ya del vfs en packed (nullptr)
+	template <typename IO>
+	static auto read_async(IO& io, const std::string& path, dune::asset& packed) -> decltype(io.read(path))
+	{
+		if (dune::assets().reads_loose(path))
+			return io.read(dune::assets().loose_path(path));
+		dune::assets().read(path, packed);
+		return nullptr;
+	}
+
 	unsigned int loadShader(unsigned int shaderType, const char* pSource);
 	unsigned int createProgram(const char* pVertexSource, const char* pFragmentSource);
 	void printShaderInfoLog(unsigned int obj);
@@ -70,7 +106,7 @@ protected:
 	std::string _geometry_program_file;
 	std::string _fragment_program_file;
 
-	std::map<std::string, int> _parameters;
+	dune::uniform_cache _parameters;
 };
 
 template <typename T>
@@ -0,0 +1,679 @@
+/**
+@file SpatialIndex.h
+
+Spatial indexes for scene objects:
+	- aabb_tree: dynamic AABB tree (fat boxes, refit and rotations),
+	  incremental insert / move / remove, box and ray queries and broadphase pairs
+	- loose_grid: loose uniform grid for 2D
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include "Bounds.h"
+
+namespace dune {
+
+inline bool overlaps(const aabb& a, const aabb& b)
+{
+	return a.min[0] <= b.max[0] && a.max[0] >= b.min[0] &&
+		   a.min[1] <= b.max[1] && a.max[1] >= b.min[1] &&
+		   a.min[2] <= b.max[2] && a.max[2] >= b.min[2];
+}
+
+inline bool contains(const aabb& outer, const aabb& inner)
+{
+	return outer.min[0] <= inner.min[0] && outer.min[1] <= inner.min[1] && outer.min[2] <= inner.min[2] &&
+		   outer.max[0] >= inner.max[0] && outer.max[1] >= inner.max[1] && outer.max[2] >= inner.max[2];
+}
+
+inline aabb merge(const aabb& a, const aabb& b)
+{
+	aabb result = a;
+	result.extend(b);
+	return result;
+}
+
+inline float surface(const aabb& box)
+{
+	float dx = box.max[0] - box.min[0];
+	float dy = box.max[1] - box.min[1];
+	float dz = box.max[2] - box.min[2];
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+struct ray
+{
+	float origin[3];
+	float direction[3];
+	float max_distance;
+};
+
+// slab test, distancia de entrada en t_hit
+inline bool intersects(const ray& r, const aabb& box, float& t_hit)
+{
+	float t0 = 0.0f, t1 = r.max_distance;
+	for (int i = 0; i < 3; ++i)
+	{
+		float inv = 1.0f / r.direction[i];
+		float near_t = (box.min[i] - r.origin[i]) * inv;
+		float far_t = (box.max[i] - r.origin[i]) * inv;
+		if (near_t > far_t)
+			std::swap(near_t, far_t);
+		t0 = near_t > t0 ? near_t : t0;
+		t1 = far_t < t1 ? far_t : t1;
+		if (t0 > t1)
+			return false;
+	}
+	t_hit = t0;
+	return true;
+}
+
+/*
+Dynamic AABB tree. Leaves store a fat box (box + margin), so a move
+inside the fat box does not touch the tree.
+*/
+class aabb_tree
+{
+public:
+	static const int null_node = -1;
+
+	explicit aabb_tree(float margin = 0.1f)
+		: _root(null_node)
+		, _free_list(null_node)
+		, _margin(margin)
+	{
+
+	}
+
+	int insert(const aabb& box, void* userdata = nullptr)
+	{
+		int proxy = allocate();
+		node& n = _nodes[proxy];
+		n.box = fatten(box);
+		n.userdata = userdata;
+		n.height = 0;
+		n.moved = true;
+		insert_leaf(proxy);
+		_moved.push_back(proxy);
+		return proxy;
+	}
+
+	void remove(int proxy)
+	{
+		// el hueco se puede reutilizar para un nodo interno antes de find_pairs
+		if (_nodes[proxy].moved)
+			_moved.erase(std::remove(_moved.begin(), _moved.end(), proxy), _moved.end());
+		remove_leaf(proxy);
+		release(proxy);
+	}
+
+	// devuelve true si ha tenido que reinsertar
+	bool move(int proxy, const aabb& box)
+	{
+		if (contains(_nodes[proxy].box, box))
+			return false;
+		remove_leaf(proxy);
+		_nodes[proxy].box = fatten(box);
+		insert_leaf(proxy);
+		if (!_nodes[proxy].moved)
+		{
+			_nodes[proxy].moved = true;
+			_moved.push_back(proxy);
+		}
+		return true;
+	}
+
+	void* userdata(int proxy) const { return _nodes[proxy].userdata; }
+	const aabb& fat_box(int proxy) const { return _nodes[proxy].box; }
+
+	template <typename F>
+	void query(const aabb& box, F&& callback) const
+	{
+		if (_root == null_node)
+			return;
+		int stack[64];
+		int top = 0;
+		std::vector<int> overflow;
+		stack[top++] = _root;
+		while (top > 0 || !overflow.empty())
+		{
+			int index;
+			if (!overflow.empty()) { index = overflow.back(); overflow.pop_back(); }
+			else index = stack[--top];
+
+			const node& n = _nodes[index];
+			if (!overlaps(n.box, box))
+				continue;
+			if (n.is_leaf())
+			{
+				callback(index);
+				continue;
+			}
+			for (int child : {n.left, n.right})
+			{
+				if (top < 64) stack[top++] = child;
+				else overflow.push_back(child);
+			}
+		}
+	}
+
+	// callback(proxy, t) devuelve la nueva distancia maxima (0 para parar)
+	template <typename F>
+	void raycast(const ray& r, F&& callback) const
+	{
+		if (_root == null_node)
+			return;
+		ray current = r;
+		std::vector<int> stack;
+		stack.push_back(_root);
+		while (!stack.empty())
+		{
+			int index = stack.back();
+			stack.pop_back();
+			const node& n = _nodes[index];
+			float t;
+			if (!intersects(current, n.box, t))
+				continue;
+			if (n.is_leaf())
+			{
+				current.max_distance = callback(index, t);
+				if (current.max_distance <= 0.0f)
+					return;
+				continue;
+			}
+			stack.push_back(n.left);
+			stack.push_back(n.right);
+		}
+	}
+
+	// resultados concatenados, offsets[i]..offsets[i+1] para la query i
+	void query_batch(const std::vector<aabb>& boxes, std::vector<int>& results, std::vector<size_t>& offsets) const
+	{
+		results.clear();
+		offsets.assign(1, 0);
+		for (const aabb& box : boxes)
+		{
+			query(box, [&](int proxy) { results.push_back(proxy); });
+			offsets.push_back(results.size());
+		}
+	}
+
+	// primer impacto por rayo (null_node si no hay)
+	void raycast_batch(const std::vector<ray>& rays, std::vector<int>& hits, std::vector<float>& distances) const
+	{
+		hits.assign(rays.size(), null_node);
+		distances.assign(rays.size(), std::numeric_limits<float>::max());
+		for (size_t i = 0; i < rays.size(); ++i)
+		{
+			raycast(rays[i], [&](int proxy, float t) {
+				if (t < distances[i])
+				{
+					distances[i] = t;
+					hits[i] = proxy;
+				}
+				return distances[i];
+			});
+		}
+	}
+
+	/*
+	Broadphase: pairs (a < b) with overlapping fat boxes where at least one
+	has moved since the last call.
+	*/
+	void find_pairs(std::vector<std::pair<int, int> >& pairs)
+	{
+		pairs.clear();
+		for (int proxy : _moved)
+		{
+			if (_nodes[proxy].height < 0 || !_nodes[proxy].is_leaf() || !_nodes[proxy].moved)
+				continue;  // eliminado despues de moverse
+			const aabb box = _nodes[proxy].box;
+			query(box, [&](int other) {
+				if (other == proxy)
+					return;
+				// si los dos se han movido, el par lo reporta el menor
+				if (_nodes[other].moved && other < proxy)
+					return;
+				pairs.emplace_back(std::min(proxy, other), std::max(proxy, other));
+			});
+		}
+		for (int proxy : _moved)
+			if (_nodes[proxy].height >= 0)
+				_nodes[proxy].moved = false;
+		_moved.clear();
+		std::sort(pairs.begin(), pairs.end());
+		pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	}
+
+	int height() const
+	{
+		return _root == null_node ? 0 : _nodes[_root].height;
+	}
+
+protected:
+	struct node
+	{
+		aabb box;
+		void* userdata;
+		int parent;  // next en la free list
+		int left;
+		int right;
+		int height;  // -1 libre, 0 hoja
+		bool moved;
+
+		bool is_leaf() const { return left == null_node; }
+	};
+
+	aabb fatten(const aabb& box) const
+	{
+		aabb fat = box;
+		for (int i = 0; i < 3; ++i)
+		{
+			fat.min[i] -= _margin;
+			fat.max[i] += _margin;
+		}
+		return fat;
+	}
+
+	int allocate()
+	{
+		if (_free_list == null_node)
+		{
+			_nodes.emplace_back();
+			_free_list = (int)_nodes.size() - 1;
+			_nodes[_free_list].parent = null_node;
+		}
+		int index = _free_list;
+		_free_list = _nodes[index].parent;
+		node& n = _nodes[index];
+		n.parent = n.left = n.right = null_node;
+		n.height = 0;
+		n.userdata = nullptr;
+		n.moved = false;
+		return index;
+	}
+
+	void release(int index)
+	{
+		_nodes[index].parent = _free_list;
+		_nodes[index].height = -1;
+		_nodes[index].moved = false;
+		_free_list = index;
+	}
+
+	void insert_leaf(int leaf)
+	{
+		if (_root == null_node)
+		{
+			_root = leaf;
+			_nodes[leaf].parent = null_node;
+			return;
+		}
+
+		// mejor hermano por coste de superficie (heuristica de Box2D)
+		const aabb leaf_box = _nodes[leaf].box;
+		int index = _root;
+		while (!_nodes[index].is_leaf())
+		{
+			const node& n = _nodes[index];
+			float area = surface(n.box);
+			float combined = surface(merge(n.box, leaf_box));
+			float cost = 2.0f * combined;
+			float inheritance = 2.0f * (combined - area);
+
+			auto child_cost = [&](int child) {
+				aabb box = merge(leaf_box, _nodes[child].box);
+				float c = surface(box) + inheritance;
+				if (!_nodes[child].is_leaf())
+					c -= surface(_nodes[child].box);
+				return c;
+			};
+			float cost_left = child_cost(n.left);
+			float cost_right = child_cost(n.right);
+			if (cost < cost_left && cost < cost_right)
+				break;
+			index = (cost_left < cost_right) ? n.left : n.right;
+		}
+
+		int sibling = index;
+		int old_parent = _nodes[sibling].parent;
+		int new_parent = allocate();
+		_nodes[new_parent].parent = old_parent;
+		_nodes[new_parent].box = merge(leaf_box, _nodes[sibling].box);
+		_nodes[new_parent].height = _nodes[sibling].height + 1;
+		_nodes[new_parent].left = sibling;
+		_nodes[new_parent].right = leaf;
+		_nodes[sibling].parent = new_parent;
+		_nodes[leaf].parent = new_parent;
+
+		if (old_parent == null_node)
+			_root = new_parent;
+		else if (_nodes[old_parent].left == sibling)
+			_nodes[old_parent].left = new_parent;
+		else
+			_nodes[old_parent].right = new_parent;
+
+		refit(_nodes[leaf].parent);
+	}
+
+	void remove_leaf(int leaf)
+	{
+		if (leaf == _root)
+		{
+			_root = null_node;
+			return;
+		}
+
+		int parent = _nodes[leaf].parent;
+		int grand_parent = _nodes[parent].parent;
+		int sibling = (_nodes[parent].left == leaf) ? _nodes[parent].right : _nodes[parent].left;
+
+		if (grand_parent == null_node)
+		{
+			_root = sibling;
+			_nodes[sibling].parent = null_node;
+			release(parent);
+			return;
+		}
+
+		if (_nodes[grand_parent].left == parent)
+			_nodes[grand_parent].left = sibling;
+		else
+			_nodes[grand_parent].right = sibling;
+		_nodes[sibling].parent = grand_parent;
+		release(parent);
+		refit(grand_parent);
+	}
+
+	// sube hasta la raiz balanceando y reajustando cajas
+	void refit(int index)
+	{
+		while (index != null_node)
+		{
+			index = balance(index);
+			node& n = _nodes[index];
+			n.height = 1 + std::max(_nodes[n.left].height, _nodes[n.right].height);
+			n.box = merge(_nodes[n.left].box, _nodes[n.right].box);
+			index = n.parent;
+		}
+	}
+
+	// rotacion si un hijo es 2 niveles mas alto, devuelve la nueva raiz del subarbol
+	int balance(int a)
+	{
+		node& na = _nodes[a];
+		if (na.is_leaf() || na.height < 2)
+			return a;
+
+		int b = na.left;
+		int c = na.right;
+		int diff = _nodes[c].height - _nodes[b].height;
+		if (diff > 1)
+			return rotate(a, c, b, true);
+		if (diff < -1)
+			return rotate(a, b, c, false);
+		return a;
+	}
+
+	// promueve 'up' (hijo alto de a) por encima de a; 'other' es el otro hijo de a
+	int rotate(int a, int up, int other, bool up_is_right)
+	{
+		int f = _nodes[up].left;
+		int g = _nodes[up].right;
+
+		_nodes[up].left = a;
+		_nodes[up].parent = _nodes[a].parent;
+		_nodes[a].parent = up;
+
+		int old_parent = _nodes[up].parent;
+		if (old_parent == null_node)
+			_root = up;
+		else if (_nodes[old_parent].left == a)
+			_nodes[old_parent].left = up;
+		else
+			_nodes[old_parent].right = up;
+
+		// el nieto mas alto se queda en 'up', el otro baja a 'a'
+		int keep = (_nodes[f].height > _nodes[g].height) ? f : g;
+		int give = (keep == f) ? g : f;
+		_nodes[up].right = keep;
+		if (up_is_right)
+			_nodes[a].right = give;
+		else
+			_nodes[a].left = give;
+		_nodes[give].parent = a;
+		(void)other;
+
+		node& na = _nodes[a];
+		na.box = merge(_nodes[na.left].box, _nodes[na.right].box);
+		na.height = 1 + std::max(_nodes[na.left].height, _nodes[na.right].height);
+		return up;
+	}
+
+protected:
+	std::vector<node> _nodes;
+	std::vector<int> _moved;
+	int _root;
+	int _free_list;
+	float _margin;
+};
+
+/*
+Loose uniform grid (2D, uses x/y of the boxes). Each object lives in
+the cell of its center; cells are loose by half a cell, so queries
+only look at neighbours expanded by the biggest object.
+*/
+class loose_grid
+{
+public:
+	loose_grid(float width, float height, float cell_size)
+		: _cell_size(cell_size)
+		, _inv_cell(1.0f / cell_size)
+		, _columns(std::max(1, (int)std::ceil(width / cell_size)))
+		, _rows(std::max(1, (int)std::ceil(height / cell_size)))
+		, _cells(_columns * _rows)
+		, _max_half_extent(0.0f)
+	{
+
+	}
+
+	int insert(const aabb& box, void* userdata = nullptr)
+	{
+		int id;
+		if (!_free.empty())
+		{
+			id = _free.back();
+			_free.pop_back();
+		}
+		else
+		{
+			id = (int)_objects.size();
+			_objects.emplace_back();
+		}
+		object& o = _objects[id];
+		o.box = box;
+		o.userdata = userdata;
+		o.alive = true;
+		o.cell = cell_of(box);
+		o.slot = (int)_cells[o.cell].size();
+		_cells[o.cell].push_back(id);
+		grow(box);
+		return id;
+	}
+
+	void remove(int id)
+	{
+		unlink(id);
+		_objects[id].alive = false;
+		_free.push_back(id);
+	}
+
+	void move(int id, const aabb& box)
+	{
+		object& o = _objects[id];
+		o.box = box;
+		grow(box);
+		int cell = cell_of(box);
+		if (cell == o.cell)
+			return;
+		unlink(id);
+		o.cell = cell;
+		o.slot = (int)_cells[cell].size();
+		_cells[cell].push_back(id);
+	}
+
+	const aabb& box(int id) const { return _objects[id].box; }
+	void* userdata(int id) const { return _objects[id].userdata; }
+
+	template <typename F>
+	void query(const aabb& area, F&& callback) const
+	{
+		float pad = _max_half_extent;
+		int cx0 = clamp_column((int)std::floor((area.min[0] - pad) * _inv_cell));
+		int cx1 = clamp_column((int)std::floor((area.max[0] + pad) * _inv_cell));
+		int cy0 = clamp_row((int)std::floor((area.min[1] - pad) * _inv_cell));
+		int cy1 = clamp_row((int)std::floor((area.max[1] + pad) * _inv_cell));
+		for (int y = cy0; y <= cy1; ++y)
+		{
+			for (int x = cx0; x <= cx1; ++x)
+			{
+				for (int id : _cells[y * _columns + x])
+				{
+					const aabb& b = _objects[id].box;
+					if (b.min[0] <= area.max[0] && b.max[0] >= area.min[0] && b.min[1] <= area.max[1] && b.max[1] >= area.min[1])
+						callback(id);
+				}
+			}
+		}
+	}
+
+	void find_pairs(std::vector<std::pair<int, int> >& pairs) const
+	{
+		pairs.clear();
+		for (int id = 0; id < (int)_objects.size(); ++id)
+		{
+			if (!_objects[id].alive)
+				continue;
+			query(_objects[id].box, [&](int other) {
+				if (other > id)
+					pairs.emplace_back(id, other);
+			});
+		}
+	}
+
+protected:
+	struct object
+	{
+		aabb box;
+		void* userdata;
+		int cell;
+		int slot;
+		bool alive;
+	};
+
+	int clamp_column(int x) const { return std::min(std::max(x, 0), _columns - 1); }
+	int clamp_row(int y) const { return std::min(std::max(y, 0), _rows - 1); }
+
+	int cell_of(const aabb& box) const
+	{
+		int x = clamp_column((int)std::floor((box.min[0] + box.max[0]) * 0.5f * _inv_cell));
+		int y = clamp_row((int)std::floor((box.min[1] + box.max[1]) * 0.5f * _inv_cell));
+		return y * _columns + x;
+	}
+
+	void grow(const aabb& box)
+	{
+		// objetos fuera del grid caen en celdas del borde: el padding cubre la distancia
+		_max_half_extent = std::max(_max_half_extent, (box.max[0] - box.min[0]) * 0.5f);
+		_max_half_extent = std::max(_max_half_extent, (box.max[1] - box.min[1]) * 0.5f);
+	}
+
+	void unlink(int id)
+	{
+		object& o = _objects[id];
+		std::vector<int>& cell = _cells[o.cell];
+		int last = cell.back();
+		cell[o.slot] = last;
+		_objects[last].slot = o.slot;
+		cell.pop_back();
+	}
+
+protected:
+	float _cell_size;
+	float _inv_cell;
+	int _columns;
+	int _rows;
+	std::vector<std::vector<int> > _cells;
+	std::vector<object> _objects;
+	std::vector<int> _free;
+	float _max_half_extent;
+};
+
+/*
+Scene container: objects with bounds and userdata indexed in an aabb_tree.
+*/
+template <typename T>
+class scene
+{
+public:
+	explicit scene(float margin = 0.1f)
+		: _tree(margin)
+	{
+
+	}
+
+	int add(const aabb& box, T* object)
+	{
+		return _tree.insert(box, object);
+	}
+
+	void move(int id, const aabb& box)
+	{
+		_tree.move(id, box);
+	}
+
+	void remove(int id)
+	{
+		_tree.remove(id);
+	}
+
+	T* get(int id) const
+	{
+		return (T*)_tree.userdata(id);
+	}
+
+	template <typename F>
+	void query(const aabb& box, F&& callback) const
+	{
+		_tree.query(box, [&](int id) { callback(id, get(id)); });
+	}
+
+	template <typename F>
+	void raycast(const ray& r, F&& callback) const
+	{
+		_tree.raycast(r, [&](int id, float t) { return callback(id, get(id), t); });
+	}
+
+	void find_pairs(std::vector<std::pair<int, int> >& pairs)
+	{
+		_tree.find_pairs(pairs);
+	}
+
+	aabb_tree& index() { return _tree; }
+
+protected:
+	aabb_tree _tree;
+};
+
+} // end namespace dune
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,255 @@
+/**
+@file Startup.h
+
+Start-up orchestrator. Initialization is split in stages with declared
+dependencies; a stage runs as soon as all its dependencies finished,
+in a worker_pool or, if it is marked main_thread (window, GL context),
+in the thread that calls run(). A stage that fails (returns false or
+throws) skips everything that depends on it.
+
+After run(), timeline() gives when and where every stage ran:
+
+	window        main     0.0 ..  12.4 ms  |###                 |
+	input         worker  12.4 ..  80.1 ms  |   ################  |
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include "WorkerPool.h"
+
+namespace dune {
+
+class startup
+{
+public:
+	typedef size_t stage_id;
+	typedef std::function<bool()> stage_func;
+
+	enum stage_state
+	{
+		stage_waiting,
+		stage_running,
+		stage_done,
+		stage_failed,
+		stage_skipped
+	};
+
+	struct stage_timing
+	{
+		std::string name;
+		bool main_thread;
+		stage_state state;
+		// ms desde run()
+		double start_ms;
+		double end_ms;
+	};
+
+	explicit startup(worker_pool& pool)
+		: _pool(pool)
+		, _finished(0)
+	{
+
+	}
+
+	startup(const startup&) = delete;
+	startup& operator=(const startup&) = delete;
+
+	// antes de run(); las dependencias tienen que estar ya añadidas
+	stage_id add(const std::string& name, const stage_func& func, const std::vector<stage_id>& dependencies = {}, bool main_thread = false)
+	{
+		stage s;
+		s.timing.name = name;
+		s.timing.main_thread = main_thread;
+		s.timing.state = stage_waiting;
+		s.timing.start_ms = s.timing.end_ms = 0.0;
+		s.func = func;
+		s.pending = dependencies.size();
+		stage_id id = _stages.size();
+		for (stage_id dependency : dependencies)
+			_stages[dependency].dependents.push_back(id);
+		_stages.push_back(s);
+		return id;
+	}
+
+	/*
+	Runs every stage and returns when all have finished (or have been
+	skipped). The calling thread runs the main_thread stages and waits
+	for the rest. false if any stage failed.
+	*/
+	bool run()
+	{
+		_start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			for (stage_id id = 0; id < _stages.size(); ++id)
+			{
+				if (_stages[id].pending == 0)
+					schedule(id);
+			}
+			while (_finished < _stages.size())
+			{
+				if (_main_ready.empty())
+				{
+					_cond.wait(lock);
+					continue;
+				}
+				stage_id id = _main_ready.front();
+				_main_ready.pop_front();
+				lock.unlock();
+				execute(id);
+				lock.lock();
+			}
+		}
+
+		bool ok = true;
+		for (const stage& s : _stages)
+			ok = ok && s.timing.state == stage_done;
+		return ok;
+	}
+
+	std::vector<stage_timing> timeline() const
+	{
+		std::vector<stage_timing> result;
+		for (const stage& s : _stages)
+			result.push_back(s.timing);
+		return result;
+	}
+
+	// una linea por etapa, con una barra proporcional al total
+	std::vector<std::string> report(unsigned int width = 40) const
+	{
+		double total = 0.0;
+		for (const stage& s : _stages)
+			total = std::max(total, s.timing.end_ms);
+		std::vector<std::string> lines;
+		for (const stage& s : _stages)
+		{
+			const stage_timing& t = s.timing;
+			std::string bar(width, ' ');
+			if (total > 0.0 && t.state != stage_skipped)
+			{
+				unsigned int from = (unsigned int)(t.start_ms / total * width);
+				unsigned int to = std::max(from + 1, (unsigned int)(t.end_ms / total * width + 0.5));
+				for (unsigned int i = from; i < to && i < width; ++i)
+					bar[i] = '#';
+			}
+			const char* state = (t.state == stage_done) ? "" : (t.state == stage_failed) ? " FAILED" : " skipped";
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-14s %-6s %7.1f .. %7.1f ms  |%s|%s",
+						  t.name.c_str(), t.main_thread ? "main" : "worker", t.start_ms, t.end_ms, bar.c_str(), state);
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+protected:
+	struct stage
+	{
+		stage_timing timing;
+		stage_func func;
+		size_t pending;
+		std::vector<stage_id> dependents;
+	};
+
+	// con _mutex tomado
+	void schedule(stage_id id)
+	{
+		if (_stages[id].timing.main_thread)
+		{
+			_main_ready.push_back(id);
+			_cond.notify_all();
+		}
+		else
+		{
+			_pool.submit([this, id]() { execute(id); });
+		}
+	}
+
+	void execute(stage_id id)
+	{
+		stage& s = _stages[id];
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			s.timing.state = stage_running;
+			s.timing.start_ms = elapsed_ms();
+		}
+		bool ok;
+		try
+		{
+			ok = s.func();
+		}
+		catch (const std::exception& e)
+		{
+			LOGE("Start-up stage %s: %s", s.timing.name.c_str(), e.what());
+			ok = false;
+		}
+		if (!ok)
+			LOGE("Start-up stage %s failed", s.timing.name.c_str());
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		s.timing.end_ms = elapsed_ms();
+		s.timing.state = ok ? stage_done : stage_failed;
+		++_finished;
+		if (ok)
+		{
+			for (stage_id dependent : s.dependents)
+			{
+				// una dependencia fallida ya lo ha saltado (y contado en _finished)
+				stage& d = _stages[dependent];
+				if (--d.pending == 0 && d.timing.state == stage_waiting)
+					schedule(dependent);
+			}
+		}
+		else
+		{
+			skip_dependents(id);
+		}
+		_cond.notify_all();
+	}
+
+	// con _mutex tomado
+	void skip_dependents(stage_id id)
+	{
+		for (stage_id dependent : _stages[id].dependents)
+		{
+			stage& d = _stages[dependent];
+			if (d.timing.state != stage_waiting)
+				continue;
+			d.timing.state = stage_skipped;
+			++_finished;
+			skip_dependents(dependent);
+		}
+	}
+
+	double elapsed_ms() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+	}
+
+protected:
+	worker_pool& _pool;
+	std::vector<stage> _stages;
+	std::deque<stage_id> _main_ready;
+	std::mutex _mutex;
+	std::condition_variable _cond;
+	size_t _finished;
+	std::chrono::steady_clock::time_point _start;
+};
+
+} // end namespace dune
+
+#endif // STARTUP_H
@@ -0,0 +1,525 @@
+/**
+@file StateSync.h
+
+State replication over MQTT for spectators and monitors. The publisher
+keeps a table of entities (quantized position + a bit field, e.g. the
+held actions) and, at a fixed rate, sends one message with only the
+entities that changed since the last snapshot acknowledged by every
+subscriber, so the size follows the change rate and not the scene size.
+Subscribers acknowledge what they decoded and interpolate between
+snapshots. A subscriber that cannot decode (unknown base, publisher
+restarted, nothing arriving) acknowledges 0 to get a full snapshot.
+
+Message:
+	version, varint epoch, varint seq, varint base seq (0 = full),
+	varint time (ms), varint entity capacity, varint changed count
+	per entity: varint id gap, mask (fields changed, 0x80 removed),
+	            zigzag varint delta per changed field
+
+Ack (topic + "/ack"): varint epoch, varint seq, client name
+
+The epoch is chosen at random by each publisher instance; seqs are only
+comparable within the same epoch.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef STATESYNC_H
+#define STATESYNC_H
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include "InputRecorder.h"
+#include "MqttLink.h"
+
+namespace dune {
+
+const unsigned char STATE_VERSION = 2;
+// x, y, z, bits
+const int STATE_FIELDS = 4;
+const unsigned char STATE_REMOVED = 0x80;
+
+struct entity_state
+{
+	int32_t v[STATE_FIELDS];
+};
+
+struct state_snapshot
+{
+	uint32_t seq = 0;
+	uint32_t time_ms = 0;
+	std::vector<entity_state> entities;
+	std::vector<unsigned char> present;
+};
+
+struct state_options
+{
+	std::string server = "tcp://localhost:1883";
+	std::string client_id = "dune-state";
+	std::string topic = "dune/state";
+	// 1/16 de unidad
+	float precision = 1.0f / 16.0f;
+	// snapshots guardados para deltas (y acks validos)
+	uint32_t history = 32;
+	// mensajes por segundo del publicador
+	int rate_hz = 20;
+};
+
+namespace state_codec {
+
+inline void encode(uint32_t epoch, const state_snapshot& current, const state_snapshot* base, std::vector<unsigned char>& out, std::vector<unsigned char>& scratch)
+{
+	out.clear();
+	out.push_back(STATE_VERSION);
+	varint::write(out, epoch);
+	varint::write(out, current.seq);
+	varint::write(out, base ? base->seq : 0);
+	varint::write(out, current.time_ms);
+	varint::write(out, current.entities.size());
+
+	// el numero de cambios va delante: los cambios se escriben aparte
+	uint32_t changed = 0;
+	std::vector<unsigned char>& body = scratch;
+	body.clear();
+	size_t previous = 0;
+	bool first = true;
+	size_t base_size = base ? base->entities.size() : 0;
+	size_t total = std::max(current.entities.size(), base_size);
+	for (size_t id = 0; id < total; ++id)
+	{
+		bool now = id < current.present.size() && current.present[id];
+		bool before = id < base_size && base->present[id];
+		if (!now && !before)
+			continue;
+
+		unsigned char mask = 0;
+		if (!now)
+		{
+			mask = STATE_REMOVED;
+		}
+		else
+		{
+			for (int f = 0; f < STATE_FIELDS; ++f)
+			{
+				int32_t old_value = before ? base->entities[id].v[f] : 0;
+				if (current.entities[id].v[f] != old_value || (!before && f == 0))
+					mask |= (unsigned char)(1 << f);
+			}
+		}
+		if (!mask)
+			continue;
+
+		varint::write(body, first ? id : id - previous - 1);
+		body.push_back(mask);
+		if (now)
+		{
+			for (int f = 0; f < STATE_FIELDS; ++f)
+			{
+				if (mask & (1 << f))
+				{
+					int32_t old_value = before ? base->entities[id].v[f] : 0;
+					varint::write_signed(body, (int64_t)current.entities[id].v[f] - old_value);
+				}
+			}
+		}
+		previous = id;
+		first = false;
+		++changed;
+	}
+	varint::write(out, changed);
+	out.insert(out.end(), body.begin(), body.end());
+}
+
+// epoch, seq y base_seq de un mensaje, para buscar su baseline antes de decodificar
+inline bool peek_base(const unsigned char* p, const unsigned char* end, uint64_t& epoch, uint64_t& seq, uint64_t& base_seq)
+{
+	if (p >= end || *p++ != STATE_VERSION)
+		return false;
+	return varint::read(p, end, epoch) && varint::read(p, end, seq) && varint::read(p, end, base_seq);
+}
+
+inline bool decode(const unsigned char* p, const unsigned char* end, const state_snapshot* base, state_snapshot& out)
+{
+	uint64_t epoch, seq, base_seq, time_ms, capacity, changed;
+	if (p >= end || *p++ != STATE_VERSION)
+		return false;
+	if (!varint::read(p, end, epoch) || !varint::read(p, end, seq) || !varint::read(p, end, base_seq) ||
+		!varint::read(p, end, time_ms) || !varint::read(p, end, capacity) || !varint::read(p, end, changed))
+		return false;
+	if ((base_seq != 0) != (base != nullptr) || (base && base->seq != base_seq))
+		return false;
+
+	if (base)
+	{
+		out.entities = base->entities;
+		out.present = base->present;
+	}
+	else
+	{
+		out.entities.clear();
+		out.present.clear();
+	}
+	out.entities.resize((size_t)capacity, entity_state());
+	out.present.resize((size_t)capacity, 0);
+	out.seq = (uint32_t)seq;
+	out.time_ms = (uint32_t)time_ms;
+
+	uint64_t id = 0;
+	for (uint64_t i = 0; i < changed; ++i)
+	{
+		uint64_t gap;
+		if (!varint::read(p, end, gap) || p >= end)
+			return false;
+		id = (i == 0) ? gap : id + gap + 1;
+		unsigned char mask = *p++;
+		if (id >= capacity)
+			return false;
+		if (mask & STATE_REMOVED)
+		{
+			out.present[id] = 0;
+			continue;
+		}
+		if (!out.present[id])
+			out.entities[id] = entity_state();
+		out.present[id] = 1;
+		for (int f = 0; f < STATE_FIELDS; ++f)
+		{
+			if (mask & (1 << f))
+			{
+				int64_t delta;
+				if (!varint::read_signed(p, end, delta))
+					return false;
+				out.entities[id].v[f] = (int32_t)(out.entities[id].v[f] + delta);
+			}
+		}
+	}
+	return true;
+}
+
+} // end namespace state_codec
+
+class state_publisher
+{
+public:
+	explicit state_publisher(const state_options& options = state_options())
+		: _options(options)
+		, _history(options.history)
+		, _epoch(std::random_device()() | 1u)
+		, _seq(0)
+		, _start(std::chrono::steady_clock::now())
+		, _last_tick(_start - std::chrono::seconds(1))
+		, _last_size(0)
+		, _link(options.server, options.client_id)
+	{
+		_link.set_handler([this](const std::string&, const std::string& payload) { on_ack(payload); });
+		_link.subscribe(_options.topic + "/ack");
+	}
+
+	int add()
+	{
+		_current.entities.push_back(entity_state());
+		_current.present.push_back(1);
+		return (int)_current.entities.size() - 1;
+	}
+
+	void remove(int id)
+	{
+		_current.present[id] = 0;
+	}
+
+	void set_position(int id, float x, float y, float z = 0.0f)
+	{
+		entity_state& e = _current.entities[id];
+		e.v[0] = quantize(x);
+		e.v[1] = quantize(y);
+		e.v[2] = quantize(z);
+	}
+
+	void set_bits(int id, uint32_t bits)
+	{
+		_current.entities[id].v[3] = (int32_t)bits;
+	}
+
+	/*
+	Builds and publishes a snapshot if 1 / rate_hz has passed since the
+	previous one; call it every simulation step. Without subscribers
+	nothing is sent. Returns true when a snapshot was taken.
+	*/
+	bool tick()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now - _last_tick < std::chrono::microseconds(1000000 / std::max(_options.rate_hz, 1)))
+			return false;
+		_last_tick = now;
+
+		_current.seq = ++_seq;
+		_current.time_ms = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start).count();
+
+		bool any = false;
+		const state_snapshot* base = baseline(any);
+		if (any)
+		{
+			state_codec::encode(_epoch, _current, base, _buffer, _scratch);
+			_last_size = _buffer.size();
+			_link.publish(_options.topic, _buffer.data(), _buffer.size());
+		}
+		_history[_current.seq % _history.size()] = _current;
+		return true;
+	}
+
+	size_t last_message_size() const { return _last_size; }
+
+protected:
+	int32_t quantize(float value) const
+	{
+		return (int32_t)std::lround(value / _options.precision);
+	}
+
+	// delta contra el snapshot mas antiguo que todos han confirmado
+	const state_snapshot* baseline(bool& any)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto now = std::chrono::steady_clock::now();
+		uint32_t oldest = UINT32_MAX;
+		any = false;
+		for (auto it = _clients.begin(); it != _clients.end();)
+		{
+			// cliente que no confirma en 5 segundos: se olvida
+			if (now - it->second.last_seen > std::chrono::seconds(5))
+			{
+				it = _clients.erase(it);
+				continue;
+			}
+			any = true;
+			oldest = std::min(oldest, it->second.acked);
+			++it;
+		}
+		if (!any || oldest == 0 || _seq - oldest >= _history.size())
+			return nullptr;
+		const state_snapshot& base = _history[oldest % _history.size()];
+		return (base.seq == oldest) ? &base : nullptr;
+	}
+
+	// hilo de paho
+	void on_ack(const std::string& payload)
+	{
+		const unsigned char* p = (const unsigned char*)payload.data();
+		const unsigned char* end = p + payload.size();
+		uint64_t epoch, seq;
+		if (!varint::read(p, end, epoch) || !varint::read(p, end, seq))
+			return;
+		// ack de otro publicador (p.ej. el anterior a un reinicio): su seq no vale aqui
+		if (seq != 0 && epoch != _epoch)
+			return;
+		std::string name((const char*)p, (const char*)end);
+		std::lock_guard<std::mutex> lock(_mutex);
+		client& c = _clients[name];
+		c.last_seen = std::chrono::steady_clock::now();
+		// los acks pueden llegar desordenados; 0 = necesita snapshot completo
+		if (seq == 0 || seq > c.acked)
+			c.acked = (uint32_t)seq;
+	}
+
+protected:
+	struct client
+	{
+		uint32_t acked = 0;
+		std::chrono::steady_clock::time_point last_seen;
+	};
+
+	state_options _options;
+	state_snapshot _current;
+	std::vector<state_snapshot> _history;
+	uint32_t _epoch;
+	uint32_t _seq;
+	std::chrono::steady_clock::time_point _start;
+	std::chrono::steady_clock::time_point _last_tick;
+	std::vector<unsigned char> _buffer;
+	std::vector<unsigned char> _scratch;
+	size_t _last_size;
+
+	std::mutex _mutex;
+	std::map<std::string, client> _clients;
+	// el ultimo: se destruye primero y no quedan callbacks de paho en vuelo
+	mqtt_link _link;
+};
+
+class state_subscriber
+{
+public:
+	state_subscriber(const std::string& name, const state_options& options = state_options())
+		: _options(options)
+		, _name(name)
+		, _history(options.history)
+		, _epoch(0)
+		, _latest(0)
+		, _has_offset(false)
+		, _offset_ms(0.0)
+		, _start(std::chrono::steady_clock::now())
+		, _last_decoded(_start)
+		, _last_hello(_start - std::chrono::seconds(10))
+		, _link(options.server, options.client_id + "-" + name)
+	{
+		_link.set_handler([this](const std::string&, const std::string& payload) { on_snapshot(payload); });
+		_link.subscribe(_options.topic);
+	}
+
+	/*
+	Interpolated state of entity id, delay_ms behind the newest snapshot
+	(enough to always have two snapshots around). Also sends the hello
+	(ack 0) until the first snapshot arrives, or again if nothing could be
+	decoded for a second; call it every frame.
+	*/
+	bool sample(int id, double delay_ms, float position[3], uint32_t& bits)
+	{
+		double now = local_ms();
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_latest || std::chrono::steady_clock::now() - _last_decoded > std::chrono::seconds(1))
+		{
+			request_full();
+		}
+		if (!_latest)
+		{
+			return false;
+		}
+
+		double target = now - _offset_ms - delay_ms;
+		const state_snapshot* a = nullptr;
+		const state_snapshot* b = nullptr;
+		for (const state_snapshot& s : _history)
+		{
+			if (!s.seq || id >= (int)s.present.size() || !s.present[id])
+				continue;
+			if (s.time_ms <= target && (!a || s.time_ms > a->time_ms))
+				a = &s;
+			if (s.time_ms > target && (!b || s.time_ms < b->time_ms))
+				b = &s;
+		}
+		if (!a)
+			std::swap(a, b);
+		if (!a)
+			return false;
+
+		float t = 0.0f;
+		if (b && b->time_ms > a->time_ms)
+			t = (float)((target - a->time_ms) / (b->time_ms - a->time_ms));
+		for (int f = 0; f < 3; ++f)
+		{
+			float va = a->entities[id].v[f] * _options.precision;
+			float vb = b ? b->entities[id].v[f] * _options.precision : va;
+			position[f] = va + (vb - va) * t;
+		}
+		bits = (uint32_t)a->entities[id].v[3];
+		return true;
+	}
+
+	uint32_t latest_seq() const { return _latest; }
+
+protected:
+	double local_ms() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+	}
+
+	// hilo de paho
+	void on_snapshot(const std::string& payload)
+	{
+		const unsigned char* p = (const unsigned char*)payload.data();
+		const unsigned char* end = p + payload.size();
+		uint64_t epoch, seq, base_seq;
+		if (!state_codec::peek_base(p, end, epoch, seq, base_seq) || !seq)
+			return;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		// publicador reiniciado: otra epoch, o una seq muy por debajo de la ultima
+		if (epoch != _epoch || seq + _history.size() < _latest)
+		{
+			reset((uint32_t)epoch);
+		}
+		if (seq <= _latest)
+			return;
+		const state_snapshot* base = nullptr;
+		if (base_seq)
+		{
+			const state_snapshot& candidate = _history[base_seq % _history.size()];
+			if (candidate.seq != base_seq)
+			{
+				// delta contra algo que no tenemos: pedir un snapshot completo
+				request_full();
+				return;
+			}
+			base = &candidate;
+		}
+		state_snapshot decoded;
+		if (!state_codec::decode(p, end, base, decoded))
+			return;
+		_history[seq % _history.size()] = std::move(decoded);
+		_latest = (uint32_t)seq;
+		_last_decoded = std::chrono::steady_clock::now();
+
+		// reloj remoto -> local: el menor desfase visto absorbe el jitter
+		const state_snapshot& s = _history[seq % _history.size()];
+		double offset = local_ms() - s.time_ms;
+		if (!_has_offset || offset < _offset_ms)
+		{
+			_offset_ms = offset;
+			_has_offset = true;
+		}
+		send_ack(_latest);
+	}
+
+	void reset(uint32_t epoch)
+	{
+		_epoch = epoch;
+		_latest = 0;
+		_has_offset = false;
+		for (state_snapshot& s : _history)
+			s = state_snapshot();
+	}
+
+	// ack 0, como mucho 4 veces por segundo
+	void request_full()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now - _last_hello > std::chrono::milliseconds(250))
+		{
+			_last_hello = now;
+			send_ack(0);
+		}
+	}
+
+	void send_ack(uint32_t seq)
+	{
+		std::vector<unsigned char> ack;
+		varint::write(ack, _epoch);
+		varint::write(ack, seq);
+		ack.insert(ack.end(), _name.begin(), _name.end());
+		_link.publish(_options.topic + "/ack", ack.data(), ack.size());
+	}
+
+protected:
+	state_options _options;
+	std::string _name;
+	std::mutex _mutex;
+	std::vector<state_snapshot> _history;
+	uint32_t _epoch;
+	uint32_t _latest;
+	bool _has_offset;
+	double _offset_ms;
+	std::chrono::steady_clock::time_point _start;
+	std::chrono::steady_clock::time_point _last_decoded;
+	std::chrono::steady_clock::time_point _last_hello;
+	mqtt_link _link;
+};
+
+} // end namespace dune
+
+#endif // STATESYNC_H
@@ -0,0 +1,353 @@
+/**
+@file Telemetry.h
+
+Live frame metrics over MQTT. The frame loop pushes one sample per
+frame into a lock-free ring (dropped if full); a background thread
+aggregates them into fixed log-scale histograms and counters and
+publishes a CBOR snapshot every interval. The frame never waits on the
+network: if the broker is down or too many publications are in flight
+the snapshot is dropped and counted.
+
+Snapshot (CBOR map):
+	seq, frames, dropped_samples, dropped_snapshots,
+	draw_calls, uploads, upload_bytes,
+	frame_us / input_us: { count, min, max, mean, p50, p95, p99, buckets: [[index, count], ...] }
+
+Local test:
+	mosquitto -v
+	mosquitto_sub -t dune/telemetry | xxd
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include "InputQueue.h"
+#include "MqttLink.h"
+
+namespace dune {
+
+struct frame_sample
+{
+	uint64_t frame_ns;
+	// valida solo con input_delivered
+	uint64_t input_latency_ns;
+	bool input_delivered;
+	uint32_t draw_calls;
+	uint32_t uploads;
+	uint64_t upload_bytes;
+};
+
+/*
+Log-linear buckets in microseconds: 8 buckets per power of two,
+1 us .. ~16 s. Fixed size, record() is O(1).
+*/
+class time_histogram
+{
+public:
+	static const int SUB_BITS = 3;
+	static const int SUB_BUCKETS = 1 << SUB_BITS;
+	static const int BUCKETS = 24 * SUB_BUCKETS;
+
+	time_histogram()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		for (int i = 0; i < BUCKETS; ++i)
+			_counts[i] = 0;
+		_count = 0;
+		_sum = 0;
+		_min = UINT64_MAX;
+		_max = 0;
+	}
+
+	void record(uint64_t us)
+	{
+		++_counts[bucket(us)];
+		++_count;
+		_sum += us;
+		_min = (us < _min) ? us : _min;
+		_max = (us > _max) ? us : _max;
+	}
+
+	static int bucket(uint64_t us)
+	{
+		if (us < 1)
+			return 0;
+		int octave = 63 - count_leading_zeros(us);
+		// los SUB_BITS bajo el bit mas alto eligen el sub bucket
+		int sub = (octave >= SUB_BITS) ? (int)((us >> (octave - SUB_BITS)) & (SUB_BUCKETS - 1))
+									   : (int)((us << (SUB_BITS - octave)) & (SUB_BUCKETS - 1));
+		int index = octave * SUB_BUCKETS + sub;
+		return (index < BUCKETS) ? index : BUCKETS - 1;
+	}
+
+	// limite superior del bucket
+	static uint64_t upper_bound(int index)
+	{
+		int octave = index / SUB_BUCKETS;
+		int sub = index % SUB_BUCKETS;
+		return (uint64_t)std::ldexp(1.0 + (sub + 1) / (double)SUB_BUCKETS, octave);
+	}
+
+	uint64_t percentile(double p) const
+	{
+		if (!_count)
+			return 0;
+		uint64_t target = (uint64_t)std::ceil(p * _count);
+		uint64_t accum = 0;
+		for (int i = 0; i < BUCKETS; ++i)
+		{
+			accum += _counts[i];
+			if (accum >= target)
+				return (upper_bound(i) < _max) ? upper_bound(i) : _max;
+		}
+		return _max;
+	}
+
+	uint32_t count(int index) const { return _counts[index]; }
+	uint64_t count() const { return _count; }
+	uint64_t min() const { return _count ? _min : 0; }
+	uint64_t max() const { return _max; }
+	uint64_t mean() const { return _count ? _sum / _count : 0; }
+
+protected:
+	static int count_leading_zeros(uint64_t v)
+	{
+#if defined(__GNUC__)
+		return __builtin_clzll(v);
+#else
+		int n = 0;
+		for (uint64_t bit = uint64_t(1) << 63; !(v & bit); bit >>= 1)
+			++n;
+		return n;
+#endif
+	}
+
+protected:
+	uint32_t _counts[BUCKETS];
+	uint64_t _count;
+	uint64_t _sum;
+	uint64_t _min;
+	uint64_t _max;
+};
+
+// subconjunto de CBOR (RFC 7049): enteros sin signo, texto, arrays y mapas
+class cbor_writer
+{
+public:
+	void clear() { _data.clear(); }
+	const std::vector<unsigned char>& data() const { return _data; }
+
+	void uint(uint64_t value) { head(0, value); }
+	void text(const char* str)
+	{
+		size_t n = std::char_traits<char>::length(str);
+		head(3, n);
+		_data.insert(_data.end(), str, str + n);
+	}
+	void array(size_t n) { head(4, n); }
+	void map(size_t n) { head(5, n); }
+
+	template <typename T>
+	void field(const char* key, T value)
+	{
+		text(key);
+		uint((uint64_t)value);
+	}
+
+protected:
+	void head(unsigned char major, uint64_t value)
+	{
+		major <<= 5;
+		if (value < 24)
+		{
+			_data.push_back(major | (unsigned char)value);
+			return;
+		}
+		int bytes = (value <= 0xFF) ? 1 : (value <= 0xFFFF) ? 2 : (value <= 0xFFFFFFFF) ? 4 : 8;
+		_data.push_back(major | (unsigned char)(bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+		for (int i = bytes - 1; i >= 0; --i)
+			_data.push_back((unsigned char)(value >> (i * 8)));
+	}
+
+protected:
+	std::vector<unsigned char> _data;
+};
+
+struct telemetry_options
+{
+	std::string server = "tcp://localhost:1883";
+	std::string client_id = "dune-telemetry";
+	std::string topic = "dune/telemetry";
+	std::chrono::milliseconds interval = std::chrono::milliseconds(1000);
+	int qos = 0;
+	// publicaciones sin confirmar antes de descartar snapshots
+	size_t max_in_flight = 4;
+};
+
+class telemetry
+{
+public:
+	static const size_t RING_SIZE = 1024;
+
+	explicit telemetry(const telemetry_options& options = telemetry_options())
+		: _options(options)
+		, _link(options.server, options.client_id, options.max_in_flight)
+		, _stop(false)
+		, _dropped_snapshots(0)
+		, _published(0)
+		, _sequence(0)
+	{
+		reset_aggregates();
+		_worker = std::thread([this]() { run(); });
+	}
+
+	~telemetry()
+	{
+		_stop.store(true, std::memory_order_release);
+		_worker.join();
+	}
+
+	telemetry(const telemetry&) = delete;
+	telemetry& operator=(const telemetry&) = delete;
+
+	// hilo del frame: nunca espera
+	void record(const frame_sample& sample)
+	{
+		_samples.push(sample);
+	}
+
+	size_t dropped_samples() const { return _samples.dropped(); }
+	uint64_t dropped_snapshots() const { return _dropped_snapshots.load(std::memory_order_relaxed); }
+	uint64_t published() const { return _published.load(std::memory_order_relaxed); }
+
+protected:
+	void run()
+	{
+		auto next_publish = std::chrono::steady_clock::now() + _options.interval;
+		while (!_stop.load(std::memory_order_acquire))
+		{
+			aggregate();
+
+			auto now = std::chrono::steady_clock::now();
+			if (now >= next_publish)
+			{
+				next_publish = now + _options.interval;
+				publish();
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	void aggregate()
+	{
+		_samples.drain([this](const frame_sample& s) {
+			_frame_us.record(s.frame_ns / 1000);
+			if (s.input_delivered)
+				_input_us.record(s.input_latency_ns / 1000);
+			_draw_calls += s.draw_calls;
+			_uploads += s.uploads;
+			_upload_bytes += s.upload_bytes;
+		});
+	}
+
+	void publish()
+	{
+		encode();
+		reset_aggregates();
+		if (_link.publish(_options.topic, _cbor.data().data(), _cbor.data().size(), _options.qos))
+			_published.fetch_add(1, std::memory_order_relaxed);
+		else
+			_dropped_snapshots.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void encode()
+	{
+		_cbor.clear();
+		_cbor.map(9);
+		_cbor.field("seq", _sequence++);
+		_cbor.field("frames", _frame_us.count());
+		_cbor.field("dropped_samples", _samples.dropped());
+		_cbor.field("dropped_snapshots", _dropped_snapshots.load(std::memory_order_relaxed));
+		_cbor.field("draw_calls", _draw_calls);
+		_cbor.field("uploads", _uploads);
+		_cbor.field("upload_bytes", _upload_bytes);
+		encode_histogram("frame_us", _frame_us);
+		encode_histogram("input_us", _input_us);
+	}
+
+	void encode_histogram(const char* name, const time_histogram& h)
+	{
+		int used = 0;
+		for (int i = 0; i < time_histogram::BUCKETS; ++i)
+			used += h.count(i) ? 1 : 0;
+
+		_cbor.text(name);
+		_cbor.map(8);
+		_cbor.field("count", h.count());
+		_cbor.field("min", h.min());
+		_cbor.field("max", h.max());
+		_cbor.field("mean", h.mean());
+		_cbor.field("p50", h.percentile(0.50));
+		_cbor.field("p95", h.percentile(0.95));
+		_cbor.field("p99", h.percentile(0.99));
+		// solo buckets no vacios
+		_cbor.text("buckets");
+		_cbor.array(used);
+		for (int i = 0; i < time_histogram::BUCKETS; ++i)
+		{
+			if (h.count(i))
+			{
+				_cbor.array(2);
+				_cbor.uint(i);
+				_cbor.uint(h.count(i));
+			}
+		}
+	}
+
+	void reset_aggregates()
+	{
+		_frame_us.reset();
+		_input_us.reset();
+		_draw_calls = 0;
+		_uploads = 0;
+		_upload_bytes = 0;
+	}
+
+protected:
+	telemetry_options _options;
+	mqtt_link _link;
+	spsc_ring<frame_sample, RING_SIZE> _samples;
+	std::atomic<bool> _stop;
+	std::atomic<uint64_t> _dropped_snapshots;
+	std::atomic<uint64_t> _published;
+
+	// solo el worker
+	uint64_t _sequence;
+	time_histogram _frame_us;
+	time_histogram _input_us;
+	uint64_t _draw_calls;
+	uint64_t _uploads;
+	uint64_t _upload_bytes;
+	cbor_writer _cbor;
+
+	std::thread _worker;
+};
+
+} // end namespace dune
+
+#endif // TELEMETRY_H
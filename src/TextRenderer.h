@@ -0,0 +1,540 @@
+/**
+@file TextRenderer.h
+
+Batched SDF text. draw() only records the text: the run (UTF-8 string
+already shaped into glyph quads) comes from a cache keyed by (string
+hash, font, size), so the same text in the next frame costs a lookup
+and a check of the glyph generations. Text that changes every frame
+(counters) goes through draw_slot(): its run belongs to a slot chosen
+by the caller and is shaped again in place, without adding cache
+entries. end_frame() writes all the quads
+with one reservation per run and page into one ElementsBuffer batch per
+atlas page; render() is one draw call per page.
+
+	dune::text_renderer text;
+	text.begin_frame();
+	text.draw(0, 16, 10.0f, 10.0f, "hello", white);
+	text.end_frame();
+	text.render(ortho);
+
+Needs the GL context when constructed.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef TEXTRENDERER_H
+#define TEXTRENDERER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include "GlyphAtlas.h"
+#include "GeometryElement.h"
+
+namespace dune {
+
+// siguiente codepoint; secuencias invalidas dan U+FFFD
+inline uint32_t utf8_next(const char*& it, const char* end)
+{
+	unsigned char c = (unsigned char)*it++;
+	if (c < 0x80)
+		return c;
+	int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : -1;
+	if (extra < 0 || end - it < extra)
+		return 0xFFFD;
+	uint32_t codepoint = c & (0x3F >> extra);
+	for (int i = 0; i < extra; ++i)
+	{
+		unsigned char next = (unsigned char)*it;
+		if ((next & 0xC0) != 0x80)
+			return 0xFFFD;
+		codepoint = (codepoint << 6) | (next & 0x3F);
+		++it;
+	}
+	return codepoint;
+}
+
+struct shaped_glyph
+{
+	uint32_t cell;
+	uint32_t generation;
+	// pixeles desde la esquina superior izquierda del texto
+	float x0, y0, x1, y1;
+};
+
+struct shaped_run
+{
+	std::string text;
+	unsigned int font = 0;
+	unsigned int size = 0;
+	float width = 0.0f;
+	float height = 0.0f;
+	uint64_t last_used = 0;
+	// falto algun glifo por atlas lleno: se reintenta
+	bool complete = true;
+	// ordenados por pagina
+	std::vector<shaped_glyph> glyphs;
+	std::vector<unsigned int> page_glyphs;
+};
+
+class text_renderer
+{
+public:
+	/*
+	max_runs: shaped runs kept in the cache; above it the runs not used
+	in the last frame are dropped in begin_frame().
+	*/
+	explicit text_renderer(const atlas_options& options = atlas_options(), size_t max_runs = 4096)
+		: _atlas(options)
+		, _max_runs(max_runs)
+		, _program(0)
+		, _glyphs(0)
+		, _hits(0)
+		, _misses(0)
+	{
+		_page_glyphs.resize(options.max_pages, 0);
+		for (unsigned int i = 0; i < options.max_pages; ++i)
+			_geometry.emplace_back(std::make_unique<DynamicGeometryElement<ElementsBuffer> >());
+		_program = create_program();
+		if (_program)
+		{
+			_mvp_location = glGetUniformLocation(_program, "mvp");
+			_atlas_location = glGetUniformLocation(_program, "atlas");
+		}
+	}
+
+	~text_renderer()
+	{
+		if (_program)
+			glDeleteProgram(_program);
+	}
+
+	text_renderer(const text_renderer&) = delete;
+	text_renderer& operator=(const text_renderer&) = delete;
+
+	glyph_atlas& atlas() { return _atlas; }
+
+	void begin_frame()
+	{
+		_atlas.begin_frame();
+		_commands.clear();
+		std::fill(_page_glyphs.begin(), _page_glyphs.end(), 0);
+		_glyphs = 0;
+		if (_runs.size() > _max_runs)
+		{
+			uint64_t frame = _atlas.frame();
+			for (auto it = _runs.begin(); it != _runs.end(); )
+			{
+				if (it->second.last_used + 1 < frame)
+					it = _runs.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+
+	/*
+	x, y: top left corner of the first line, in pixels. '\n' starts a
+	new line. The text is copied only the first time it is shaped.
+	*/
+	void draw(unsigned int font, unsigned int size, float x, float y, const char* text, size_t length, const unsigned char color[4])
+	{
+		submit(shape(font, size, text, length), x, y, color);
+	}
+
+	/*
+	Like draw(), but the run is kept in slot (0, 1, 2... one per widget)
+	instead of in the cache by content. Once its buffers have grown to the
+	longest text, a new string every frame does not allocate.
+	*/
+	void draw_slot(unsigned int slot, unsigned int font, unsigned int size, float x, float y, const char* text, size_t length, const unsigned char color[4])
+	{
+		// deque: crecer no mueve los runs ya apuntados por _commands
+		if (slot >= _slots.size())
+			_slots.resize(slot + 1);
+		shaped_run& run = _slots[slot];
+		reshape(run, font, size, text, length);
+		submit(run, x, y, color);
+	}
+
+	void draw_slot(unsigned int slot, unsigned int font, unsigned int size, float x, float y, const char* text, const unsigned char color[4])
+	{
+		draw_slot(slot, font, size, x, y, text, std::strlen(text), color);
+	}
+
+	void draw(unsigned int font, unsigned int size, float x, float y, const std::string& text, const unsigned char color[4])
+	{
+		draw(font, size, x, y, text.data(), text.size(), color);
+	}
+
+	void draw(unsigned int font, unsigned int size, float x, float y, const char* text, const unsigned char color[4])
+	{
+		draw(font, size, x, y, text, std::strlen(text), color);
+	}
+
+	void measure(unsigned int font, unsigned int size, const std::string& text, float& width, float& height)
+	{
+		const shaped_run& run = shape(font, size, text.data(), text.size());
+		width = run.width;
+		height = run.height;
+	}
+
+	// escribe los quads de todo el frame, un lote por pagina
+	void end_frame()
+	{
+		for (size_t p = 0; p < _geometry.size(); ++p)
+			_geometry[p]->begin_batch(_page_glyphs[p] * 4, _page_glyphs[p] * 6);
+
+		for (const command& c : _commands)
+		{
+			const std::vector<shaped_glyph>& glyphs = c.run->glyphs;
+			size_t i = 0;
+			for (size_t p = 0; p < c.run->page_glyphs.size(); ++p)
+			{
+				unsigned int count = c.run->page_glyphs[p];
+				if (!count)
+					continue;
+				DynamicGeometryElement<ElementsBuffer>& geometry = *_geometry[p];
+				span<ElementsBuffer> vertices = geometry.reserve_vertices(count * 4);
+				span<GLuint> indexes = geometry.reserve_indexes(count * 6);
+				if (vertices.empty() || indexes.empty())
+				{
+					// el run ha cambiado despues de contarlo (colision de hash)
+					i += count;
+					continue;
+				}
+				ElementsBuffer* v = vertices.data;
+				GLuint* index = indexes.data;
+				GLuint base = vertices.first;
+				for (unsigned int n = 0; n < count; ++n, ++i)
+				{
+					const shaped_glyph& g = glyphs[i];
+					const atlas_glyph& a = _atlas.glyph(g.cell);
+					write_vertex(*v++, c.x + g.x0, c.y + g.y0, a.u0, a.v0, c.color);
+					write_vertex(*v++, c.x + g.x1, c.y + g.y0, a.u1, a.v0, c.color);
+					write_vertex(*v++, c.x + g.x1, c.y + g.y1, a.u1, a.v1, c.color);
+					write_vertex(*v++, c.x + g.x0, c.y + g.y1, a.u0, a.v1, c.color);
+					*index++ = base;
+					*index++ = base + 1;
+					*index++ = base + 2;
+					*index++ = base;
+					*index++ = base + 2;
+					*index++ = base + 3;
+					base += 4;
+				}
+			}
+		}
+
+		for (auto& geometry : _geometry)
+			geometry->end_batch();
+	}
+
+	// mvp: matriz 4x4 por columnas (ortografica en pixeles)
+	void render(const float mvp[16])
+	{
+		if (!_program || !_glyphs)
+			return;
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glUseProgram(_program);
+		glUniformMatrix4fv(_mvp_location, 1, GL_FALSE, mvp);
+		glUniform1i(_atlas_location, 0);
+		glActiveTexture(GL_TEXTURE0);
+		for (size_t p = 0; p < _atlas.pages(); ++p)
+		{
+			if (!_page_glyphs[p])
+				continue;
+			glBindTexture(GL_TEXTURE_2D, _atlas.texture((unsigned int)p));
+			_geometry[p]->flush();
+			_geometry[p]->render();
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glUseProgram(0);
+		glDisable(GL_BLEND);
+	}
+
+	// estadisticas
+	inline size_t glyphs() const { return _glyphs; }
+	inline size_t runs() const { return _runs.size(); }
+	inline size_t hits() const { return _hits; }
+	inline size_t misses() const { return _misses; }
+
+protected:
+	struct run_key
+	{
+		uint64_t hash;
+		unsigned int font;
+		unsigned int size;
+
+		bool operator==(const run_key& other) const
+		{
+			return hash == other.hash && font == other.font && size == other.size;
+		}
+	};
+
+	struct run_key_hash
+	{
+		size_t operator()(const run_key& key) const
+		{
+			return (size_t)(key.hash ^ ((uint64_t)key.font << 48) ^ ((uint64_t)key.size << 32));
+		}
+	};
+
+	struct command
+	{
+		const shaped_run* run;
+		float x, y;
+		unsigned char color[4];
+	};
+
+	// FNV-1a
+	static uint64_t hash_text(const char* text, size_t length)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash ^= (unsigned char)text[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void submit(const shaped_run& run, float x, float y, const unsigned char color[4])
+	{
+		if (run.glyphs.empty())
+			return;
+		command c;
+		c.run = &run;
+		c.x = x;
+		c.y = y;
+		std::copy(color, color + 4, c.color);
+		_commands.push_back(c);
+		for (size_t p = 0; p < run.page_glyphs.size(); ++p)
+			_page_glyphs[p] += run.page_glyphs[p];
+		_glyphs += run.glyphs.size();
+	}
+
+	const shaped_run& shape(unsigned int font, unsigned int size, const char* text, size_t length)
+	{
+		run_key key{hash_text(text, length), font, size};
+		shaped_run& run = _runs[key];
+		reshape(run, font, size, text, length);
+		return run;
+	}
+
+	// vuelve a formar run si no es ese texto o le han expulsado glifos
+	void reshape(shaped_run& run, unsigned int font, unsigned int size, const char* text, size_t length)
+	{
+		bool valid = run.font == font && run.size == size && run.complete && run.text.size() == length &&
+					 std::equal(text, text + length, run.text.begin());
+		if (valid)
+		{
+			// algun glifo expulsado del atlas desde que se formo?
+			for (const shaped_glyph& g : run.glyphs)
+			{
+				if (_atlas.glyph(g.cell).generation != g.generation)
+				{
+					valid = false;
+					break;
+				}
+				_atlas.touch(g.cell);
+			}
+		}
+		if (valid)
+		{
+			++_hits;
+		}
+		else
+		{
+			++_misses;
+			run.text.assign(text, length);
+			run.font = font;
+			run.size = size;
+			layout(run);
+		}
+		run.last_used = _atlas.frame();
+	}
+
+	void layout(shaped_run& run)
+	{
+		glyph_rasterizer& rasterizer = _atlas.font(run.font);
+		float size = (float)run.size;
+		float ascender = rasterizer.ascender(run.size);
+		float line_height = rasterizer.line_height(run.size);
+		float pen_x = 0.0f;
+		float baseline = ascender;
+		uint32_t previous = 0;
+
+		run.glyphs.clear();
+		run.width = 0.0f;
+		size_t dropped = _atlas.dropped();
+		const char* it = run.text.data();
+		const char* end = it + run.text.size();
+		while (it < end)
+		{
+			uint32_t codepoint = utf8_next(it, end);
+			if (codepoint == '\n')
+			{
+				pen_x = 0.0f;
+				baseline += line_height;
+				previous = 0;
+				continue;
+			}
+			uint32_t cell = _atlas.find(run.font, codepoint);
+			if (cell == glyph_atlas::no_glyph && codepoint != '?' && _atlas.dropped() == dropped)
+			{
+				// la fuente no lo tiene (no es que el atlas este lleno)
+				cell = _atlas.find(run.font, '?');
+			}
+			if (cell == glyph_atlas::no_glyph)
+				continue;
+			if (previous)
+				pen_x += rasterizer.kerning(previous, codepoint, run.size);
+			previous = codepoint;
+
+			const atlas_glyph& g = _atlas.glyph(cell);
+			if (!g.empty)
+			{
+				shaped_glyph s;
+				s.cell = cell;
+				s.generation = g.generation;
+				s.x0 = pen_x + g.x0 * size;
+				s.y0 = baseline + g.y0 * size;
+				s.x1 = pen_x + g.x1 * size;
+				s.y1 = baseline + g.y1 * size;
+				run.glyphs.push_back(s);
+			}
+			pen_x += g.advance * size;
+			run.width = std::max(run.width, pen_x);
+		}
+		run.height = baseline - ascender + line_height;
+		run.complete = _atlas.dropped() == dropped;
+
+		// un tramo por pagina al escribir los quads
+		std::stable_sort(run.glyphs.begin(), run.glyphs.end(), [this](const shaped_glyph& a, const shaped_glyph& b) {
+			return _atlas.page_of(a.cell) < _atlas.page_of(b.cell);
+		});
+		run.page_glyphs.assign(_page_glyphs.size(), 0);
+		for (const shaped_glyph& g : run.glyphs)
+			++run.page_glyphs[_atlas.page_of(g.cell)];
+	}
+
+	static inline void write_vertex(ElementsBuffer& v, float x, float y, float u, float t, const unsigned char color[4])
+	{
+		v.position[0] = x;
+		v.position[1] = y;
+		v.position[2] = 0.0f;
+		v.coord[0] = u;
+		v.coord[1] = t;
+		v.color[0] = color[0];
+		v.color[1] = color[1];
+		v.color[2] = color[2];
+		v.color[3] = color[3];
+	}
+
+	static GLuint compile_shader(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char error_log[1024];
+			glGetShaderInfoLog(shader, sizeof(error_log), NULL, error_log);
+			LOGE("Error compiling text shader: '%s'", error_log);
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	static GLuint create_program()
+	{
+		// el color de ElementsBuffer llega sin normalizar (0..255)
+		const char* vertex_source =
+			"#version 330\n"
+			"in vec3 position;\n"
+			"in vec2 coord;\n"
+			"in vec4 color;\n"
+			"uniform mat4 mvp;\n"
+			"out vec2 v_coord;\n"
+			"out vec4 v_color;\n"
+			"void main()\n"
+			"{\n"
+			"	v_coord = coord;\n"
+			"	v_color = color / 255.0;\n"
+			"	gl_Position = mvp * vec4(position, 1.0);\n"
+			"}\n";
+		// borde en 0.5; el ancho del suavizado sigue a la escala en pantalla
+		const char* fragment_source =
+			"#version 330\n"
+			"uniform sampler2D atlas;\n"
+			"in vec2 v_coord;\n"
+			"in vec4 v_color;\n"
+			"out vec4 FragColor;\n"
+			"void main()\n"
+			"{\n"
+			"	float d = texture(atlas, v_coord).r;\n"
+			"	float w = max(fwidth(d) * 0.75, 0.0001);\n"
+			"	FragColor = vec4(v_color.rgb, v_color.a * smoothstep(0.5 - w, 0.5 + w, d));\n"
+			"}\n";
+
+		GLuint vertex = compile_shader(GL_VERTEX_SHADER, vertex_source);
+		GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+		if (!vertex || !fragment)
+		{
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			return 0;
+		}
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glBindAttribLocation(program, AttribPosition, "position");
+		glBindAttribLocation(program, AttribCoord, "coord");
+		glBindAttribLocation(program, AttribColor, "color");
+		glBindFragDataLocation(program, 0, "FragColor");
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char error_log[1024];
+			glGetProgramInfoLog(program, sizeof(error_log), NULL, error_log);
+			LOGE("Error linking text shader: '%s'", error_log);
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+protected:
+	glyph_atlas _atlas;
+	size_t _max_runs;
+	std::unordered_map<run_key, shaped_run, run_key_hash> _runs;
+	// runs de draw_slot
+	std::deque<shaped_run> _slots;
+	std::vector<command> _commands;
+	std::vector<unsigned int> _page_glyphs;
+	std::vector<std::unique_ptr<DynamicGeometryElement<ElementsBuffer> > > _geometry;
+	GLuint _program;
+	GLint _mvp_location;
+	GLint _atlas_location;
+	size_t _glyphs;
+	size_t _hits;
+	size_t _misses;
+};
+
+} // end namespace dune
+
+#endif // TEXTRENDERER_H
@@ -0,0 +1,53 @@
+/**
+@file UniformCache.h
+
+Cache of uniform locations of a program by name. Only found uniforms are
+stored: a name that does not exist asks GL every time (it is usually a
+typo or a uniform the compiler removed, and the program can change).
+Header only and without more dependencies than GL, so the benchmarks
+measure the same lookup Shader uses.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef UNIFORMCACHE_H
+#define UNIFORMCACHE_H
+
+#include <map>
+#include <string>
+#include <GL/glew.h>
+
+namespace dune {
+
+class uniform_cache
+{
+public:
+	// -1 si el programa no tiene ese uniform
+	int get(GLuint program, const std::string& name)
+	{
+		// una sola busqueda en el acierto
+		auto it = _locations.find(name);
+		if (it != _locations.end())
+			return it->second;
+		int location = glGetUniformLocation(program, name.c_str());
+		if (location > -1)
+			_locations.emplace(name, location);
+		return location;
+	}
+
+	// al cambiar de programa las localizaciones ya no valen
+	void clear()
+	{
+		_locations.clear();
+	}
+
+	size_t size() const { return _locations.size(); }
+
+protected:
+	std::map<std::string, int> _locations;
+};
+
+} // end namespace dune
+
+#endif // UNIFORMCACHE_H
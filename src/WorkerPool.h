@@ -0,0 +1,146 @@
+/**
+@file WorkerPool.h
+
+Fixed pool of worker threads: fire and forget jobs and blocking parallel_for.
+
+@author Ricardo Marmolejo García
+@date 19/10/26
+*/
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+namespace dune {
+
+class worker_pool
+{
+public:
+	explicit worker_pool(unsigned int num_workers = 0)
+		: _stop(false)
+	{
+		if (num_workers == 0)
+		{
+			// puede devolver 0 (desconocido)
+			unsigned int hc = std::thread::hardware_concurrency();
+			num_workers = hc > 1 ? hc - 1 : 1;
+		}
+		for (unsigned int i = 0; i < num_workers; ++i)
+			_workers.emplace_back([this]() { loop(); });
+	}
+
+	~worker_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_cond.notify_all();
+		for (auto& worker : _workers)
+			worker.join();
+	}
+
+	worker_pool(const worker_pool&) = delete;
+	worker_pool& operator=(const worker_pool&) = delete;
+
+	unsigned int size() const
+	{
+		return (unsigned int)_workers.size();
+	}
+
+	void submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.emplace_back(std::move(job));
+		}
+		_cond.notify_one();
+	}
+
+	/*
+	Runs func(i) for i in [0, count). The calling thread also works,
+	returns when all are finished.
+	*/
+	template <typename F>
+	void parallel_for(unsigned int count, F&& func)
+	{
+		if (count == 0)
+			return;
+		if (count == 1)
+		{
+			func(0u);
+			return;
+		}
+
+		// estado compartido: un helper que arranca tarde no toca la pila del llamante
+		struct state
+		{
+			std::atomic<unsigned int> next{0};
+			std::atomic<unsigned int> done{0};
+			std::mutex mutex;
+			std::condition_variable cond;
+		};
+		auto shared = std::make_shared<state>();
+		std::function<void(unsigned int)> body(std::ref(func));
+
+		auto work = [shared, body, count]() {
+			unsigned int finished = 0;
+			for (unsigned int i = shared->next++; i < count; i = shared->next++)
+			{
+				body(i);
+				++finished;
+			}
+			if (finished > 0 && (shared->done += finished) == count)
+			{
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				shared->cond.notify_one();
+			}
+		};
+
+		unsigned int helpers = std::min(count - 1, size());
+		for (unsigned int i = 0; i < helpers; ++i)
+			submit(work);
+		work();
+
+		std::unique_lock<std::mutex> lock(shared->mutex);
+		shared->cond.wait(lock, [&]() { return shared->done.load() == count; });
+	}
+
+protected:
+	void loop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cond.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+				if (_stop && _jobs.empty())
+					return;
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+protected:
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()> > _jobs;
+	std::mutex _mutex;
+	std::condition_variable _cond;
+	bool _stop;
+};
+
+} // end namespace dune
+
+#endif // WORKERPOOL_H
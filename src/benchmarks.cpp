@@ -0,0 +1,340 @@
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <benchmark/benchmark.h>
+#include <cppunix/parallel_scheduler.h>
+#include <fast-event-system/sync.h>
+#include <OIS/OIS.h>
+#include <GL/glew.h>
+#include "GeometryElement.h"
+#include "UniformCache.h"
+#define DUNE_ALLOC_HOOKS
+#include "AllocTracker.h"
+
+// Micro-benchmarks de los caminos calientes de CPU (sin contexto GL).
+//
+//	benchmarks [--benchmark_filter=...] [--save-baseline <file>] [--baseline <file>] [--threshold <pct>]
+//
+// --save-baseline guarda el tiempo de CPU por iteracion de cada benchmark,
+// --baseline compara contra ese fichero y sale con 1 si alguno es mas lento
+// que el umbral (10% por defecto).
+// Cada benchmark hace una iteracion de calentamiento y cuenta las reservas
+// de memoria de las siguientes (allocs, media por iteracion); con
+// --steady-state falla el que reserve algo despues del calentamiento.
+// BM_scheduler_spawn_yield crea un scheduler por iteracion: sus reservas
+// son parte de lo que mide y van en setup_allocs, fuera de la comprobacion.
+
+// GL falso: glGetUniformLocation sin contexto (puntero de GLEW)
+static std::vector<std::string> mock_uniforms;
+static unsigned long mock_gl_calls = 0;
+
+static GLint GLAPIENTRY mock_get_uniform_location(GLuint, const GLchar* name)
+{
+	++mock_gl_calls;
+	for (size_t i = 0; i < mock_uniforms.size(); ++i)
+	{
+		if (mock_uniforms[i] == name)
+			return (GLint)i;
+	}
+	return -1;
+}
+
+static void install_gl_mocks()
+{
+	glGetUniformLocation = mock_get_uniform_location;
+}
+
+// reservas por iteracion desde before (contador del hilo, tomado despues del calentamiento)
+static void count_allocations(benchmark::State& state, uint64_t before, const char* counter = "allocs")
+{
+	state.counters[counter] = benchmark::Counter((double)(dune::thread_allocations().allocations - before), benchmark::Counter::kAvgIterations);
+}
+
+static std::string uniform_name(int i)
+{
+	return "u_parameter_" + std::to_string(i);
+}
+
+// fes::sync: coste de entregar un evento de teclado a N listeners (como input_system)
+static void BM_sync_dispatch(benchmark::State& state)
+{
+	fes::sync<OIS::KeyEvent> key_pressed;
+	int received = 0;
+	for (int i = 0; i < state.range(0); ++i)
+	{
+		key_pressed.connect([&](auto& event) {
+			received += (int)event.key;
+		});
+	}
+	OIS::KeyEvent event(nullptr, OIS::KC_A, 0);
+	key_pressed(event);
+	uint64_t allocs = dune::thread_allocations().allocations;
+	for (auto _ : state)
+	{
+		key_pressed(event);
+	}
+	count_allocations(state, allocs);
+	benchmark::DoNotOptimize(received);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sync_dispatch)->Arg(1)->Arg(8)->Arg(64);
+
+// uniform_cache (Shader::getParameter) con N uniforms ya cacheados (acierto en el map)
+static void BM_shader_get_parameter_hit(benchmark::State& state)
+{
+	mock_uniforms.clear();
+	for (int i = 0; i < state.range(0); ++i)
+		mock_uniforms.push_back(uniform_name(i));
+	dune::uniform_cache cache;
+	for (const std::string& name : mock_uniforms)
+		cache.get(1, name);
+	const std::string name = uniform_name((int)state.range(0) / 2);
+	cache.get(1, name);
+	uint64_t allocs = dune::thread_allocations().allocations;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(cache.get(1, name));
+	}
+	count_allocations(state, allocs);
+}
+BENCHMARK(BM_shader_get_parameter_hit)->Arg(4)->Arg(32)->Arg(256);
+
+// uniform que no existe: no se cachea, cada llamada va a GL
+static void BM_shader_get_parameter_miss(benchmark::State& state)
+{
+	mock_uniforms.clear();
+	for (int i = 0; i < state.range(0); ++i)
+		mock_uniforms.push_back(uniform_name(i));
+	dune::uniform_cache cache;
+	for (const std::string& name : mock_uniforms)
+		cache.get(1, name);
+	const std::string name = "u_missing";
+	cache.get(1, name);
+	unsigned long calls = mock_gl_calls;
+	uint64_t allocs = dune::thread_allocations().allocations;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(cache.get(1, name));
+	}
+	count_allocations(state, allocs);
+	state.counters["gl_calls"] = benchmark::Counter((double)(mock_gl_calls - calls), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_shader_get_parameter_miss)->Arg(4)->Arg(32)->Arg(256);
+
+// DynamicGeometryArray::AddVert de N vertices (sin flush, no toca GL)
+static void BM_geometry_add_vert(benchmark::State& state)
+{
+	dune::DynamicGeometryArray<dune::ElementsBuffer> geometry;
+	dune::ElementsBuffer vertex = {};
+	auto fill = [&]() {
+		geometry.clear_vertices();
+		for (int i = 0; i < state.range(0); ++i)
+		{
+			vertex.position[0] = (float)i;
+			geometry.AddVert(vertex);
+		}
+	};
+	// el vector crece hasta su capacidad final
+	fill();
+	uint64_t allocs = dune::thread_allocations().allocations;
+	for (auto _ : state)
+	{
+		fill();
+	}
+	count_allocations(state, allocs);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_geometry_add_vert)->Arg(1 << 10)->Arg(1 << 16);
+
+// lo mismo por el camino de emision en bloque
+static void BM_geometry_reserve_vertices(benchmark::State& state)
+{
+	dune::DynamicGeometryArray<dune::ElementsBuffer> geometry;
+	dune::ElementsBuffer vertex = {};
+	auto fill = [&]() {
+		geometry.begin_batch((unsigned int)state.range(0));
+		dune::span<dune::ElementsBuffer> vertices = geometry.reserve_vertices((unsigned int)state.range(0));
+		for (int i = 0; i < state.range(0); ++i)
+		{
+			vertex.position[0] = (float)i;
+			vertices[i] = vertex;
+		}
+		geometry.end_batch();
+	};
+	// la arena propia se reserva en el primer lote
+	fill();
+	uint64_t allocs = dune::thread_allocations().allocations;
+	for (auto _ : state)
+	{
+		fill();
+	}
+	count_allocations(state, allocs);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_geometry_reserve_vertices)->Arg(1 << 10)->Arg(1 << 16);
+
+// cu::parallel_scheduler: N coroutines que ceden 100 veces cada una
+// (scheduler y pilas nuevos en cada iteracion: reserva por diseno, no cuenta para --steady-state)
+static void BM_scheduler_spawn_yield(benchmark::State& state)
+{
+	const int yields = 100;
+	auto run = [&]() {
+		cu::parallel_scheduler sch;
+		for (int i = 0; i < state.range(0); ++i)
+		{
+			sch.spawn([&](auto& yield) {
+				for (int j = 0; j < yields; ++j)
+					yield( {} );
+			});
+		}
+		sch.run_until_complete();
+	};
+	run();
+	uint64_t allocs = dune::thread_allocations().allocations;
+	for (auto _ : state)
+	{
+		run();
+	}
+	count_allocations(state, allocs, "setup_allocs");
+	state.SetItemsProcessed(state.iterations() * state.range(0) * yields);
+}
+BENCHMARK(BM_scheduler_spawn_yield)->Arg(2)->Arg(16)->Arg(128);
+
+// recoge el tiempo de CPU por iteracion (ns) de cada run ademas de pintarlo
+class baseline_reporter : public benchmark::ConsoleReporter
+{
+public:
+	void ReportRuns(const std::vector<Run>& reports) override
+	{
+		for (const Run& run : reports)
+		{
+			if (run.error_occurred || run.run_type != Run::RT_Iteration)
+				continue;
+			results[run.benchmark_name()] = run.GetAdjustedCPUTime() / benchmark::GetTimeUnitMultiplier(run.time_unit) * 1e9;
+			// cualquier reserva despues del calentamiento
+			auto allocs = run.counters.find("allocs");
+			if (allocs != run.counters.end() && allocs->second.value > 0.0)
+				allocating.push_back(run.benchmark_name());
+		}
+		benchmark::ConsoleReporter::ReportRuns(reports);
+	}
+
+public:
+	std::map<std::string, double> results;
+	// reservan memoria despues del calentamiento
+	std::vector<std::string> allocating;
+};
+
+// una linea por benchmark: <nombre> <ns por iteracion>
+static bool load_baseline(const std::string& file, std::map<std::string, double>& baseline)
+{
+	std::ifstream in(file);
+	if (!in)
+		return false;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		std::string name;
+		double ns;
+		if (fields >> name >> ns)
+			baseline[name] = ns;
+	}
+	return true;
+}
+
+static bool save_baseline(const std::string& file, const std::map<std::string, double>& results)
+{
+	std::ofstream out(file);
+	if (!out)
+		return false;
+	for (const auto& result : results)
+		out << result.first << " " << result.second << "\n";
+	return (bool)out;
+}
+
+int main(int argc, char** argv)
+{
+	std::string baseline_file;
+	std::string save_file;
+	double threshold = 10.0;
+	bool steady_state = false;
+	// los argumentos propios se quitan antes de pasarlos a benchmark
+	std::vector<char*> args;
+	for (int i = 0; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--baseline" && i + 1 < argc)
+			baseline_file = argv[++i];
+		else if (arg == "--save-baseline" && i + 1 < argc)
+			save_file = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc)
+			threshold = std::atof(argv[++i]);
+		else if (arg == "--steady-state")
+			steady_state = true;
+		else
+			args.push_back(argv[i]);
+	}
+	int num_args = (int)args.size();
+	benchmark::Initialize(&num_args, args.data());
+	if (benchmark::ReportUnrecognizedArguments(num_args, args.data()))
+		return 1;
+
+	install_gl_mocks();
+	baseline_reporter reporter;
+	benchmark::RunSpecifiedBenchmarks(&reporter);
+	benchmark::Shutdown();
+
+	int status = 0;
+	if (steady_state)
+	{
+		for (const std::string& name : reporter.allocating)
+			std::printf("%s allocates in steady state\n", name.c_str());
+		status = reporter.allocating.empty() ? 0 : 1;
+	}
+
+	if (!save_file.empty())
+	{
+		if (!save_baseline(save_file, reporter.results))
+		{
+			std::fprintf(stderr, "Can't write baseline: %s\n", save_file.c_str());
+			return 1;
+		}
+		std::printf("Baseline saved: %s (%zu benchmarks)\n", save_file.c_str(), reporter.results.size());
+	}
+
+	if (baseline_file.empty())
+		return status;
+
+	std::map<std::string, double> baseline;
+	if (!load_baseline(baseline_file, baseline))
+	{
+		std::fprintf(stderr, "Can't read baseline: %s\n", baseline_file.c_str());
+		return 1;
+	}
+	int regressions = 0;
+	std::printf("\n%-44s %12s %12s %9s\n", "Benchmark", "Baseline ns", "Current ns", "Change");
+	for (const auto& result : reporter.results)
+	{
+		auto it = baseline.find(result.first);
+		if (it == baseline.end() || it->second <= 0.0)
+		{
+			std::printf("%-44s %12s %12.1f %9s\n", result.first.c_str(), "-", result.second, "new");
+			continue;
+		}
+		double change = (result.second - it->second) / it->second * 100.0;
+		bool regression = change > threshold;
+		regressions += regression ? 1 : 0;
+		std::printf("%-44s %12.1f %12.1f %+8.1f%%%s\n", result.first.c_str(), it->second, result.second, change, regression ? "  REGRESSION" : "");
+	}
+	if (regressions)
+	{
+		std::printf("%d benchmarks slower than the baseline by more than %.1f%%\n", regressions, threshold);
+		return 1;
+	}
+	return status;
+}
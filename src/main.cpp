@@ -1,5 +1,9 @@
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <SDL2/SDL.h>
 #include <spdlog/spdlog.h>
 #include <cppunix/parallel_scheduler.h>
@@ -22,6 +26,26 @@
 #include <X11/Xlib.h>
 #endif
 #include "GeometryArray.h"
+#include "SpatialIndex.h"
+#include "RenderGraph.h"
+#include "InputQueue.h"
+#include "ActionMap.h"
+#include "InputRecorder.h"
+#include "OffscreenTarget.h"
+#include "FrameCapture.h"
+#include "GoldenImage.h"
+#include "FrameLog.h"
+#include "Telemetry.h"
+#include "StateSync.h"
+#include "TextRenderer.h"
+#include "RetainedUI.h"
+#include "GpuResources.h"
+#include "AssetArchive.h"
+#include "Startup.h"
+#include "FrameScheduler.h"
+// hooks de operator new/delete: solo en este .cpp
+#define DUNE_ALLOC_HOOKS
+#include "AllocTracker.h"
 
 namespace spd = spdlog;
 
@@ -33,18 +57,18 @@ class graphics_system
 public:
 	explicit graphics_system()
 	{
-		spd::get("console")->warn("Iniciando SDL2...");
+		dune::console().warn("Iniciando SDL2...");
 		// if (SDL_Init(SDL_INIT_EVERYTHING) != 0)
 		if (SDL_Init(SDL_INIT_VIDEO) != 0)
 		{
-			spd::get("console")->error("SDL2: {}", SDL_GetError());
+			dune::console().error("SDL2: {}", SDL_GetError());
 			throw std::exception();
 		}
 	}
 
 	~graphics_system()
 	{
-		spd::get("console")->warn("Destruction SDL2 ...");
+		dune::console().warn("Destruction SDL2 ...");
 		SDL_Quit();
 	}
 protected:
@@ -54,32 +78,33 @@ protected:
 class window
 {
 public:
-	explicit window()
+	explicit window(bool headless = false)
 	{
-		spd::get("console")->warn("Create Window...");
+		dune::console().warn("Create Window...");
 
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
+		// headless: ventana oculta del driver offscreen de SDL (EGL sin servidor X)
 		_window = SDL_CreateWindow("helloworld", 8, 22 + 8, SCREEN_WIDTH, SCREEN_HEIGHT,  
 																			SDL_WINDOW_RESIZABLE |
 																			SDL_WINDOW_MOUSE_FOCUS |
 																			SDL_WINDOW_OPENGL |
-																			SDL_WINDOW_SHOWN);
+																			(headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN));
 
 		// _window = SDL_CreateWindow("Hello world", 100, 100, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
 		if (_window == nullptr)
 		{
-			spd::get("console")->error("SDL2: {}", SDL_GetError());
+			dune::console().error("SDL2: {}", SDL_GetError());
 			throw std::exception();
 		}
 	}
 
 	~window()
 	{
-		spd::get("console")->warn("Destruction window ...");
+		dune::console().warn("Destruction window ...");
 		SDL_DestroyWindow(_window);
 	}
 
@@ -102,7 +127,30 @@ public:
 	input_system(const input_system&) = delete;
 	input_system& operator=(const input_system&) = delete;
 
+	// captura los dispositivos (encola los eventos)
 	void update();
+	// captura en un hilo propio a hz capturas por segundo
+	void start_capture(int hz = 1000);
+	void stop_capture();
+	bool is_capturing() const { return _capturing; }
+	// entrega en bloque los eventos encolados (desde el paso de simulacion)
+	void dispatch();
+	// peor latencia captura -> entrega desde la ultima llamada; false si no se ha entregado nada
+	bool take_latency(uint64_t& latency_ns)
+	{
+		if (!_latency_samples)
+		{
+			return false;
+		}
+		latency_ns = _max_latency_ns;
+		_latency_samples = 0;
+		_max_latency_ns = 0;
+		return true;
+	}
+	// graba lo que se entrega / entrega lo grabado en vez de los dispositivos
+	void set_recorder(dune::input_recorder* recorder) { _recorder = recorder; }
+	void set_player(dune::input_player* player) { _player = player; }
+	uint64_t frame() const { return _frame; }
 
 	// events to notify
 	bool keyPressed(const OIS::KeyEvent &arg) override;
@@ -131,6 +179,11 @@ public:
 	fes::sync<OIS::JoyStickEvent, int> pov_moved;
 	fes::sync<OIS::JoyStickEvent, int> vector3_moved;
 protected:
+	void push(const dune::input_event& event);
+	void deliver(const dune::input_event& event);
+	static dune::input_event make_event(dune::input_event_type type, int code);
+	static void fill_mouse(dune::input_event& event, const OIS::MouseState& state);
+
 	SDL_Window* _window;
 	OIS::InputManager* _input_manager = 0;
 	OIS::Keyboard* _keyboard  = 0;
@@ -140,6 +193,20 @@ protected:
 	int _width;
 	int _height;
 	long long _hwnd;
+
+	dune::spsc_ring<dune::input_event, 4096> _events;
+	std::thread _capture_thread;
+	std::atomic<bool> _capturing;
+	// estado para reconstruir eventos de joystick al entregar
+	OIS::JoyStickState _joy_state;
+	OIS::MouseState _mouse_state;
+	uint64_t _max_latency_ns;
+	unsigned int _latency_samples;
+
+	dune::input_recorder* _recorder = nullptr;
+	dune::input_player* _player = nullptr;
+	// num de dispatch() (un paso de simulacion)
+	uint64_t _frame = 0;
 };
 
 
@@ -149,22 +216,44 @@ class texture;
 class renderer
 {
 public:
-	explicit renderer()
+	// solo la ventana: el contexto y el input se crean despues (create_context, create_input)
+	explicit renderer(bool headless = false)
+		: _context(nullptr)
+		, _w(headless)
+		, _headless(headless)
 	{
-		spd::get("console")->warn("Create renderer...");
+		dune::console().warn("Create renderer...");
+	}
+
+	~renderer()
+	{
+		dune::console().warn("Destruction renderer ...");
+		// SDL_DestroyRenderer(_renderer);
+	}
 
-		SDL_SysWMinfo system_info;
-		SDL_VERSION(&system_info.version);
-		SDL_GetWindowWMInfo(_w.get(), &system_info);
-		Display* window_handler = system_info.info.x11.display;
+	// hilo principal
+	void create_context()
+	{
 		_context = SDL_GL_CreateContext(_w.get());
+		if (_context == nullptr)
+		{
+			dune::console().error("SDL2: {}", SDL_GetError());
+			throw std::exception();
+		}
 
 		// http://glew.sourceforge.net/basic.html
 		glewExperimental = GL_TRUE;
 		GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+		// GLEW compilado para GLX con un contexto EGL: las funciones ya estan cargadas
+		if (_headless && status == GLEW_ERROR_NO_GLX_DISPLAY)
+		{
+			status = GLEW_OK;
+		}
+#endif
 		if (status != GLEW_OK)
 		{
-			spd::get("console")->error("SDL2: {}", glewGetErrorString(status));
+			dune::console().error("SDL2: {}", glewGetErrorString(status));
 			throw std::exception();
 		}
 
@@ -173,17 +262,26 @@ public:
 
 		// _renderer = SDL_CreateRenderer(_w.get(), -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 		// if (_renderer == nullptr) {
-		// 	spd::get("console")->error("SDL2: {}", SDL_GetError());
+		// 	dune::console().error("SDL2: {}", SDL_GetError());
 		// 	throw std::exception();
 		// }
 
-		_input = std::make_unique<input_system>( _w.get() );
+		if (_headless)
+		{
+			_offscreen = std::make_unique<dune::offscreen_target>(SCREEN_WIDTH, SCREEN_HEIGHT);
+			if (!_offscreen->is_complete())
+			{
+				dune::console().error("Offscreen framebuffer incomplete");
+				throw std::exception();
+			}
+		}
 	}
 
-	~renderer()
+	// enumera los dispositivos; solo necesita la ventana (puede ir en otro hilo)
+	void create_input()
 	{
-		spd::get("console")->warn("Destruction renderer ...");
-		// SDL_DestroyRenderer(_renderer);
+		// sin ventana real no hay dispositivos: el input llega de un replay
+		_input = std::make_unique<input_system>( _headless ? nullptr : _w.get() );
 	}
 
 	// SDL_Renderer* get() const
@@ -201,20 +299,48 @@ public:
 
 	void update()
 	{
-		_input->update();
+		if (!_input->is_capturing())
+		{
+			_input->update();
+		}
 		// SDL_RenderPresent(_renderer);
 	}
 
+	void present()
+	{
+		if (_headless)
+		{
+			glFlush();
+		}
+		else
+		{
+			SDL_GL_SwapWindow(_w.get());
+		}
+	}
+
 	input_system& input()
 	{
 		return *_input;
 	}
 
+	// FBO donde se pinta el frame (0 = ventana)
+	GLuint framebuffer() const
+	{
+		return _offscreen ? _offscreen->fbo() : 0;
+	}
+
+	bool is_headless() const
+	{
+		return _headless;
+	}
+
 protected:
 	// SDL_Renderer* _renderer;
 	SDL_GLContext _context;
 	window _w;
 	std::unique_ptr<input_system> _input;
+	bool _headless;
+	std::unique_ptr<dune::offscreen_target> _offscreen;
 };
 
 class texture
@@ -222,7 +348,7 @@ class texture
 public:
 	explicit texture(renderer& ren, const std::string& file)
 	{
-		spd::get("console")->warn("Load texture...");
+		dune::console().warn("Load texture...");
 		//Load the image
 		// SDL_Surface *loadedImage = SDL_LoadBMP(file.c_str());
 		// //If the loading went ok, convert to texture and return the texture
@@ -231,19 +357,19 @@ public:
 		// 	SDL_FreeSurface(loadedImage);
 		// 	//Make sure converting went ok too
 		// 	if (_image == nullptr){
-		// 		spd::get("console")->error("SDL2: {}", SDL_GetError());
+		// 		dune::console().error("SDL2: {}", SDL_GetError());
 		// 		throw std::exception();
 		// 	}
 		// }
 		// else {
-		// 	spd::get("console")->error("SDL2: {}", SDL_GetError());
+		// 	dune::console().error("SDL2: {}", SDL_GetError());
 		// 	throw std::exception();
 		// }
 	}
 
 	~texture()
 	{
-		spd::get("console")->warn("Destruction texture ...");
+		dune::console().warn("Destruction texture ...");
 		// SDL_DestroyTexture(_image);
 	}
 
@@ -286,8 +412,18 @@ input_system::input_system(SDL_Window* window)
 			, _joystick(nullptr)
 			, _width(SCREEN_WIDTH)
 			, _height(SCREEN_HEIGHT)
+			, _capturing(false)
+			, _max_latency_ns(0)
+			, _latency_samples(0)
 {
-	spd::get("console")->warn("Starting input manager ...");
+	dune::console().warn("Starting input manager ...");
+
+	if (_window == nullptr)
+	{
+		// headless: solo eventos inyectados (replay)
+		dune::console().warn("Input without devices (headless)");
+		return;
+	}
 
 	SDL_SysWMinfo system_info;
 	SDL_VERSION(&system_info.version);
@@ -364,22 +500,35 @@ input_system::input_system(SDL_Window* window)
 				<< "\n\tVector3: " << _joystick->getNumberOfComponents(OIS::OIS_Vector3)
 				<< std::endl;
 			LOGI(ss2.str().c_str());
+
+			// reservado una vez, dispatch() no reserva memoria
+			_joy_state.mButtons.resize(_joystick->getNumberOfComponents(OIS::OIS_Button));
+			_joy_state.mAxes.resize(_joystick->getNumberOfComponents(OIS::OIS_Axis));
+			_joy_state.mVectors.resize(_joystick->getNumberOfComponents(OIS::OIS_Vector3));
 		}
 	}
 	catch(OIS::Exception &ex)
 	{
-		spd::get("console")->error("Exception raised on joystick creation: {}", ex.eText);
+		dune::console().error("Exception raised on joystick creation: {}", ex.eText);
 	}
 }
 
 input_system::~input_system()
 {
-	spd::get("console")->warn("Destruction input manager ...");
-	OIS::InputManager::destroyInputSystem(_input_manager);
+	dune::console().warn("Destruction input manager ...");
+	stop_capture();
+	if (_input_manager)
+	{
+		OIS::InputManager::destroyInputSystem(_input_manager);
+	}
 }
 
 void input_system::update()
 {
+	if (!_keyboard)
+	{
+		return;
+	}
 	_keyboard->capture();
 #ifdef _Win32
 	_mouse->capture();
@@ -390,84 +539,263 @@ void input_system::update()
 	}
 }
 
+void input_system::start_capture(int hz)
+{
+	if (_capturing || !_keyboard)
+		return;
+	// minimo 1 Hz (evita dividir por 0)
+	hz = std::max(hz, 1);
+	_capturing = true;
+	_capture_thread = std::thread([this, hz]() {
+		const auto period = std::chrono::nanoseconds(1000000000LL / hz);
+		auto next = std::chrono::steady_clock::now();
+		while (_capturing)
+		{
+			update();
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+	});
+}
+
+void input_system::stop_capture()
+{
+	if (!_capturing)
+		return;
+	_capturing = false;
+	_capture_thread.join();
+}
+
+void input_system::dispatch()
+{
+	if (_player)
+	{
+		// replay: los dispositivos se ignoran
+		_events.drain([](const dune::input_event&) { ; });
+		_player->next_frame(_frame, [&](const dune::input_event& event) {
+			deliver(event);
+		});
+		++_frame;
+		return;
+	}
+
+	// eventos consecutivos fusionables (movimiento de raton / ejes) se entregan como uno
+	dune::input_event pending;
+	bool has_pending = false;
+	_events.drain([&](const dune::input_event& event) {
+		if (has_pending && dune::coalesce(pending, event))
+			return;
+		if (has_pending)
+			deliver(pending);
+		pending = event;
+		has_pending = true;
+	});
+	if (has_pending)
+		deliver(pending);
+	++_frame;
+}
+
+dune::input_event input_system::make_event(dune::input_event_type type, int code)
+{
+	dune::input_event event = {};
+	event.time_ns = dune::input_clock_ns();
+	event.type = type;
+	event.code = code;
+	return event;
+}
+
+void input_system::fill_mouse(dune::input_event& event, const OIS::MouseState& state)
+{
+	event.x = state.X.abs;
+	event.y = state.Y.abs;
+	event.z = state.Z.abs;
+	event.rel_x = state.X.rel;
+	event.rel_y = state.Y.rel;
+	event.rel_z = state.Z.rel;
+	event.buttons = state.buttons;
+}
+
+void input_system::push(const dune::input_event& event)
+{
+	// si el ring esta lleno el evento se pierde (_events.dropped())
+	_events.push(event);
+}
+
+void input_system::deliver(const dune::input_event& event)
+{
+	if (_recorder)
+	{
+		_recorder->record(_frame, event);
+	}
+	if (!_player)
+	{
+		_max_latency_ns = std::max(_max_latency_ns, dune::input_clock_ns() - event.time_ns);
+		++_latency_samples;
+	}
+	switch (event.type)
+	{
+		case dune::input_key_pressed:
+			key_pressed(OIS::KeyEvent(_keyboard, (OIS::KeyCode)event.code, event.text));
+			break;
+		case dune::input_key_released:
+			key_release(OIS::KeyEvent(_keyboard, (OIS::KeyCode)event.code, event.text));
+			break;
+		case dune::input_mouse_moved:
+		case dune::input_mouse_pressed:
+		case dune::input_mouse_released:
+		{
+			_mouse_state.width = _width;
+			_mouse_state.height = _height;
+			_mouse_state.X.abs = event.x;
+			_mouse_state.Y.abs = event.y;
+			_mouse_state.Z.abs = event.z;
+			_mouse_state.X.rel = event.rel_x;
+			_mouse_state.Y.rel = event.rel_y;
+			_mouse_state.Z.rel = event.rel_z;
+			_mouse_state.buttons = event.buttons;
+			OIS::MouseEvent arg(_mouse, _mouse_state);
+			if (event.type == dune::input_mouse_moved)
+				mouse_moved(arg);
+			else if (event.type == dune::input_mouse_pressed)
+				mouse_pressed(arg, (OIS::MouseButtonID)event.code);
+			else
+				mouse_released(arg, (OIS::MouseButtonID)event.code);
+			break;
+		}
+		default:
+		{
+			OIS::JoyStickEvent arg(_joystick, _joy_state);
+			switch (event.type)
+			{
+				case dune::input_joy_button_pressed:
+				case dune::input_joy_button_released:
+				{
+					bool down = (event.type == dune::input_joy_button_pressed);
+					if (event.code >= 0 && event.code < (int)_joy_state.mButtons.size())
+						_joy_state.mButtons[event.code] = down;
+					if (down)
+						button_pressed(arg, event.code);
+					else
+						_buttonReleased(arg, event.code);
+					break;
+				}
+				case dune::input_joy_axis:
+					if (event.code >= 0 && event.code < (int)_joy_state.mAxes.size())
+						_joy_state.mAxes[event.code].abs = event.x;
+					axis_moved(arg, event.code);
+					break;
+				case dune::input_joy_pov:
+					if (event.code >= 0 && event.code < 4)
+						_joy_state.mPOV[event.code].direction = event.x;
+					pov_moved(arg, event.code);
+					break;
+				case dune::input_joy_vector3:
+					if (event.code >= 0 && event.code < (int)_joy_state.mVectors.size())
+					{
+						_joy_state.mVectors[event.code].x = event.vec[0];
+						_joy_state.mVectors[event.code].y = event.vec[1];
+						_joy_state.mVectors[event.code].z = event.vec[2];
+					}
+					vector3_moved(arg, event.code);
+					break;
+				default:
+					break;
+			}
+			break;
+		}
+	}
+}
+
 bool input_system::keyPressed(const OIS::KeyEvent &arg)
 {
-	key_pressed(arg);
+	dune::input_event event = make_event(dune::input_key_pressed, arg.key);
+	event.text = arg.text;
+	push(event);
 	return true;
 }
 
 bool input_system::keyReleased(const OIS::KeyEvent &arg)
 {
-	key_release(arg);
+	dune::input_event event = make_event(dune::input_key_released, arg.key);
+	event.text = arg.text;
+	push(event);
 	return true;
 }
 
 bool input_system::mouseMoved(const OIS::MouseEvent &arg)
 {
-	mouse_moved(arg);
+	dune::input_event event = make_event(dune::input_mouse_moved, 0);
+	fill_mouse(event, arg.state);
+	push(event);
 	return true;
 }
 
 bool input_system::mousePressed(const OIS::MouseEvent &arg, OIS::MouseButtonID id)
 {
-	mouse_pressed(arg, id);
+	dune::input_event event = make_event(dune::input_mouse_pressed, id);
+	fill_mouse(event, arg.state);
+	push(event);
 	return true;
 }
 
 bool input_system::mouseReleased(const OIS::MouseEvent &arg, OIS::MouseButtonID id)
 {
-	mouse_released(arg, id);
+	dune::input_event event = make_event(dune::input_mouse_released, id);
+	fill_mouse(event, arg.state);
+	push(event);
 	return true;
 }
 
 bool input_system::buttonReleased(const OIS::JoyStickEvent &arg, int button)
 {
-	_buttonReleased(arg, button);
+	push(make_event(dune::input_joy_button_released, button));
 	return true;
 }
 
 bool input_system::buttonPressed(const OIS::JoyStickEvent &arg, int button)
 {
-	button_pressed(arg, button);
+	push(make_event(dune::input_joy_button_pressed, button));
 	return true;
 }
 
 bool input_system::axisMoved(const OIS::JoyStickEvent &arg, int axis)
 {
-	axis_moved(arg, axis);
+	dune::input_event event = make_event(dune::input_joy_axis, axis);
+	event.x = arg.state.mAxes[axis].abs;
+	push(event);
 	return true;
 }
 
 bool input_system::povMoved(const OIS::JoyStickEvent &arg, int pov)
 {
-	pov_moved(arg, pov);
+	dune::input_event event = make_event(dune::input_joy_pov, pov);
+	event.x = arg.state.mPOV[pov].direction;
+	push(event);
 	return true;
 }
 
 bool input_system::vector3Moved(const OIS::JoyStickEvent &arg, int index)
 {
-	vector3_moved(arg, index);
+	dune::input_event event = make_event(dune::input_joy_vector3, index);
+	event.vec[0] = arg.state.mVectors[index].x;
+	event.vec[1] = arg.state.mVectors[index].y;
+	event.vec[2] = arg.state.mVectors[index].z;
+	push(event);
 	return true;
 }
 
 int input_system::get_modifier_state()
 {
 	int modifier_state = 0;
+	if (!_keyboard)
+	{
+		return modifier_state;
+	}
 
-	if (_keyboard->isModifierDown(OIS::Keyboard::Ctrl))
-		std::cout << "down ctrl" << std::endl;
-	else
-		std::cout << "up ctrl" << std::endl;
-
-	if (_keyboard->isModifierDown(OIS::Keyboard::Shift))
-		std::cout << "down shift" << std::endl;
-	else
-		std::cout << "up shift" << std::endl;
-
-	if (_keyboard->isModifierDown(OIS::Keyboard::Alt))
-		std::cout << "down alt" << std::endl;
-	else
-		std::cout << "up alt" << std::endl;
+	FRAME_LOGI("modifiers ctrl %d shift %d alt %d",
+				(int)_keyboard->isModifierDown(OIS::Keyboard::Ctrl),
+				(int)_keyboard->isModifierDown(OIS::Keyboard::Shift),
+				(int)_keyboard->isModifierDown(OIS::Keyboard::Alt));
 
 #ifdef _WIN32
 
@@ -509,68 +837,558 @@ int input_system::get_modifier_state()
 
 int main(int argc, char const* argv[])
 {
+	auto process_start = std::chrono::steady_clock::now();
+#if defined(__linux__)
+	// OIS captura desde su propio hilo
+	XInitThreads();
+#endif
+	// cola async preasignada: si se llena se descarta, el que loguea nunca espera
+	spd::set_async_mode(4096, spd::async_overflow_policy::discard_log_msg);
 	auto console = spd::stdout_color_mt("console");
-	spd::get("console")->warn("Starting ...");
+	dune::console().warn("Starting ...");
+	// logs del frame: registros fijos, sin reservas ni bloqueos
+	auto frame_log = std::make_unique<dune::frame_log>(console);
+
+	// --record <file>: graba el input entregado, --replay <file>: lo reproduce
+	// --headless: sin ventana visible ni dispositivos, --frames <n>: sale tras n frames
+	// --capture <frame_%05d.png | out.y4m>: guarda los frames pintados
+	// --scene <file.scene>: ejecuta la escena y compara sus frames con las imagenes de referencia (sale con 1 si no coinciden o falta alguna)
+	// --update-golden: con --scene, reescribe las imagenes de referencia en vez de comparar
+	// --budget-ms <ms>: falla si la media de frame supera el presupuesto
+	// --telemetry <tcp://host:1883>: publica metricas del frame por MQTT (topic dune/telemetry)
+	// --state-publish <tcp://host:1883>: replica la escena, --spectate <tcp://host:1883>: la sigue
+	// --overlay: pinta las metricas del frame en pantalla
+	// --vram-budget <MB>: memoria de GPU a partir de la que se expulsan texturas y mallas
+	// --archive <file.pak>: monta un archivo de assets (se puede repetir, el ultimo gana)
+	// --assets <dir>: los ficheros sueltos de dir tapan a los del archivo (desarrollo)
+	// --pack <out.pak> <dir>: empaqueta dir y sale
+	// --steady-state <frames>: tras <frames> de calentamiento, reservar memoria dentro del frame es un error
+	// --alloc-sample <n>: guarda el sitio de llamada de 1 de cada n reservas y los lista al salir
+	std::string record_file;
+	std::string replay_file;
+	std::string capture_file;
+	std::string scene_file;
+	bool update_golden = false;
+	std::string telemetry_server;
+	std::string state_server;
+	std::string spectate_server;
+	bool headless = false;
+	bool overlay = false;
+	long frames = 0;
+	double budget_ms = 0.0;
+	size_t vram_budget_mb = 512;
+	std::vector<std::string> archive_files;
+	std::string assets_dir;
+	std::string pack_file;
+	std::string pack_dir;
+	long steady_state_frames = -1;
+	unsigned int alloc_sample = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc)
+			record_file = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replay_file = argv[++i];
+		else if (arg == "--headless")
+			headless = true;
+		else if (arg == "--frames" && i + 1 < argc)
+			frames = std::atol(argv[++i]);
+		else if (arg == "--capture" && i + 1 < argc)
+			capture_file = argv[++i];
+		else if (arg == "--scene" && i + 1 < argc)
+			scene_file = argv[++i];
+		else if (arg == "--update-golden")
+			update_golden = true;
+		else if (arg == "--budget-ms" && i + 1 < argc)
+			budget_ms = std::atof(argv[++i]);
+		else if (arg == "--telemetry" && i + 1 < argc)
+			telemetry_server = argv[++i];
+		else if (arg == "--state-publish" && i + 1 < argc)
+			state_server = argv[++i];
+		else if (arg == "--spectate" && i + 1 < argc)
+			spectate_server = argv[++i];
+		else if (arg == "--overlay")
+			overlay = true;
+		else if (arg == "--vram-budget" && i + 1 < argc)
+			vram_budget_mb = (size_t)std::atol(argv[++i]);
+		else if (arg == "--archive" && i + 1 < argc)
+			archive_files.push_back(argv[++i]);
+		else if (arg == "--assets" && i + 1 < argc)
+			assets_dir = argv[++i];
+		else if (arg == "--pack" && i + 2 < argc)
+		{
+			pack_file = argv[++i];
+			pack_dir = argv[++i];
+		}
+		else if (arg == "--steady-state" && i + 1 < argc)
+			steady_state_frames = std::atol(argv[++i]);
+		else if (arg == "--alloc-sample" && i + 1 < argc)
+			alloc_sample = (unsigned int)std::atol(argv[++i]);
+	}
+	if (steady_state_frames >= 0)
+	{
+		dune::allocations().set_steady_state((unsigned int)steady_state_frames);
+	}
+	dune::allocations().sample_every(alloc_sample);
+
+	if (!pack_file.empty())
+	{
+		dune::archive_writer writer;
+		if (!writer.add_directory(pack_dir, true) || !writer.write(pack_file))
+		{
+			dune::console().error("Can't pack {} into {}", pack_dir, pack_file);
+			return 1;
+		}
+		dune::console().info("Packed {} files into {}", writer.size(), pack_file);
+		return 0;
+	}
+
+	dune::golden_scene scene;
+	if (!scene_file.empty())
+	{
+		if (!dune::load_scene(scene_file, scene))
+		{
+			return 1;
+		}
+		// regresion: siempre offscreen y con GL por software (mismo resultado en cualquier maquina)
+		headless = true;
+		frames = scene.frames;
+		if (!scene.replay.empty())
+		{
+			replay_file = scene.replay;
+		}
+		if (budget_ms <= 0.0)
+		{
+			budget_ms = scene.budget_ms;
+		}
+#ifndef _WIN32
+		setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+#endif
+	}
+
+	if (headless)
+	{
+		// driver de video de SDL sin servidor X (contexto EGL)
+		SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen");
+	}
 
 	cu::parallel_scheduler sch;
-	renderer ren;
-	texture tex(ren, "pic.bmp");
+	std::unique_ptr<renderer> ren_ptr;
+	std::unique_ptr<texture> tex;
+	dune::input_recorder recorder;
+	dune::input_player player;
+	{
+		// arranque en paralelo: ventana y contexto GL en este hilo, el resto en workers
+		dune::worker_pool startup_pool(3);
+		dune::startup boot(startup_pool);
+		auto window_stage = boot.add("window", [&]() {
+			ren_ptr = std::make_unique<renderer>(headless);
+			return true;
+		}, {}, true);
+		auto context_stage = boot.add("gl_context", [&]() {
+			ren_ptr->create_context();
+			return true;
+		}, {window_stage}, true);
+		boot.add("input", [&]() {
+			ren_ptr->create_input();
+			return true;
+		}, {window_stage});
+		auto assets_stage = boot.add("assets", [&]() {
+			// un solo mapping en vez de abrir y leer cada fichero
+			for (const std::string& archive_file : archive_files)
+			{
+				if (!dune::assets().mount(archive_file))
+				{
+					dune::console().error("Can't mount asset archive: {}", archive_file);
+					return false;
+				}
+			}
+			if (!assets_dir.empty())
+			{
+				dune::assets().set_loose_root(assets_dir);
+			}
+			return true;
+		});
+		boot.add("replay", [&]() {
+			if (!replay_file.empty() && !player.load(replay_file))
+			{
+				dune::console().error("Can't load input replay: {}", replay_file);
+				return false;
+			}
+			return true;
+		});
+		boot.add("texture", [&]() {
+			tex = std::make_unique<texture>(*ren_ptr, "pic.bmp");
+			return true;
+		}, {context_stage, assets_stage}, true);
+
+		bool ok = boot.run();
+		for (const std::string& line : boot.report())
+		{
+			dune::console().info("startup: {}", line);
+		}
+		if (!ok)
+		{
+			return 1;
+		}
+	}
+	renderer& ren = *ren_ptr;
+
+	if (!record_file.empty())
+	{
+		ren.input().set_recorder(&recorder);
+	}
+	if (!replay_file.empty())
+	{
+		ren.input().set_player(&player);
+	}
 
 	bool exit = false;
+	int status = 0;
 	ren.input().key_pressed.connect([&](auto& event){
-		//
-		spd::get("console")->error("key press: {}", event.key);
-        //
+		FRAME_LOGE("key press: %d", (int)event.key);
 	});
 	ren.input().key_release.connect([&](auto& event){
-		//
-		spd::get("console")->error("key release: {}", event.key);
-		//
-		if (event.key == OIS::KC_ESCAPE)
+		FRAME_LOGE("key release: %d", (int)event.key);
+	});
+
+	// bindings -> acciones
+	dune::action_map actions;
+	int action_exit = actions.add_action("exit");
+	actions.bind_key(OIS::KC_ESCAPE, action_exit);
+	actions.subscribe(action_exit, [&](int, dune::action_edge edge) {
+		if (edge == dune::action_released)
 		{
 			exit = true;
 		}
 	});
+	actions.attach(ren.input());
 		
+	// escena 2D: paredes laterales y la caja que rebota
+	dune::loose_grid world(SCREEN_WIDTH, SCREEN_HEIGHT, 128.0f);
+	int wall_left = world.insert(dune::aabb{{-10.0f, 0.0f, 0.0f}, {0.0f, (float)SCREEN_HEIGHT, 0.0f}});
+	int wall_right = world.insert(dune::aabb{{(float)SCREEN_WIDTH, 0.0f, 0.0f}, {SCREEN_WIDTH + 10.0f, (float)SCREEN_HEIGHT, 0.0f}});
+	auto box_at = [](int x) {
+		return dune::aabb{{(float)x, 20.0f, 0.0f}, {x + 100.0f, 120.0f, 0.0f}};
+	};
+
 	int x = 20;
 	int x_inc = 2;
-	sch.spawn([&](auto& yield) {
+	int box = world.insert(box_at(x));
+
+	// replicacion: entidad 0 = jugador (acciones), 1 = caja
+	std::unique_ptr<dune::state_publisher> state;
+	std::unique_ptr<dune::state_subscriber> spectator;
+	if (!state_server.empty())
+	{
+		dune::state_options options;
+		options.server = state_server;
+		state = std::make_unique<dune::state_publisher>(options);
+		state->add();
+		state->add();
+	}
+	if (!spectate_server.empty())
+	{
+		dune::state_options options;
+		options.server = spectate_server;
+		spectator = std::make_unique<dune::state_subscriber>(std::to_string(SDL_GetPerformanceCounter()), options);
+	}
+
+	// el render es critico; la simulacion da un paso por frame y el resto va con presupuesto
+	dune::frame_scheduler frame_sched;
+	ren.input().start_capture();
+	frame_sched.spawn(sch, dune::per_frame("simulation"), [&](auto& yield, dune::frame_scheduler::task_id task) {
 		while(!exit)
 		{
-			if(x > (SCREEN_WIDTH - 100) || x < 0)
+			// input capturado en otro hilo, se entrega en bloque al simular
+			actions.begin_frame();
+			ren.input().dispatch();
+			if (!replay_file.empty() && player.finished())
+			{
+				exit = true;
+			}
+
+			if (spectator)
+			{
+				// la caja la mueve otra instancia: 100 ms de retraso para interpolar
+				float position[3];
+				uint32_t bits;
+				if (spectator->sample(1, 100.0, position, bits))
+				{
+					x = (int)std::lround(position[0]);
+					world.move(box, box_at(x));
+				}
+				frame_sched.wait_next_frame(task, yield);
+				continue;
+			}
+
+			bool collision = false;
+			world.query(world.box(box), [&](int id) {
+				// solo rebota contra la pared hacia la que se mueve
+				collision |= (id == wall_right && x_inc > 0) || (id == wall_left && x_inc < 0);
+			});
+			if(collision)
 			{
 				x_inc = -x_inc;
-				console->warn("Collision!.");
+				FRAME_LOGW("Collision!.");
 			}
 			x += x_inc;
-			yield( {} );
+			world.move(box, box_at(x));
+			if (state)
+			{
+				state->set_bits(0, (uint32_t)actions.held_mask());
+				state->set_position(1, (float)x, 20.0f);
+				state->tick();
+			}
+			frame_sched.wait_next_frame(task, yield);
 		}
 	});
-	sch.spawn([&](auto& yield) {
+	frame_sched.spawn(sch, dune::critical("render"), [&](auto& yield, dune::frame_scheduler::task_id task) {
+
+		// objetos GL creados a partir de aqui: borrado aplazado y presupuesto de VRAM
+		dune::gpu_options gpu_options;
+		gpu_options.budget_bytes = vram_budget_mb << 20;
+		dune::gpu_resources gpu(gpu_options);
+
+		// viewport, clear y cambios de FBO los gestiona el grafo
+		dune::render_graph graph;
+		dune::resource_handle backbuffer = graph.import_backbuffer(SCREEN_WIDTH, SCREEN_HEIGHT, ren.framebuffer());
+		graph.add_pass("clear", [&](dune::pass_builder& builder) {
+			builder.write(backbuffer);
+			// builder.clear(230 / 255.0f, 249 / 255.0f, 255 / 255.0f, 1.0f);
+			builder.clear(230 / 255.0f, 19 / 255.0f, 15 / 255.0f, 1.0f);
+		}, nullptr);
+
+		// pixeles, origen arriba a la izquierda
+		const float ortho[16] = {
+			2.0f / SCREEN_WIDTH, 0.0f, 0.0f, 0.0f,
+			0.0f, -2.0f / SCREEN_HEIGHT, 0.0f, 0.0f,
+			0.0f, 0.0f, -1.0f, 0.0f,
+			-1.0f, 1.0f, 0.0f, 1.0f
+		};
+
+		// la escena: suelo y la caja que rebota (solo se regenera lo que se mueve)
+		dune::ui_cache scene_ui;
+		dune::ui_rect* ground = scene_ui.root().add(std::make_unique<dune::ui_rect>());
+		ground->set_rect(0.0f, 130.0f, (float)SCREEN_WIDTH, 10.0f);
+		ground->set_color(40, 40, 40);
+		dune::ui_rect* box_rect = scene_ui.root().add(std::make_unique<dune::ui_rect>());
+		box_rect->set_color(30, 90, 200);
+		graph.add_pass("scene", [&](dune::pass_builder& builder) {
+			builder.write(backbuffer);
+		}, [&](const dune::pass_context&) {
+			scene_ui.update();
+			scene_ui.render(ortho);
+		});
+
+		// texto de diagnostico encima de todo
+		std::unique_ptr<dune::text_renderer> overlay_text;
+		if (overlay)
+		{
+			overlay_text = std::make_unique<dune::text_renderer>();
+			graph.add_pass("overlay", [&](dune::pass_builder& builder) {
+				builder.write(backbuffer);
+			}, [&](const dune::pass_context&) {
+				overlay_text->render(ortho);
+			});
+		}
+		graph.compile();
+
+		// readback asincrono: el frame se codifica varios frames despues en otro hilo
+		std::unique_ptr<dune::frame_capture> capture;
+		if (!capture_file.empty())
+		{
+			capture = std::make_unique<dune::frame_capture>(capture_file, SCREEN_WIDTH, SCREEN_HEIGHT);
+		}
 
-		glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+		// metricas agregadas y publicadas en otro hilo
+		std::unique_ptr<dune::telemetry> telemetry;
+		if (!telemetry_server.empty())
+		{
+			dune::telemetry_options options;
+			options.server = telemetry_server;
+			telemetry = std::make_unique<dune::telemetry>(options);
+		}
+		auto last_frame = std::chrono::steady_clock::now();
 
+		long frame = 0;
+		double total_ms = 0.0;
+		double last_frame_ms = 0.0;
+		unsigned int last_draw_calls = 0;
+		bool first_frame = true;
 		while(!exit)
 		{
 			SDL_Event event;
 			while(SDL_PollEvent(&event)) { ; }
 
-			// glClearColor(230 / 255.0f, 249 / 255.0f, 255 / 255.0f, 1.0);
-			glClearColor(230 / 255.0f, 19 / 255.0f, 15 / 255.0f, 1.0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			frame_sched.begin_frame();
+			dune::allocations().begin_frame();
+			// repeticiones suprimidas cuyo intervalo ya paso
+			frame_log->tick();
+			auto frame_start = std::chrono::steady_clock::now();
+			if (overlay_text)
+			{
+				// metricas del frame anterior
+				const unsigned char white[4] = {255, 255, 255, 255};
+				char line[128];
+				std::snprintf(line, sizeof(line), "frame %ld  %.2f ms  draws %u  glyphs %zu  allocs %llu",
+							  frame, last_frame_ms, last_draw_calls, overlay_text->glyphs(),
+							  (unsigned long long)dune::allocations().last_frame().allocations);
+				overlay_text->begin_frame();
+				// el texto cambia cada frame: un slot fijo, sin entradas nuevas en la cache
+				overlay_text->draw_slot(0, 0, 16, 8.0f, 8.0f, line, white);
+				overlay_text->end_frame();
+			}
+			box_rect->set_rect((float)x, 20.0f, 100.0f, 100.0f);
+			graph.execute();
+			if (capture)
+			{
+				capture->capture(ren.framebuffer());
+			}
+			if (!scene_file.empty())
+			{
+				// tiempo real de GPU, no solo de submit; la lectura de las referencias no cuenta
+				glFinish();
+				total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+				for (const dune::golden_check& check : scene.checks)
+				{
+					if (check.frame != frame + 1)
+					{
+						continue;
+					}
+					dune::image result;
+					dune::read_framebuffer(ren.framebuffer(), SCREEN_WIDTH, SCREEN_HEIGHT, result);
+					if (update_golden)
+					{
+						if (!dune::save_png(check.file, result))
+						{
+							dune::console().error("Can't write golden image: {}", check.file);
+							status = 1;
+						}
+						else
+						{
+							dune::console().warn("Golden image updated: {}", check.file);
+						}
+						continue;
+					}
+					dune::image golden;
+					if (!dune::load_png(check.file, golden))
+					{
+						dune::console().error("Missing golden image {} (run with --update-golden to create it)", check.file);
+						dune::save_png(check.file + ".fail.png", result);
+						status = 1;
+						continue;
+					}
+					dune::image_diff diff = dune::compare(result, golden);
+					if (!diff.passed())
+					{
+						dune::console().error("Golden image mismatch {} (frame {}): ssim {} bad pixels {}% max delta {}", check.file, check.frame, diff.ssim, diff.bad_pixel_ratio * 100.0, diff.max_delta);
+						dune::save_png(check.file + ".fail.png", result);
+						status = 1;
+					}
+				}
+			}
 
 			// ren.clear();
 			// ren.render(tex, x, 20, 100, 100);
 			// ren.render(tex, 100, y, 100, 100);
 			ren.update();
+			ren.present();
+			gpu.end_frame();
+			if (first_frame)
+			{
+				first_frame = false;
+				dune::console().info("Time to first frame: {:.1f} ms",
+						std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - process_start).count());
+			}
+			if (telemetry)
+			{
+				auto now = std::chrono::steady_clock::now();
+				dune::render_stats& stats = dune::frame_stats();
+				dune::frame_sample sample;
+				sample.frame_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_frame).count();
+				// solo en los frames que han entregado input
+				sample.input_latency_ns = 0;
+				sample.input_delivered = ren.input().take_latency(sample.input_latency_ns);
+				sample.draw_calls = stats.draw_calls;
+				sample.uploads = stats.uploads;
+				sample.upload_bytes = stats.upload_bytes;
+				telemetry->record(sample);
+				last_frame = now;
+			}
+			last_draw_calls = dune::frame_stats().draw_calls;
+			last_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+			dune::frame_stats().reset();
 
-			// SDL_GL_SwapWindow(_w.get());
+			if (frames > 0 && ++frame >= frames)
+			{
+				exit = true;
+			}
+			frame_sched.yield(task, yield);
+		}
+		dune::allocations().end_frame();
+
+		if (capture)
+		{
+			capture->finish();
+			if (capture->dropped())
+				dune::console().warn("Capture: {} of {} frames dropped (encoder too slow)", capture->dropped(), capture->captured());
+		}
 
-			yield( {} );
+		if (!scene_file.empty())
+		{
+			// la escena acabo antes (fin del replay): esos frames no se han comprobado
+			for (const dune::golden_check& check : scene.checks)
+			{
+				if (check.frame > frame)
+				{
+					dune::console().error("Scene {} ended at frame {} before golden frame {}", scene.name, frame, check.frame);
+					status = 1;
+				}
+			}
+
+			double avg_ms = frame > 0 ? total_ms / frame : 0.0;
+			dune::console().warn("Scene {}: {} frames, {} ms/frame", scene.name, frame, avg_ms);
+			if (budget_ms > 0.0 && avg_ms > budget_ms)
+			{
+				dune::console().error("Scene {} over budget: {} ms/frame > {} ms", scene.name, avg_ms, budget_ms);
+				status = 1;
+			}
 		}
 	});
 	sch.run_until_complete();
-	spd::get("console")->warn("Exiting ...");
-	return 0;
+	for (dune::frame_scheduler::task_id task = 0; task < frame_sched.size(); ++task)
+	{
+		const dune::task_stats& stats = frame_sched.stats(task);
+		dune::console().info("task {}: avg {:.2f} ms, max {:.2f} ms, overruns {}, deadline misses {}, starved frames {}",
+				frame_sched.name(task), stats.avg_ms, stats.max_ms, stats.overruns, stats.deadline_misses, stats.starved_frames);
+	}
+	dune::console().info("frames over {:.1f} ms: {} of {}", frame_sched.frame_ms(), frame_sched.late_frames(), frame_sched.frame());
+	dune::alloc_tracker& tracker = dune::allocations();
+	dune::console().info("allocations: {} total, max {} in a frame", tracker.allocations(), tracker.max_frame_allocations());
+	if (alloc_sample)
+	{
+		std::vector<dune::alloc_site> sites = tracker.sampled_sites();
+		for (size_t i = 0; i < sites.size() && i < 10; ++i)
+		{
+			dune::console().info("alloc site: {} x{} ({} bytes)", dune::alloc_tracker::symbol(sites[i].address), sites[i].count, sites[i].bytes);
+		}
+	}
+	if (tracker.violations())
+	{
+		dune::console().error("{} allocations inside the frame loop in steady state", tracker.violations());
+		for (const dune::alloc_site& site : tracker.violation_sites())
+		{
+			dune::console().error("  {} x{} ({} bytes)", dune::alloc_tracker::symbol(site.address), site.count, site.bytes);
+		}
+		status = 1;
+	}
+	if (!record_file.empty() && !recorder.save(record_file))
+	{
+		dune::console().error("Can't save input record: {}", record_file);
+	}
+	dune::console().warn("Exiting ...");
+	return status;
 }
 